@@ -0,0 +1,115 @@
+// barcode_lookup_bench.cpp - Barcode lookup time, perfect-hash table vs std::unordered_map
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "models.h"
+#include "barcode_index.h"
+
+using namespace dsms;
+
+namespace {
+
+// EAN-13: twelve digits and a check digit
+std::string randomEan13(std::mt19937_64& rng) {
+    std::string code;
+    int sum = 0;
+    for (int i = 0; i < 12; ++i) {
+        int digit = static_cast<int>(rng() % 10);
+        sum += digit * (i % 2 ? 3 : 1);
+        code += static_cast<char>('0' + digit);
+    }
+    code += static_cast<char>('0' + (10 - sum % 10) % 10);
+    return code;
+}
+
+template<typename Lookup>
+double nsPerLookup(const std::vector<std::string>& codes, Lookup lookup, long long& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& code : codes) checksum += lookup(code);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / codes.size();
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 1000000;
+    size_t lookups = argc > 2 ? static_cast<size_t>(std::stoul(argv[2])) : 5000000;
+
+    std::mt19937_64 rng(11);
+    std::unordered_map<std::string, int> map;
+    std::vector<std::pair<std::string, int>> entries;
+    while (entries.size() < count) {
+        std::string code = randomEan13(rng);
+        if (map.emplace(code, static_cast<int>(entries.size() + 1)).second) {
+            entries.emplace_back(code, static_cast<int>(entries.size() + 1));
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::unordered_map<std::string, int> built;
+    for (const auto& entry : entries) built.emplace(entry.first, entry.second);
+    double map_ms = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    BarcodeTable table;
+    if (!table.build(entries)) {
+        std::cerr << "table build failed" << std::endl;
+        return 1;
+    }
+    double table_ms = msSince(start);
+
+    std::vector<std::shared_ptr<Item>> items;
+    for (const auto& entry : entries) {
+        auto item = std::make_shared<Item>();
+        item->setId(entry.second);
+        item->setBarcode(entry.first);
+        items.push_back(item);
+    }
+    BarcodeIndex index;
+    index.build(items);
+
+    // Checkout scans in no particular order; misses are codes not on file
+    std::vector<std::string> hits, misses;
+    std::uniform_int_distribution<size_t> any(0, count - 1);
+    for (size_t i = 0; i < lookups; ++i) hits.push_back(entries[any(rng)].first);
+    while (misses.size() < lookups / 4) {
+        std::string code = randomEan13(rng);
+        if (!map.count(code)) misses.push_back(code);
+    }
+
+    // Node, cached hash and bucket pointer on top of the key and value
+    size_t map_bytes = built.bucket_count() * sizeof(void*) +
+                       built.size() * (sizeof(std::pair<const std::string, int>) + 2 * sizeof(void*));
+    std::cout << count << " barcodes\n" << std::fixed << std::setprecision(1)
+              << "build: unordered_map " << map_ms << " ms, perfect hash " << table_ms << " ms\n"
+              << "memory: unordered_map ~" << map_bytes / 1048576.0 << " MiB, perfect hash "
+              << table.memoryBytes() / 1048576.0 << " MiB\n\n";
+
+    long long checksum = 0;
+    std::cout << "lookup                     hit ns    miss ns\n";
+    auto report = [&](const char* name, auto lookup) {
+        double hit = nsPerLookup(hits, lookup, checksum);
+        double miss = nsPerLookup(misses, lookup, checksum);
+        std::cout << std::left << std::setw(24) << name << std::right << std::setw(9) << hit
+                  << std::setw(11) << miss << "\n";
+    };
+    report("unordered_map", [&built](const std::string& code) {
+        auto found = built.find(code);
+        return found != built.end() ? found->second : 0;
+    });
+    report("perfect hash", [&table](const std::string& code) { return table.find(code); });
+    report("BarcodeIndex (locked)", [&index](const std::string& code) { return index.find(code); });
+    std::cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
@@ -0,0 +1,107 @@
+// item_search_bench.cpp - Item search latency, inverted index vs scanning every item
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include "item_search.h"
+
+using namespace dsms;
+
+namespace {
+
+std::string randomWord(std::mt19937_64& rng) {
+    static const char* syllables[] = {"ka", "lo", "mi", "ne", "ra", "to", "su", "pe", "di", "ba",
+                                      "go", "ve", "xi", "zu", "ha", "jo", "fi", "wa", "ce", "ly"};
+    std::uniform_int_distribution<int> count(2, 4), pick(0, 19);
+    std::string word;
+    for (int i = count(rng); i > 0; --i) word += syllables[pick(rng)];
+    return word;
+}
+
+// What a client does without the index: every item, every word, every time
+std::vector<int> scan(const std::vector<Item>& items, const std::vector<std::string>& query, size_t limit) {
+    std::vector<int> matches;
+    for (const Item& item : items) {
+        std::vector<std::string> words = searchTokens(item.getName());
+        for (auto& word : searchTokens(item.getCompany())) words.push_back(std::move(word));
+        bool all = true;
+        for (const std::string& term : query) {
+            bool any = false;
+            for (const std::string& word : words) any = any || word.compare(0, term.size(), term) == 0;
+            all = all && any;
+        }
+        if (all) matches.push_back(item.getId());
+    }
+    if (matches.size() > limit) matches.resize(limit);
+    return matches;
+}
+
+double percentile(std::vector<double> samples, double q) {
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 1000000;
+    int queries = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    // A catalog of 3-word names over a 20K-word vocabulary and 2K companies
+    std::mt19937_64 rng(7);
+    std::vector<std::string> vocabulary(20000), companies(2000);
+    for (auto& word : vocabulary) word = randomWord(rng);
+    for (auto& company : companies) company = randomWord(rng) + " " + randomWord(rng);
+    std::uniform_int_distribution<size_t> word(0, vocabulary.size() - 1), company(0, companies.size() - 1);
+
+    std::vector<Item> items(count);
+    for (size_t i = 0; i < count; ++i) {
+        items[i].setId(static_cast<int>(i + 1));
+        items[i].setName(vocabulary[word(rng)] + " " + vocabulary[word(rng)] + " " + vocabulary[word(rng)]);
+        items[i].setCompany(companies[company(rng)]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<const Item*> pointers;
+    for (const Item& item : items) pointers.push_back(&item);
+    ItemSearchIndex index;
+    index.build(pointers);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << count << " items, " << index.termCount() << " distinct words, index built in "
+              << std::fixed << std::setprecision(0) << build_ms << " ms\n\n";
+
+    // Queries are prefixes of words that exist, as a cashier would type them
+    struct Shape { const char* name; size_t prefix; bool two_words; };
+    const Shape shapes[] = {{"2-char prefix", 2, false}, {"3-char prefix", 3, false}, {"5-char prefix", 5, false},
+                            {"whole word", 100, false}, {"word + 3-char prefix", 3, true}};
+    std::uniform_int_distribution<size_t> any_item(0, count - 1);
+    std::cout << "query                     index p50 us   index p99 us   scan us (1 query)\n" << std::setprecision(1);
+    size_t checksum = 0;
+    for (const Shape& shape : shapes) {
+        std::vector<std::string> texts;
+        for (int q = 0; q < queries; ++q) {
+            std::vector<std::string> words = searchTokens(items[any_item(rng)].getName());
+            std::string text = shape.two_words ? words[0] + " " + words[1].substr(0, shape.prefix)
+                                               : words[0].substr(0, shape.prefix);
+            texts.push_back(text);
+        }
+        std::vector<double> samples;
+        for (const std::string& text : texts) {
+            auto t0 = std::chrono::steady_clock::now();
+            checksum += index.search(text, 20).size();
+            samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        checksum += scan(items, searchTokens(texts[0]), 20).size();
+        double scan_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+        std::cout << std::left << std::setw(26) << shape.name << std::right << std::setw(12) << percentile(samples, 0.5)
+                  << std::setw(15) << percentile(samples, 0.99) << std::setw(20) << scan_us << "\n";
+    }
+    std::cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
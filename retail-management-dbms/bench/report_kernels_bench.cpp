@@ -0,0 +1,113 @@
+// report_kernels_bench.cpp - Revenue report cost: shared_ptr<Sale> loop vs columnar kernels
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "models.h"
+#include "report_kernels.h"
+
+using namespace dsms;
+
+namespace {
+
+template<typename F>
+double bestOfMs(int rounds, F run) {
+    double best = 1e300;
+    for (int r = 0; r < rounds; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 10000000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    // A year of sales over 5000 items, shuffled the way a repository holds them
+    const time_t year_start = 1735689600;    // 2025-01-01
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> when(0, 365 * 86400 - 1);
+    std::uniform_int_distribution<int> item(1, 5000);
+    std::uniform_int_distribution<int> qty(1, 10);
+    std::uniform_real_distribution<double> price(0.5, 200.0);
+
+    std::vector<std::shared_ptr<Sale>> sales;
+    sales.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto sale = std::make_shared<Sale>();
+        sale->setId(static_cast<int>(i + 1));
+        sale->setItemId(item(rng));
+        sale->setQuantity(qty(rng));
+        sale->setTotal(price(rng) * sale->getQuantity());
+        sale->setTimestamp(year_start + when(rng));
+        sales.push_back(sale);
+    }
+
+    auto build_start = std::chrono::steady_clock::now();
+    SaleColumns columns;
+    columns.reserve(sales.size());
+    for (const auto& sale : sales) {
+        columns.append(sale->getTimestamp(), sale->getTotal(), sale->getQuantity(), sale->getItemId());
+    }
+    columns.sortByTime();
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start).count();
+
+    // One quarter, as in a typical /api/financials/report call
+    time_t from = year_start + 90 * 86400;
+    time_t to = year_start + 181 * 86400;
+
+    double checksum = 0.0;
+    double object_ms = bestOfMs(rounds, [&]() {
+        double revenue = 0.0;
+        size_t n = 0;
+        for (const auto& sale : sales) {
+            if (sale->getTimestamp() >= from && sale->getTimestamp() <= to) {
+                revenue += sale->getTotal();
+                ++n;
+            }
+        }
+        checksum += revenue + static_cast<double>(n);
+    });
+
+    auto range = columns.rangeOf(from, to);
+    const double* totals = columns.totals.data() + range.first;
+    const int32_t* quantities = columns.quantities.data() + range.first;
+    size_t rows = range.second - range.first;
+
+    double scalar_ms = bestOfMs(rounds, [&]() {
+        checksum += kernels::aggregateScalar(totals, quantities, rows).revenue;
+    });
+    double kernel_ms = bestOfMs(rounds, [&]() {
+        checksum += kernels::aggregate(totals, quantities, rows).revenue;
+    });
+    double by_item_ms = bestOfMs(rounds, [&]() {
+        checksum += static_cast<double>(runSaleReport(columns, from, to, ReportGrouping::Item).groups.size());
+    });
+    double by_day_ms = bestOfMs(rounds, [&]() {
+        checksum += static_cast<double>(runSaleReport(columns, from, to, ReportGrouping::Day).groups.size());
+    });
+
+#ifdef DSMS_REPORT_SSE2
+    const char* kernel_name = "sse2 kernel     ";
+#else
+    const char* kernel_name = "kernel (scalar) ";
+#endif
+    std::cout << count << " sales, " << rows << " in range, best of " << rounds << "\n"
+              << std::fixed << std::setprecision(2)
+              << "column build      " << std::setw(9) << build_ms << " ms (once per sales version)\n"
+              << "shared_ptr loop   " << std::setw(9) << object_ms << " ms\n"
+              << "scalar kernel     " << std::setw(9) << scalar_ms << " ms\n"
+              << kernel_name << "  " << std::setw(9) << kernel_ms << " ms\n"
+              << "group by item     " << std::setw(9) << by_item_ms << " ms\n"
+              << "group by day      " << std::setw(9) << by_day_ms << " ms\n"
+              << "(checksum " << checksum << ")\n";
+    return 0;
+}
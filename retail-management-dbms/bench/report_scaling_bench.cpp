@@ -0,0 +1,90 @@
+// report_scaling_bench.cpp - Report time vs threads per report over columnar sales
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "report_kernels.h"
+
+using namespace dsms;
+
+namespace {
+
+template<typename F>
+double bestOfMs(int rounds, F run) {
+    double best = 1e300;
+    for (int r = 0; r < rounds; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 10000000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+    size_t max_threads = argc > 3 ? static_cast<size_t>(std::stoul(argv[3]))
+                                  : std::max(1u, std::thread::hardware_concurrency());
+
+    // A year of time-ordered sales over 5000 items in 20 departments
+    const time_t year_start = 1735689600;    // 2025-01-01
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> item(1, 5000);
+    std::uniform_int_distribution<int> qty(1, 10);
+    std::uniform_real_distribution<double> price(0.5, 200.0);
+
+    SaleColumns columns;
+    columns.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        int quantity = qty(rng);
+        columns.append(year_start + static_cast<int64_t>(i * (365.0 * 86400 / count)),
+                       price(rng) * quantity, quantity, item(rng));
+    }
+    DepartmentMap departments;
+    for (int d = 0; d < 20; ++d) departments.names.push_back("dept-" + std::to_string(d));
+    departments.department_of_item.resize(5001);
+    for (int i = 0; i <= 5000; ++i) departments.department_of_item[i] = i % 20;
+
+    time_t from = year_start;
+    time_t to = year_start + 365 * 86400;
+
+    std::vector<size_t> thread_counts;
+    for (size_t t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    std::cout << count << " sales, full-year report, best of " << rounds << "\n"
+              << "threads      total ms   by day ms  by dept ms  by item ms\n" << std::fixed << std::setprecision(2);
+
+    double checksum = 0.0;
+    double base[4] = {0, 0, 0, 0};
+    for (size_t threads : thread_counts) {
+        std::unique_ptr<WorkerPool> pool;
+        if (threads > 1) pool = std::make_unique<WorkerPool>("bench", threads - 1, threads * 16);
+
+        const ReportGrouping groupings[4] = {ReportGrouping::None, ReportGrouping::Day,
+                                             ReportGrouping::Department, ReportGrouping::Item};
+        double ms[4];
+        for (int g = 0; g < 4; ++g) {
+            ms[g] = bestOfMs(rounds, [&]() {
+                SaleReport report = runSaleReport(columns, from, to, groupings[g], departments, pool.get(), threads);
+                checksum += report.total.revenue + static_cast<double>(report.groups.size());
+            });
+            if (threads == 1) base[g] = ms[g];
+        }
+
+        std::cout << std::setw(7) << threads;
+        for (int g = 0; g < 4; ++g) std::cout << std::setw(12) << ms[g];
+        std::cout << "   (speedup";
+        for (int g = 0; g < 4; ++g) std::cout << " " << std::setprecision(1) << base[g] / ms[g] << "x";
+        std::cout << std::setprecision(2) << ")\n";
+    }
+    std::cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
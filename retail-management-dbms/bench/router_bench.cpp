@@ -0,0 +1,137 @@
+// router_bench.cpp - Per-request routing cost: route trie vs split_path + std::regex
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <regex>
+#include <string>
+#include <vector>
+#include "router.h"
+
+using namespace dsms;
+
+// Count heap allocations so the "allocation-free" claim is measured, not assumed
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Request {
+    std::string path;
+    std::string query;
+};
+
+// The previous implementation, kept here as the baseline
+std::vector<std::string> legacySplitPath(const std::string& relative_path) {
+    std::vector<std::string> path_segments;
+    size_t pos = (relative_path.size() > 0 && relative_path[0] == '/') ? 1 : 0;
+    while (pos < relative_path.size()) {
+        size_t next_pos = relative_path.find('/', pos);
+        if (next_pos == std::string::npos) {
+            path_segments.push_back(relative_path.substr(pos));
+            break;
+        }
+        path_segments.push_back(relative_path.substr(pos, next_pos - pos));
+        pos = next_pos + 1;
+    }
+    return path_segments;
+}
+
+std::map<std::string, std::string> legacyParseQuery(const std::string& query) {
+    std::map<std::string, std::string> params;
+    std::regex pattern("([^&=]+)=([^&=]*)");
+    auto words_begin = std::sregex_iterator(query.begin(), query.end(), pattern);
+    auto words_end = std::sregex_iterator();
+    for (std::sregex_iterator i = words_begin; i != words_end; ++i) {
+        std::smatch match = *i;
+        params[match[1].str()] = match[2].str();
+    }
+    return params;
+}
+
+int legacyRoute(const Request& request) {
+    auto path = legacySplitPath(request.path);
+    auto params = legacyParseQuery(request.query);
+    if (path.size() < 2 || path[0] != "api") return 0;
+    int route = path[1] == "items" ? 1 : path[1] == "sales" ? 2 : path[1] == "financials" ? 3 : 4;
+    return route * 10 + static_cast<int>(path.size()) + static_cast<int>(params.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 1000000;
+
+    RouteTrie<int> routes;
+    routes.add(HttpMethod::Get, "/api/items", 1);
+    routes.add(HttpMethod::Post, "/api/items", 2);
+    routes.add(HttpMethod::Get, "/api/items/{id}", 3);
+    routes.add(HttpMethod::Put, "/api/items/{id}", 4);
+    routes.add(HttpMethod::Delete, "/api/items/{id}", 5);
+    routes.add(HttpMethod::Post, "/api/items/{id}/sales", 6);
+    routes.add(HttpMethod::Get, "/api/sales", 7);
+    routes.add(HttpMethod::Post, "/api/sales", 8);
+    routes.add(HttpMethod::Get, "/api/sales/{id}", 9);
+    routes.add(HttpMethod::Get, "/api/financials/report", 10);
+    routes.add(HttpMethod::Get, "/api/promotions", 11);
+    routes.add(HttpMethod::Get, "/api/promotions/{id}", 12);
+
+    std::vector<Request> requests = {
+        {"/api/items", ""},
+        {"/api/items/4711", ""},
+        {"/api/items", "department=Grocery"},
+        {"/api/sales", "start=1746057600&end=1748736000"},
+        {"/api/financials/report", "start=1746057600&end=1748736000"},
+        {"/api/promotions/12", "active=true"},
+    };
+
+    size_t checksum = 0;
+    size_t allocations_before = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        const Request& request = requests[i % requests.size()];
+        RouteMatch match;
+        match.path = PathSegments(request.path);
+        match.query = QueryParams(request.query);
+        const int* handler = nullptr;
+        if (routes.match(HttpMethod::Get, match, handler) == RouteResult::Matched) {
+            checksum += static_cast<size_t>(*handler) + match.param_count + match.query.size();
+            checksum += static_cast<size_t>(match.query.getInt("start", 0) & 0xff);
+        }
+    }
+    auto trie_time = std::chrono::steady_clock::now() - start;
+    size_t trie_allocations = g_allocations.load() - allocations_before;
+
+    size_t legacy_iterations = iterations / 10 > 0 ? iterations / 10 : 1;
+    allocations_before = g_allocations.load();
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < legacy_iterations; ++i) {
+        checksum += static_cast<size_t>(legacyRoute(requests[i % requests.size()]));
+    }
+    auto legacy_time = std::chrono::steady_clock::now() - start;
+    size_t legacy_allocations = g_allocations.load() - allocations_before;
+
+    auto per_request_ns = [](std::chrono::steady_clock::duration d, size_t n) {
+        return std::chrono::duration<double, std::nano>(d).count() / static_cast<double>(n);
+    };
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "route trie        " << std::setw(9) << per_request_ns(trie_time, iterations) << " ns/request  "
+              << std::setprecision(2) << static_cast<double>(trie_allocations) / iterations << " allocs/request\n"
+              << std::setprecision(1)
+              << "split_path+regex  " << std::setw(9) << per_request_ns(legacy_time, legacy_iterations) << " ns/request  "
+              << std::setprecision(2) << static_cast<double>(legacy_allocations) / legacy_iterations << " allocs/request\n"
+              << "(checksum " << checksum << ")\n";
+    return 0;
+}
@@ -0,0 +1,93 @@
+// wire_format_bench.cpp - Payload size and encode time: JSON vs MessagePack vs CBOR
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include "models.h"
+#include "wire_format.h"
+
+using namespace dsms;
+
+namespace {
+
+std::vector<std::shared_ptr<Item>> makeItems(size_t count) {
+    const char* departments[] = {"Grocery", "Electronics", "Clothing", "Home", "Toys"};
+    std::vector<std::shared_ptr<Item>> items;
+    items.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto item = std::make_shared<Item>();
+        item->setId(static_cast<int>(i + 1));
+        item->setName("Item " + std::to_string(i));
+        item->setCompany("Supplier " + std::to_string(i % 97));
+        item->setQuantity(static_cast<int>(i % 500));
+        item->setPrice(1.25 + (i % 1000) * 0.5);
+        item->setDepartment(departments[i % 5]);
+        items.push_back(item);
+    }
+    return items;
+}
+
+std::vector<std::shared_ptr<Sale>> makeSales(size_t count) {
+    std::vector<std::shared_ptr<Sale>> sales;
+    sales.reserve(count);
+    time_t base = 1746057600; // 2025-05-01
+    for (size_t i = 0; i < count; ++i) {
+        auto sale = std::make_shared<Sale>();
+        sale->setId(static_cast<int>(i + 1));
+        sale->setItemId(static_cast<int>(i % 5000) + 1);
+        sale->setQuantity(static_cast<int>(i % 7) + 1);
+        sale->setTotal(sale->getQuantity() * 3.75);
+        sale->setTimestamp(base + static_cast<time_t>(i * 13));
+        sales.push_back(sale);
+    }
+    return sales;
+}
+
+template<typename T>
+std::string encodeJson(const std::vector<std::shared_ptr<T>>& models) {
+    std::string body = "[";
+    bool first = true;
+    for (const auto& model : models) {
+        if (!first) body += ",";
+        body += model->toJsonString();
+        first = false;
+    }
+    return body + "]";
+}
+
+template<typename Fn>
+double timeMs(Fn fn, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / rounds;
+}
+
+template<typename T>
+void run(const std::string& label, const std::vector<std::shared_ptr<T>>& models, int rounds) {
+    size_t json_size = 0, msgpack_size = 0, cbor_size = 0;
+    double json_ms = timeMs([&] { json_size = encodeJson(models).size(); }, rounds);
+    double msgpack_ms = timeMs([&] { msgpack_size = encodeModels(WireFormat::MsgPack, models).size(); }, rounds);
+    double cbor_ms = timeMs([&] { cbor_size = encodeModels(WireFormat::Cbor, models).size(); }, rounds);
+
+    std::cout << label << " (" << models.size() << " records)\n"
+              << std::fixed << std::setprecision(2)
+              << "  json     " << std::setw(10) << json_size << " bytes  " << json_ms << " ms\n"
+              << "  msgpack  " << std::setw(10) << msgpack_size << " bytes  " << msgpack_ms << " ms"
+              << "  (" << 100.0 * msgpack_size / json_size << "% of json)\n"
+              << "  cbor     " << std::setw(10) << cbor_size << " bytes  " << cbor_ms << " ms"
+              << "  (" << 100.0 * cbor_size / json_size << "% of json)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::stoul(argv[1])) : 100000;
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    run("items", makeItems(count), rounds);
+    run("sales", makeSales(count), rounds);
+    return 0;
+}
@@ -7,10 +7,21 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <functional>
 
 // Include services header to define complete service types
 #include "services.h"
 #include "models.h"
+#include "wire_format.h"
+#include "compression.h"
+#include "static_assets.h"
+#include "response_cache.h"
+#include "router.h"
+#include "worker_pool.h"
+#include "server_config.h"
+#include "event_stream.h"
+#include "store_registry.h"
+#include "idempotency_cache.h"
 
 namespace dsms {
     // Forward declarations to resolve circular dependencies
@@ -19,6 +30,14 @@ namespace dsms {
     class FinancialController;
     class PromotionsController;
 
+    // Controllers bound to one store's services
+    struct StoreControllers {
+        std::unique_ptr<ItemsController> items;
+        std::unique_ptr<SalesController> sales;
+        std::unique_ptr<FinancialController> financial;
+        std::unique_ptr<PromotionsController> promotions;
+    };
+
     // Base API Controller
     class ApiController {
     protected:
@@ -26,12 +45,112 @@ namespace dsms {
         static web::json::value model_to_json(const std::shared_ptr<Model>& model);
         static web::json::value models_to_json(const std::vector<std::shared_ptr<Model>>& models);
 
+        // Content negotiation: JSON by default, MessagePack/CBOR on request
+        static WireFormat negotiate_format(const web::http::http_request& request);
+
+        template<typename T>
+        static SerializedBody serialize_models(WireFormat format, const std::vector<std::shared_ptr<T>>& models) {
+            SerializedBody body;
+            body.content_type = contentTypeFor(format);
+            if (format != WireFormat::Json) {
+                body.bytes = encodeModels(format, models);
+                return body;
+            }
+            std::string json = "[";
+            bool first = true;
+            for (const auto& model : models) {
+                if (!model) continue;
+                if (!first) json += ",";
+                json += model->toJsonString();
+                first = false;
+            }
+            json += "]";
+            body.bytes.assign(json.begin(), json.end());
+            return body;
+        }
+
+        template<typename T>
+        static SerializedBody serialize_model(WireFormat format, const T& model) {
+            SerializedBody body;
+            body.content_type = contentTypeFor(format);
+            if (format != WireFormat::Json) {
+                BinaryEncoder enc(format);
+                encodeModel(enc, model);
+                body.bytes = enc.release();
+                return body;
+            }
+            std::string json = model.toJsonString();
+            body.bytes.assign(json.begin(), json.end());
+            return body;
+        }
+
+        template<typename T>
+        static void reply_models(const web::http::http_request& request,
+                                 const std::vector<std::shared_ptr<T>>& models) {
+            SerializedBody body = serialize_models(negotiate_format(request), models);
+            send_body(request, web::http::status_codes::OK, std::move(body.bytes), body.content_type);
+        }
+
+        template<typename T>
+        static void reply_model(const web::http::http_request& request, const std::shared_ptr<T>& model) {
+            if (!model) {
+                request.reply(web::http::status_codes::NotFound);
+                return;
+            }
+            SerializedBody body = serialize_model(negotiate_format(request), *model);
+            send_body(request, web::http::status_codes::OK, std::move(body.bytes), body.content_type);
+        }
+
+        // Conditional GET over a versioned resource. Replies 304 when the
+        // client's If-None-Match is current; otherwise serves the rendered
+        // body from response_cache(), calling render(format) only on a miss.
+        template<typename Render>
+        static void reply_versioned(const web::http::http_request& request, const std::string& resource,
+                                    uint64_t version, Render render) {
+            WireFormat format = negotiate_format(request);
+            std::string etag = make_etag(resource, format, version);
+            if (is_not_modified(request, etag)) {
+                reply_not_modified(request, etag);
+                return;
+            }
+
+            std::string key = ResponseCache::makeKey(
+                utility::conversions::to_utf8string(request.relative_uri().path()),
+                utility::conversions::to_utf8string(request.relative_uri().query()),
+                contentTypeFor(format));
+            std::shared_ptr<const SerializedBody> body = response_cache().find(key, version);
+            if (!body) {
+                body = std::make_shared<const SerializedBody>(render(format));
+                response_cache().store(key, version, body);
+            }
+            send_body(request, web::http::status_codes::OK, body->bytes, body->content_type, etag);
+        }
+
+        static std::string make_etag(const std::string& resource, WireFormat format, uint64_t version);
+        static bool is_not_modified(const web::http::http_request& request, const std::string& etag);
+        static void reply_not_modified(const web::http::http_request& request, const std::string& etag);
+
+        // Reply with a body, gzip/deflate-compressing it when the client
+        // accepts it and the payload is at least compression_threshold() bytes
+        static void send_body(const web::http::http_request& request, web::http::status_code status,
+                              const std::string& body, const std::string& content_type);
+        static void send_body(const web::http::http_request& request, web::http::status_code status,
+                              std::vector<unsigned char> body, const std::string& content_type,
+                              const std::string& etag = std::string());
+
     public:
-        // Default HTTP method handlers
-        virtual void handle_get(web::http::http_request request);
-        virtual void handle_post(web::http::http_request request);
-        virtual void handle_put(web::http::http_request request);
-        virtual void handle_delete(web::http::http_request request);
+        static size_t compression_threshold();
+        static void set_compression_threshold(size_t bytes);
+
+        // Rendered GET bodies shared by all controllers
+        static ResponseCache& response_cache();
+
+        // Default HTTP method handlers. `route` views the request URI and is
+        // only valid for the duration of the call.
+        virtual void handle_get(web::http::http_request request, const RouteMatch& route);
+        virtual void handle_post(web::http::http_request request, const RouteMatch& route);
+        virtual void handle_put(web::http::http_request request, const RouteMatch& route);
+        virtual void handle_delete(web::http::http_request request, const RouteMatch& route);
 
         // Virtual destructor for proper inheritance
         virtual ~ApiController() = default;
@@ -40,39 +159,92 @@ namespace dsms {
     // REST API Listener
     class ApiListener {
     private:
+        ServerConfig config;
         web::http::experimental::listener::http_listener listener;
 
-        // Service instances - ensure these are fully defined
-        InventoryService inventory_service;
-        SalesService sales_service;
-        FinancialService financial_service;
-        PromotionService promotion_service;
+        // Service instances - owned by services_impl.cpp or the caller
+        InventoryService& inventory_service;
+        SalesService& sales_service;
+        FinancialService& financial_service;
+        PromotionService& promotion_service;
 
-        // Controller instances - use pointers to break circular dependency
-        std::unique_ptr<ItemsController> items_controller;
-        std::unique_ptr<SalesController> sales_controller;
-        std::unique_ptr<FinancialController> financial_controller;
-        std::unique_ptr<PromotionsController> promotions_controller;
+        // Controller instances for the default store (/api/...) and for
+        // each store in the registry (/api/stores/{id}/...); the map is
+        // filled once in initialize_controllers() and only read afterwards
+        StoreControllers controllers;
+        StoreRegistry* store_registry;
+        std::map<std::string, std::unique_ptr<StoreControllers>, std::less<>> store_controllers;
 
         // Private method to initialize controllers
         void initialize_controllers();
 
+        // Web UI files, precompressed and held in memory
+        StaticAssetCache static_assets;
+
+        // Which pool runs a route; Inline runs on the cpprest thread and is
+        // reserved for cheap endpoints that must answer under overload
+        enum class WorkClass { Inline, Fast, Report };
+
+        using RouteHandler = std::function<void(web::http::http_request, const RouteMatch&)>;
+        struct RouteEntry {
+            RouteHandler handler;
+            WorkClass work = WorkClass::Fast;
+        };
+
+        // Route table, built once by initialize_routes()
+        RouteTrie<RouteEntry> routes;
+        void initialize_routes();
+
+        // Request handling pools. Declared after the controllers so they are
+        // drained and joined before the controllers are destroyed.
+        std::unique_ptr<WorkerPool> fast_pool;
+        std::unique_ptr<WorkerPool> report_pool;
+        std::atomic<uint64_t> expired_in_queue{0};
+
+        // Route a request and hand it to the pool owning its route
+        void handle_request(web::http::http_request request);
+
+        // 503 with Retry-After, used when admission control sheds a request
+        void reply_overloaded(const web::http::http_request& request);
+
+        // GET /api/metrics - pool queue depths and cache counters
+        void handle_metrics(web::http::http_request request);
+
+        // GET /api/stores and GET /api/financials/pnl/stores - the store list
+        // and profit and loss per store, computed across stores in parallel
+        void handle_stores(web::http::http_request request);
+        void handle_stores_pnl(web::http::http_request request, const RouteMatch& route);
+
+        // GET /api/events - server-sent events from the repository change feed
+        std::unique_ptr<EventStreamHub> event_hub;
+        void handle_events(web::http::http_request request, const RouteMatch& route);
+
+        // Serve a file from static_assets, honouring If-None-Match
+        void serve_static(web::http::http_request request);
+
     public:
-        // Constructor to set up routes
-        ApiListener(const std::string& base_uri);
+        // Constructors to set up routes using the global services
+        explicit ApiListener(const ServerConfig& server_config);
+        explicit ApiListener(const std::string& base_uri);
 
-        // Constructor with explicit service references
+        // Constructor with explicit service references; without a registry
+        // only the default store is served
         ApiListener(
+            const ServerConfig& server_config,
             InventoryService& inv_service,
             SalesService& sales_service,
             FinancialService& fin_service,
-            PromotionService& promo_service
+            PromotionService& promo_service,
+            StoreRegistry* stores = nullptr
         );
 
+        // (Re)load the web UI from disk; returns the number of files cached
+        size_t load_static_assets(const std::string& web_root);
+
         // Start the listener
         void open();
 
-        // Stop the listener
+        // Stop the listener and drain the worker pools
         void close();
     };
 
@@ -88,13 +260,24 @@ namespace dsms {
             : inventory_service(inv_service), sales_service(sales_serv) {}
 
         // Override base class methods
-        void handle_get(web::http::http_request request) override;
-        void handle_post(web::http::http_request request) override;
-        void handle_put(web::http::http_request request) override;
-        void handle_delete(web::http::http_request request) override;
+        void handle_get(web::http::http_request request, const RouteMatch& route) override;
+        void handle_post(web::http::http_request request, const RouteMatch& route) override;
+        void handle_put(web::http::http_request request, const RouteMatch& route) override;
+        void handle_delete(web::http::http_request request, const RouteMatch& route) override;
 
         // Specific method for recording sales
-        void handle_sales_post(web::http::http_request request);
+        void handle_sales_post(web::http::http_request request, const RouteMatch& route);
+
+        // Ranked prefix search over names and companies
+        void handle_search(web::http::http_request request, const RouteMatch& route);
+
+        // Scan-to-price lookup by barcode
+        void handle_barcode(web::http::http_request request, const RouteMatch& route);
+
+        // Stock adjustments and low-stock queries
+        void handle_stock_post(web::http::http_request request, const RouteMatch& route);
+        void handle_low_stock(web::http::http_request request, const RouteMatch& route);
+        void handle_low_stock_alerts(web::http::http_request request, const RouteMatch& route);
     };
 
     // Sales API Controller
@@ -102,13 +285,27 @@ namespace dsms {
     private:
         SalesService& sales_service;
 
+        // Responses to POST /api/sales by Idempotency-Key, for retries;
+        // shared by every controller of the same store
+        std::shared_ptr<IdempotencyCache> idempotency;
+
+        // Records the sale a POST body describes
+        IdempotentResponse record_sale(const std::string& body);
+
     public:
         // Constructor that takes sales service reference
-        SalesController(SalesService& serv) : sales_service(serv) {}
+        explicit SalesController(SalesService& serv,
+                                 std::shared_ptr<IdempotencyCache> keys = std::make_shared<IdempotencyCache>())
+            : sales_service(serv), idempotency(std::move(keys)) {}
+
+        IdempotencyStats idempotency_stats() { return idempotency->stats(); }
 
         // Override base class methods
-        void handle_get(web::http::http_request request) override;
-        void handle_post(web::http::http_request request) override;
+        void handle_get(web::http::http_request request, const RouteMatch& route) override;
+        void handle_post(web::http::http_request request, const RouteMatch& route) override;
+
+        // Best sellers for the current hour or day
+        void handle_top(web::http::http_request request, const RouteMatch& route);
     };
 
     // Financial API Controller
@@ -121,8 +318,14 @@ namespace dsms {
         FinancialController(FinancialService& serv) : financial_service(serv) {}
 
         // Override base class methods
-        void handle_get(web::http::http_request request) override;
-        void handle_post(web::http::http_request request) override;
+        void handle_get(web::http::http_request request, const RouteMatch& route) override;
+        void handle_post(web::http::http_request request, const RouteMatch& route) override;
+
+        // Profit-and-loss report
+        void handle_pnl(web::http::http_request request, const RouteMatch& route);
+
+        // Sketch-based sales analytics per department
+        void handle_analytics(web::http::http_request request, const RouteMatch& route);
     };
 
     // Promotions API Controller
@@ -135,10 +338,10 @@ namespace dsms {
         PromotionsController(PromotionService& serv) : promotion_service(serv) {}
 
         // Override base class methods
-        void handle_get(web::http::http_request request) override;
-        void handle_post(web::http::http_request request) override;
-        void handle_put(web::http::http_request request) override;
-        void handle_delete(web::http::http_request request) override;
+        void handle_get(web::http::http_request request, const RouteMatch& route) override;
+        void handle_post(web::http::http_request request, const RouteMatch& route) override;
+        void handle_put(web::http::http_request request, const RouteMatch& route) override;
+        void handle_delete(web::http::http_request request, const RouteMatch& route) override;
     };
 
 } // namespace dsms
\ No newline at end of file
@@ -0,0 +1,292 @@
+// barcode_index.h - Barcode to item lookup through a minimal perfect hash
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+namespace dsms {
+
+// High 64 bits of the 128-bit product a * b
+inline uint64_t mulHigh64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    return __umulh(a, b);
+#else
+    uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t middle = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (middle >> 32);
+#endif
+}
+
+inline uint64_t barcodeMix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline uint64_t barcodeHash(const char* data, size_t length, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return barcodeMix(h);
+}
+
+// Immutable minimal perfect hash from barcodes to item ids (hash and
+// displace: keys are split into buckets of about three, and each bucket
+// gets the smallest pilot that sends all its keys to free slots). A lookup
+// reads one pilot and one slot, and the slot holds the key itself, so there
+// is no pointer to chase. Keys longer than kMaxKey do not fit in a slot and
+// are rejected by build().
+class BarcodeTable {
+public:
+    static constexpr size_t kMaxKey = 15;
+
+private:
+    struct Slot {
+        char key[kMaxKey];
+        uint8_t length;
+        int32_t item_id;     // 0: removed since the build
+    };
+
+    std::vector<uint32_t> pilots;
+    std::vector<Slot> slots;
+    uint64_t seed = 0;
+
+    size_t bucketOf(uint64_t h) const {
+        return static_cast<size_t>(((h >> 32) * pilots.size()) >> 32);
+    }
+
+    size_t slotOf(uint64_t h, uint32_t pilot) const {
+        // Remixed: keys of one bucket share the high bits bucketOf() used
+        uint64_t x = barcodeMix(h + pilot * 0x9e3779b97f4a7c15ULL);
+        return static_cast<size_t>(mulHigh64(x, slots.size()));
+    }
+
+    // Index of the barcode's slot, or SIZE_MAX when it is not in the table
+    size_t indexOf(const std::string& code) const {
+        if (slots.empty() || code.size() > kMaxKey) return SIZE_MAX;
+        uint64_t h = barcodeHash(code.data(), code.size(), seed);
+        size_t index = slotOf(h, pilots[bucketOf(h)]);
+        const Slot& slot = slots[index];
+        if (slot.length != code.size() || std::memcmp(slot.key, code.data(), code.size()) != 0) return SIZE_MAX;
+        return index;
+    }
+
+    bool tryBuild(const std::vector<std::pair<std::string, int>>& entries) {
+        size_t n = entries.size();
+        pilots.assign(std::max<size_t>(n / 3, 1), 0);
+        slots.assign(n, Slot{});
+
+        std::vector<uint64_t> hashes(n);
+        std::vector<std::vector<uint32_t>> buckets(pilots.size());
+        for (size_t i = 0; i < n; ++i) {
+            hashes[i] = barcodeHash(entries[i].first.data(), entries[i].first.size(), seed);
+            buckets[bucketOf(hashes[i])].push_back(static_cast<uint32_t>(i));
+        }
+        std::vector<uint32_t> order(buckets.size());
+        for (size_t b = 0; b < order.size(); ++b) order[b] = static_cast<uint32_t>(b);
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        // Largest buckets first, while most slots are still free; the last
+        // singletons each hunt for one of a few free slots, ~n tries apiece
+        uint32_t max_pilot = static_cast<uint32_t>(std::min<uint64_t>(16 * static_cast<uint64_t>(n) + 1024, UINT32_MAX));
+        std::vector<bool> taken(n);
+        std::vector<size_t> positions;
+        for (uint32_t b : order) {
+            const std::vector<uint32_t>& keys = buckets[b];
+            if (keys.empty()) break;
+            uint32_t pilot = 0;
+            for (;; ++pilot) {
+                if (pilot == max_pilot) return false;    // two keys share a hash; reseed
+                positions.clear();
+                bool free = true;
+                for (uint32_t key : keys) {
+                    size_t position = slotOf(hashes[key], pilot);
+                    if (taken[position] || std::find(positions.begin(), positions.end(), position) != positions.end()) {
+                        free = false;
+                        break;
+                    }
+                    positions.push_back(position);
+                }
+                if (free) break;
+            }
+            pilots[b] = pilot;
+            for (size_t k = 0; k < keys.size(); ++k) {
+                const auto& entry = entries[keys[k]];
+                Slot& slot = slots[positions[k]];
+                std::memcpy(slot.key, entry.first.data(), entry.first.size());
+                slot.length = static_cast<uint8_t>(entry.first.size());
+                slot.item_id = entry.second;
+                taken[positions[k]] = true;
+            }
+        }
+        return true;
+    }
+
+public:
+    // Replaces the contents; barcodes must be distinct and at most kMaxKey
+    // bytes. About 30 bytes a key, built in roughly linear time.
+    bool build(const std::vector<std::pair<std::string, int>>& entries) {
+        for (const auto& entry : entries) {
+            if (entry.first.empty() || entry.first.size() > kMaxKey) return false;
+        }
+        for (seed = 0; seed < 8; ++seed) {
+            if (tryBuild(entries)) return true;
+        }
+        pilots.clear();
+        slots.clear();
+        return false;
+    }
+
+    // Item id for the barcode, or 0
+    int find(const std::string& code) const {
+        size_t index = indexOf(code);
+        return index != SIZE_MAX ? slots[index].item_id : 0;
+    }
+
+    bool contains(const std::string& code) const { return indexOf(code) != SIZE_MAX; }
+
+    // Points a barcode that is in the table at another item (0 hides it)
+    void assign(const std::string& code, int item_id) {
+        size_t index = indexOf(code);
+        if (index != SIZE_MAX) slots[index].item_id = item_id;
+    }
+
+    // Barcodes that still point at an item
+    void collect(std::vector<std::pair<std::string, int>>& out) const {
+        for (const Slot& slot : slots) {
+            if (slot.item_id != 0) out.emplace_back(std::string(slot.key, slot.length), slot.item_id);
+        }
+    }
+
+    size_t size() const { return slots.size(); }
+    size_t memoryBytes() const { return pilots.size() * sizeof(uint32_t) + slots.size() * sizeof(Slot); }
+};
+
+// Barcode lookup for the whole catalog. The perfect-hash table covers the
+// barcodes present at the last build; changes to those are written into
+// the table in place, and new barcodes go to an overflow map until there
+// are enough of them to rebuild (an eighth of the table, at least 1024).
+// Barcodes too long for the table stay in the overflow map.
+class BarcodeIndex {
+private:
+    BarcodeTable table;
+    std::unordered_map<std::string, int> overflow;
+    std::unordered_map<int, std::string> barcode_of;
+    size_t rebuild_at = 1024;
+    mutable std::shared_mutex mutex_;
+
+    void unlinkLocked(const std::string& code, int item_id) {
+        if (table.contains(code)) {
+            if (table.find(code) == item_id) table.assign(code, 0);
+            return;
+        }
+        auto found = overflow.find(code);
+        if (found != overflow.end() && found->second == item_id) overflow.erase(found);
+    }
+
+    void rebuildLocked() {
+        std::vector<std::pair<std::string, int>> entries;
+        entries.reserve(table.size() + overflow.size());
+        table.collect(entries);
+        std::unordered_map<std::string, int> remaining;
+        for (const auto& entry : overflow) {
+            if (entry.first.size() <= BarcodeTable::kMaxKey) {
+                entries.push_back(entry);
+            } else {
+                remaining.insert(entry);
+            }
+        }
+        if (!table.build(entries)) {
+            std::cerr << "Barcode table build failed; using the overflow map" << std::endl;
+            for (const auto& entry : entries) remaining.insert(entry);
+        }
+        overflow.swap(remaining);
+        rebuild_at = overflow.size() + std::max<size_t>(table.size() / 8, 1024);
+    }
+
+public:
+    // Replaces the contents with the barcodes of `items`; when two items
+    // share a barcode the first one keeps it
+    template<typename Items>
+    void build(const Items& items) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        table = BarcodeTable();
+        overflow.clear();
+        barcode_of.clear();
+        for (const auto& item : items) {
+            std::string code = item->getBarcode();
+            if (code.empty() || !overflow.emplace(code, item->getId()).second) continue;
+            barcode_of[item->getId()] = code;
+        }
+        rebuildLocked();
+    }
+
+    // Sets the item's barcode (empty: none), taking it from any item that had it
+    void put(int item_id, const std::string& code) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto previous = barcode_of.find(item_id);
+        if (previous != barcode_of.end()) {
+            if (previous->second == code) return;
+            unlinkLocked(previous->second, item_id);
+            barcode_of.erase(previous);
+        }
+        if (code.empty()) return;
+
+        barcode_of[item_id] = code;
+        if (table.contains(code)) {
+            table.assign(code, item_id);
+            return;
+        }
+        overflow[code] = item_id;
+        if (overflow.size() >= rebuild_at) rebuildLocked();
+    }
+
+    void remove(int item_id) {
+        put(item_id, std::string());
+    }
+
+    // Item id for the barcode, or 0
+    int find(const std::string& code) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        int item_id = table.find(code);
+        if (item_id != 0 || overflow.empty()) return item_id;
+        auto found = overflow.find(code);
+        return found != overflow.end() ? found->second : 0;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return barcode_of.size();
+    }
+
+    size_t overflowSize() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return overflow.size();
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,109 @@
+// change_feed.h - Sequence-numbered log of recent repository mutations
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+namespace dsms {
+
+enum class ChangeOp {
+    Insert,
+    Update,
+    Remove,
+    Purge,      // several records removed at once; `data` holds the count and ids
+    Alert       // not a mutation: an event raised by a service
+};
+
+inline const char* changeOpName(ChangeOp op) {
+    switch (op) {
+        case ChangeOp::Insert: return "insert";
+        case ChangeOp::Update: return "update";
+        case ChangeOp::Remove: return "remove";
+        case ChangeOp::Purge: return "purge";
+        default: return "alert";
+    }
+}
+
+struct ChangeEvent {
+    uint64_t sequence = 0;
+    time_t time = 0;
+    std::string resource;    // repository storage name: "items", "sales", ...
+    ChangeOp op = ChangeOp::Update;
+    int id = 0;
+    std::string data;        // the record as JSON; empty for removes
+};
+
+// Fixed-size ring of the most recent events. Sequence numbers start at 1
+// and never repeat within a process, so a reader resumes by asking for
+// everything after the last sequence it saw. Once a reader falls more than
+// `capacity` events behind, the events it missed are gone and since()
+// reports the gap so it can reload instead.
+class ChangeFeed {
+private:
+    mutable std::mutex mutex_;
+    mutable std::condition_variable published;
+    std::vector<ChangeEvent> ring;
+    uint64_t last_sequence = 0;
+
+    uint64_t oldestLocked() const {
+        return last_sequence >= ring.size() ? last_sequence - ring.size() + 1 : 1;
+    }
+
+public:
+    explicit ChangeFeed(size_t capacity = 4096) : ring(std::max<size_t>(capacity, 1)) {}
+
+    uint64_t publish(const std::string& resource, ChangeOp op, int id, std::string data) {
+        uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sequence = ++last_sequence;
+            ChangeEvent& slot = ring[sequence % ring.size()];
+            slot.sequence = sequence;
+            slot.time = time(nullptr);
+            slot.resource = resource;
+            slot.op = op;
+            slot.id = id;
+            slot.data = std::move(data);
+        }
+        published.notify_all();
+        return sequence;
+    }
+
+    // Appends events with sequence > after, at most `limit`. Returns false
+    // when some of them were already overwritten (or `after` is from a
+    // previous process); `out` then starts at the oldest retained event.
+    bool since(uint64_t after, std::vector<ChangeEvent>& out, size_t limit = SIZE_MAX) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t oldest = oldestLocked();
+        bool complete = after + 1 >= oldest && after <= last_sequence;
+        uint64_t from = complete ? after + 1 : oldest;
+        for (uint64_t s = from; s <= last_sequence && limit > 0; ++s, --limit) {
+            out.push_back(ring[s % ring.size()]);
+        }
+        return complete;
+    }
+
+    // Blocks until an event after `after` exists or the timeout passes;
+    // returns the last sequence either way
+    uint64_t waitAfter(uint64_t after, std::chrono::milliseconds timeout) const {
+        std::unique_lock<std::mutex> lock(mutex_);
+        published.wait_for(lock, timeout, [this, after]() { return last_sequence != after; });
+        return last_sequence;
+    }
+
+    uint64_t lastSequence() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_sequence;
+    }
+
+    size_t capacity() const { return ring.size(); }
+};
+
+} // namespace dsms
@@ -0,0 +1,102 @@
+// compression.h - HTTP content-encoding helpers backed by zlib
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <zlib.h>
+
+namespace dsms {
+
+enum class ContentEncoding { Identity, Gzip, Deflate };
+
+inline const char* encodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Deflate: return "deflate";
+        default: return "identity";
+    }
+}
+
+// Pick a response encoding from an Accept-Encoding header. gzip is preferred
+// over deflate when both carry the same q-value; q=0 rules a coding out.
+inline ContentEncoding negotiateContentEncoding(const std::string& accept_encoding) {
+    ContentEncoding best = ContentEncoding::Identity;
+    double best_q = 0.0;
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if (end == std::string::npos) end = accept_encoding.size();
+        std::string entry = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semi = entry.find(';');
+        if (semi != std::string::npos) {
+            size_t qpos = entry.find("q=", semi);
+            if (qpos != std::string::npos) {
+                q = std::strtod(entry.c_str() + qpos + 2, nullptr);
+            }
+            entry.resize(semi);
+        }
+
+        std::string coding;
+        for (char c : entry) {
+            if (!std::isspace(static_cast<unsigned char>(c))) {
+                coding += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+
+        ContentEncoding candidate;
+        if (coding == "gzip" || coding == "x-gzip") candidate = ContentEncoding::Gzip;
+        else if (coding == "deflate") candidate = ContentEncoding::Deflate;
+        else continue;
+
+        if (q > best_q || (q == best_q && q > 0.0 && candidate == ContentEncoding::Gzip)) {
+            best = candidate;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
+// Compress a buffer as gzip or zlib-wrapped deflate (what HTTP calls
+// "deflate"). Returns false on zlib failure and leaves `out` empty.
+inline bool compressBuffer(const unsigned char* data, size_t size, ContentEncoding encoding,
+                           std::vector<unsigned char>& out, int level = Z_DEFAULT_COMPRESSION) {
+    out.clear();
+    if (encoding == ContentEncoding::Identity) return false;
+
+    z_stream stream{};
+    int window_bits = encoding == ContentEncoding::Gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    out.resize(deflateBound(&stream, static_cast<uLong>(size)) + 32);
+    stream.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    int rc = deflate(&stream, Z_FINISH);
+    size_t produced = out.size() - stream.avail_out;
+    deflateEnd(&stream);
+
+    if (rc != Z_STREAM_END) {
+        out.clear();
+        return false;
+    }
+    out.resize(produced);
+    return true;
+}
+
+inline bool compressBuffer(const std::string& data, ContentEncoding encoding,
+                           std::vector<unsigned char>& out, int level = Z_DEFAULT_COMPRESSION) {
+    return compressBuffer(reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+                          encoding, out, level);
+}
+
+} // namespace dsms
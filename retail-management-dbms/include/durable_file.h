@@ -0,0 +1,125 @@
+// durable_file.h - Crash-safe whole-file replacement
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace dsms {
+
+inline std::string backupPathFor(const std::string& path) {
+    return path + ".bak";
+}
+
+// Replace `path` with `data` so that after a crash the file holds either the
+// old or the new contents, never a mix: the data is written to <path>.tmp
+// and flushed to disk, the current file is kept as <path>.bak, and the temp
+// file is renamed over the original. Returns false and sets `error` on
+// failure, leaving the original untouched.
+inline bool writeFileAtomically(const std::string& path, const std::string& data, std::string& error) {
+    std::string temp = path + ".tmp";
+    std::string backup = backupPathFor(path);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "cannot create " + temp;
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        DWORD chunk = 0;
+        DWORD want = static_cast<DWORD>(std::min<size_t>(data.size() - written, 1 << 30));
+        if (!WriteFile(file, data.data() + written, want, &chunk, nullptr)) break;
+        written += chunk;
+    }
+    bool flushed = written == data.size() && FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!flushed) {
+        DeleteFileA(temp.c_str());
+        error = "cannot write " + temp;
+        return false;
+    }
+
+    BOOL replaced = std::filesystem::exists(path)
+        ? ReplaceFileA(path.c_str(), temp.c_str(), backup.c_str(), REPLACEFILE_IGNORE_MERGE_ERRORS,
+                       nullptr, nullptr)
+        : MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    if (!replaced) {
+        error = "cannot replace " + path;
+        return false;
+    }
+#else
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "cannot create " + temp + ": " + std::strerror(errno);
+        return false;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    bool flushed = written == data.size() && ::fsync(fd) == 0;
+    int saved_errno = errno;
+    ::close(fd);
+    if (!flushed) {
+        ::unlink(temp.c_str());
+        error = "cannot write " + temp + ": " + std::strerror(saved_errno);
+        return false;
+    }
+
+    // Hard-link the current generation as the backup so `path` itself never
+    // goes missing; filesystems without links simply get no backup. With no
+    // current file (first write, or recovery) the existing backup is kept.
+    if (::access(path.c_str(), F_OK) == 0) {
+        ::unlink(backup.c_str());
+        ::link(path.c_str(), backup.c_str());
+    }
+
+    if (::rename(temp.c_str(), path.c_str()) != 0) {
+        error = "cannot rename " + temp + ": " + std::strerror(errno);
+        ::unlink(temp.c_str());
+        return false;
+    }
+
+    // Persist the directory entry too, otherwise the rename itself can be
+    // lost on power failure
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+#endif
+    return true;
+}
+
+inline bool readWholeFile(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+} // namespace dsms
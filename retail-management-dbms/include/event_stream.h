@@ -0,0 +1,226 @@
+// event_stream.h - Fans the change feed out to server-sent event streams
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include "change_feed.h"
+
+namespace dsms {
+
+struct EventStreamStats {
+    size_t open = 0;
+    size_t max_streams = 0;
+    uint64_t opened = 0;
+    uint64_t rejected = 0;      // refused because max_streams were open
+    uint64_t dropped = 0;       // closed because the client stopped reading
+    uint64_t events_sent = 0;
+    uint64_t last_sequence = 0;
+};
+
+struct EventStreamLimits {
+    size_t max_streams = 256;
+    std::chrono::seconds heartbeat{15};
+    // Streams are closed after this long; EventSource reconnects with
+    // Last-Event-ID and resumes without losing events
+    std::chrono::seconds max_lifetime{600};
+    // Unread bytes a client may fall behind by before it is dropped
+    size_t max_backlog = 1 << 20;
+};
+
+// One thread waits on the feed and writes each new event to every open
+// stream, so a dashboard costs one connection and no polling, and the feed
+// is read once per batch however many streams are open. Transports plug in
+// through the Stream callbacks; writes must not block.
+class EventStreamHub {
+public:
+    struct Stream {
+        std::function<bool(const std::string&)> write;   // false: connection unusable
+        std::function<size_t()> backlog;                 // bytes written but not yet sent
+        std::function<void()> close;
+        std::set<std::string> resources;                 // empty: everything
+    };
+
+private:
+    struct Subscriber {
+        Stream stream;
+        uint64_t cursor = 0;
+        std::chrono::steady_clock::time_point expires;
+        std::chrono::steady_clock::time_point last_write;
+    };
+
+    ChangeFeed& feed;
+    EventStreamLimits limits;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Subscriber>> subscribers;
+    uint64_t cursor = 0;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+
+    std::atomic<uint64_t> opened{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> events_sent{0};
+
+    static bool wants(const Subscriber& subscriber, const ChangeEvent& event) {
+        return subscriber.stream.resources.empty() || subscriber.stream.resources.count(event.resource) > 0;
+    }
+
+    // Sends events after the subscriber's cursor, preceded by a reset when
+    // some of them are no longer in the feed
+    bool deliverLocked(Subscriber& subscriber, const std::vector<ChangeEvent>& events,
+                       const std::vector<std::string>& frames, bool complete) {
+        if (!complete || (!events.empty() && subscriber.cursor + 1 < events.front().sequence)) {
+            if (!subscriber.stream.write(formatReset(feed.lastSequence()))) return false;
+        }
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (events[i].sequence <= subscriber.cursor || !wants(subscriber, events[i])) continue;
+            if (!subscriber.stream.write(frames[i])) return false;
+            ++events_sent;
+            subscriber.last_write = std::chrono::steady_clock::now();
+        }
+        if (!events.empty()) subscriber.cursor = std::max(subscriber.cursor, events.back().sequence);
+        return true;
+    }
+
+    void run() {
+        while (!stopping) {
+            uint64_t last = feed.waitAfter(cursor, std::chrono::milliseconds(1000));
+            std::vector<ChangeEvent> events;
+            bool complete = last == cursor || feed.since(cursor, events);
+            std::vector<std::string> frames;
+            frames.reserve(events.size());
+            for (const auto& event : events) frames.push_back(format(event));
+
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = subscribers.begin(); it != subscribers.end();) {
+                Subscriber& subscriber = **it;
+                bool ok = deliverLocked(subscriber, events, frames, complete);
+                if (ok && now - subscriber.last_write >= limits.heartbeat) {
+                    ok = subscriber.stream.write(": keepalive\n\n");
+                    subscriber.last_write = now;
+                }
+                bool behind = ok && subscriber.stream.backlog && subscriber.stream.backlog() > limits.max_backlog;
+                if (!ok || behind || now >= subscriber.expires) {
+                    if (!ok || behind) ++dropped;
+                    subscriber.stream.close();
+                    it = subscribers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (!events.empty()) cursor = events.back().sequence;
+        }
+    }
+
+public:
+    explicit EventStreamHub(ChangeFeed& change_feed, EventStreamLimits stream_limits = EventStreamLimits())
+        : feed(change_feed), limits(stream_limits) {}
+
+    ~EventStreamHub() { stop(); }
+
+    EventStreamHub(const EventStreamHub&) = delete;
+    EventStreamHub& operator=(const EventStreamHub&) = delete;
+
+    // SSE frame: `id` is the feed sequence, `event` the resource, and the
+    // data line carries the operation and record
+    static std::string format(const ChangeEvent& event) {
+        std::string frame = "id: " + std::to_string(event.sequence) + "\nevent: " + event.resource +
+                            "\ndata: {\"op\":\"" + changeOpName(event.op) + "\",\"id\":" + std::to_string(event.id) +
+                            ",\"time\":" + std::to_string(static_cast<long long>(event.time));
+        if (!event.data.empty()) frame += ",\"record\":" + event.data;
+        frame += "}\n\n";
+        return frame;
+    }
+
+    // Tells the client it missed events and should reload before applying more
+    static std::string formatReset(uint64_t last_sequence) {
+        return "id: " + std::to_string(last_sequence) + "\nevent: reset\ndata: {\"last_sequence\":" +
+               std::to_string(last_sequence) + "}\n\n";
+    }
+
+    void start() {
+        if (worker.joinable()) return;
+        stopping = false;
+        cursor = feed.lastSequence();
+        worker = std::thread([this]() { run(); });
+    }
+
+    // Closes every stream; clients reconnect to the next server
+    void stop() {
+        stopping = true;
+        if (worker.joinable()) worker.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& subscriber : subscribers) subscriber->stream.close();
+        subscribers.clear();
+    }
+
+    // Opens a stream. With `resume`, events after `after` still in the feed
+    // are replayed first (or a reset is sent when some are gone); otherwise
+    // the stream starts with the next event. Returns false at max_streams.
+    bool subscribe(Stream stream, bool resume, uint64_t after) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (subscribers.size() >= limits.max_streams) {
+            ++rejected;
+            return false;
+        }
+        auto subscriber = std::make_unique<Subscriber>();
+        subscriber->stream = std::move(stream);
+        auto now = std::chrono::steady_clock::now();
+        subscriber->expires = now + limits.max_lifetime;
+        subscriber->last_write = now;
+        subscriber->stream.write("retry: 2000\n\n");
+
+        // Replaying under the lock means the worker cannot deliver a batch
+        // in between, so the stream sees every event exactly once
+        uint64_t last = feed.lastSequence();
+        if (resume) {
+            std::vector<ChangeEvent> events;
+            bool ok;
+            if (feed.since(after, events)) {
+                std::vector<std::string> frames;
+                frames.reserve(events.size());
+                for (const auto& event : events) frames.push_back(format(event));
+                subscriber->cursor = after;
+                ok = deliverLocked(*subscriber, events, frames, true);
+                if (!events.empty()) last = std::max(last, events.back().sequence);
+            } else {
+                // The client reloads everything, so the retained tail is not replayed
+                ok = subscriber->stream.write(formatReset(last));
+            }
+            if (!ok) {
+                subscriber->stream.close();
+                return true;
+            }
+        }
+        subscriber->cursor = std::max(last, cursor);
+        subscribers.push_back(std::move(subscriber));
+        ++opened;
+        return true;
+    }
+
+    EventStreamStats stats() {
+        EventStreamStats s;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            s.open = subscribers.size();
+        }
+        s.max_streams = limits.max_streams;
+        s.opened = opened.load();
+        s.rejected = rejected.load();
+        s.dropped = dropped.load();
+        s.events_sent = events_sent.load();
+        s.last_sequence = feed.lastSequence();
+        return s;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,213 @@
+// idempotency_cache.h - Responses to recent requests by Idempotency-Key
+#pragma once
+
+#include <string>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+namespace dsms {
+
+struct IdempotencyLimits {
+    size_t max_keys = 65536;
+    std::chrono::seconds ttl{86400};
+};
+
+// The response a request got, replayed to its retries
+struct IdempotentResponse {
+    int status = 0;
+    std::string body;
+    std::string content_type;
+};
+
+struct IdempotencyStats {
+    size_t keys = 0;
+    uint64_t replayed = 0;          // retries answered from the cache
+    uint64_t in_progress = 0;       // retries that arrived while the first attempt ran
+    uint64_t mismatched = 0;        // a key reused for a different request
+    uint64_t evicted = 0;           // keys dropped before their ttl to stay within max_keys
+    uint64_t refused = 0;           // claims turned away while a shard was full of running requests
+};
+
+// Bounded set of recently seen idempotency keys, each with the response to
+// replay. The first request with a key claims it and runs; retries get the
+// stored response until the key expires. Keys are spread over independently
+// locked shards, and each shard drops keys oldest first: every key lives for
+// the same ttl, so insertion order is expiry order and eviction never
+// searches. When a shard is full before its oldest key expires, that key
+// goes early; a retry that late runs again. A key whose request is still
+// running is never dropped, since its retry would run alongside it; it
+// moves to the back instead, and a shard holding nothing else refuses new
+// keys until one finishes.
+class IdempotencyCache {
+public:
+    enum class Claim {
+        Claimed,        // run the request, then complete() or release()
+        Replay,         // answer with the stored response
+        InProgress,     // the first attempt has not finished yet
+        Mismatch,       // the key was used for a different request
+        Busy            // no room while the shard's keys are all in progress
+    };
+
+private:
+    static constexpr size_t kShards = 16;
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        uint64_t fingerprint = 0;
+        uint64_t ticket = 0;        // matches this key's place in `order`
+        bool done = false;
+        IdempotentResponse response;
+    };
+
+    struct Place {
+        Clock::time_point expires;
+        std::string key;
+        uint64_t ticket;
+    };
+
+    struct Shard {
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries;
+        std::deque<Place> order;        // oldest first
+        uint64_t next_ticket = 0;
+    };
+
+    IdempotencyLimits limits;
+    size_t shard_capacity;
+    std::array<Shard, kShards> shards;
+
+    std::mutex stats_mutex_;
+    IdempotencyStats stats_;
+
+    Shard& shardFor(const std::string& key) {
+        return shards[std::hash<std::string>()(key) % kShards];
+    }
+
+    // Drops expired keys, and the oldest ones while the shard is full;
+    // released keys leave stale places in `order` that are skipped here.
+    // Keys still in progress go to the back rather than out, at most once
+    // each per call. Returns false when the shard is still full.
+    bool trimLocked(Shard& shard, Clock::time_point now, uint64_t& evicted) {
+        size_t running = 0;
+        while (!shard.order.empty()) {
+            Place& oldest = shard.order.front();
+            auto found = shard.entries.find(oldest.key);
+            bool live = found != shard.entries.end() && found->second.ticket == oldest.ticket;
+            if (live && oldest.expires > now && shard.entries.size() < shard_capacity) break;
+            if (live && !found->second.done) {
+                if (++running > shard.entries.size()) break;
+                shard.order.push_back(std::move(oldest));
+            } else if (live) {
+                if (oldest.expires > now) ++evicted;
+                shard.entries.erase(found);
+            }
+            shard.order.pop_front();
+        }
+        return shard.entries.size() < shard_capacity;
+    }
+
+    // Rebuilds `order` without stale places once they outnumber the keys,
+    // so released keys cannot grow it past twice the shard's keys
+    void compactLocked(Shard& shard) {
+        if (shard.order.size() <= 2 * shard.entries.size() + 16) return;
+        std::deque<Place> live;
+        for (Place& place : shard.order) {
+            auto found = shard.entries.find(place.key);
+            if (found != shard.entries.end() && found->second.ticket == place.ticket) live.push_back(std::move(place));
+        }
+        shard.order.swap(live);
+    }
+
+    void count(uint64_t IdempotencyStats::*counter, uint64_t amount = 1) {
+        if (amount == 0) return;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.*counter += amount;
+    }
+
+public:
+    explicit IdempotencyCache(const IdempotencyLimits& cache_limits = IdempotencyLimits())
+        : limits(cache_limits), shard_capacity(std::max<size_t>(cache_limits.max_keys / kShards, 1)) {}
+
+    IdempotencyCache(const IdempotencyCache&) = delete;
+    IdempotencyCache& operator=(const IdempotencyCache&) = delete;
+
+    // `fingerprint` identifies the request, so a key reused for something
+    // else is refused rather than replayed
+    Claim claim(const std::string& key, uint64_t fingerprint, IdempotentResponse& stored) {
+        Shard& shard = shardFor(key);
+        Clock::time_point now = Clock::now();
+        Claim result;
+        uint64_t evicted = 0;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            bool room = trimLocked(shard, now, evicted);
+            auto found = shard.entries.find(key);
+            if (found == shard.entries.end() && !room) {
+                result = Claim::Busy;
+            } else if (found == shard.entries.end()) {
+                Entry& entry = shard.entries[key];
+                entry.fingerprint = fingerprint;
+                entry.ticket = ++shard.next_ticket;
+                shard.order.push_back(Place{now + limits.ttl, key, entry.ticket});
+                result = Claim::Claimed;
+            } else if (found->second.fingerprint != fingerprint) {
+                result = Claim::Mismatch;
+            } else if (!found->second.done) {
+                result = Claim::InProgress;
+            } else {
+                stored = found->second.response;
+                result = Claim::Replay;
+            }
+        }
+        count(&IdempotencyStats::evicted, evicted);
+        if (result == Claim::Replay) count(&IdempotencyStats::replayed);
+        if (result == Claim::InProgress) count(&IdempotencyStats::in_progress);
+        if (result == Claim::Mismatch) count(&IdempotencyStats::mismatched);
+        if (result == Claim::Busy) count(&IdempotencyStats::refused);
+        return result;
+    }
+
+    // Stores the response of a claimed key for its retries
+    void complete(const std::string& key, IdempotentResponse response) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto found = shard.entries.find(key);
+        if (found == shard.entries.end() || found->second.done) return;
+        found->second.response = std::move(response);
+        found->second.done = true;
+    }
+
+    // Gives up a claimed key without a response, so a retry runs again
+    void release(const std::string& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto found = shard.entries.find(key);
+        if (found == shard.entries.end() || found->second.done) return;
+        // Usually the newest claim, whose place can go with it
+        if (!shard.order.empty() && shard.order.back().ticket == found->second.ticket) shard.order.pop_back();
+        shard.entries.erase(found);
+        compactLocked(shard);
+    }
+
+    IdempotencyStats stats() {
+        size_t keys = 0;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            keys += shard.entries.size();
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        IdempotencyStats result = stats_;
+        result.keys = keys;
+        return result;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,395 @@
+// item_search.h - In-memory prefix search over item names and companies
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <queue>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "models.h"
+
+namespace dsms {
+
+struct SearchHit {
+    int item_id = 0;
+    double score = 0.0;
+};
+
+// Lowercased runs of letters and digits; bytes >= 0x80 are kept so UTF-8
+// words stay whole
+inline std::vector<std::string> searchTokens(const std::string& text, size_t max_tokens = 32) {
+    std::vector<std::string> tokens;
+    std::string current;
+    for (unsigned char c : text) {
+        bool word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<unsigned char>(c - 'A' + 'a');
+            word = true;
+        }
+        if (word) {
+            current.push_back(static_cast<char>(c));
+        } else if (!current.empty()) {
+            tokens.push_back(std::move(current));
+            current.clear();
+            if (tokens.size() == max_tokens) return tokens;
+        }
+    }
+    if (!current.empty() && tokens.size() < max_tokens) tokens.push_back(std::move(current));
+    return tokens;
+}
+
+// Inverted index from name/company terms to items. Terms sit in an ordered
+// dictionary, so the terms starting with a prefix are one contiguous range.
+// A query term matches any word it is a prefix of, every query term must
+// match, and candidates come from the query term with the fewest postings;
+// the other terms are checked against the candidate's own word list.
+//
+// Ranking: a name word outranks a company word, a whole-word match outranks
+// a prefix (and a longer prefix of the same word outranks a shorter one),
+// and the first word of the name gets a bonus. Ties go to the shorter name,
+// then the lower id. Each term's postings are kept in that order, and terms
+// are visited shortest first, so a search stops reading a posting list, and
+// then the range, as soon as nothing left can enter the top `limit`. The
+// cost follows `limit` and the number of words under the prefix, not the
+// number of items that match.
+class ItemSearchIndex {
+private:
+    // How a term occurs in an item, best first
+    enum : uint8_t { kCompanyWord = 0, kNameWord = 1, kFirstNameWord = 2 };
+
+    struct Token {
+        uint32_t term;
+        uint8_t rank;
+    };
+
+    struct Doc {
+        int item_id = 0;
+        uint32_t name_length = 0;
+        size_t text_hash = 0;
+        std::vector<Token> tokens;     // one per distinct term, name words first
+    };
+
+    struct Posting {
+        uint32_t slot;
+        uint8_t rank;
+    };
+
+    struct Term {
+        std::string text;
+        std::vector<Posting> postings;     // best-ranked item first
+    };
+
+    std::map<std::string, uint32_t> dictionary;          // ordered, for prefix ranges
+    std::unordered_map<std::string, uint32_t> term_ids;  // the same, for exact lookups
+    std::vector<Term> terms;
+    std::vector<uint32_t> free_terms;
+    std::vector<Doc> docs;
+    std::vector<uint32_t> free_docs;
+    std::unordered_map<int, uint32_t> slot_of;
+    mutable std::shared_mutex mutex_;
+
+    static size_t textHash(const Item& item) {
+        return std::hash<std::string>{}(item.getName()) * 31 + std::hash<std::string>{}(item.getCompany());
+    }
+
+    static bool startsWith(const std::string& text, const std::string& prefix) {
+        return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // Score of a word of `rank` that the query term covers `coverage` of
+    static double rankScore(uint8_t rank, double coverage) {
+        switch (rank) {
+            case kFirstNameWord: return 3.5 + 2.0 * coverage;
+            case kNameWord: return 3.0 + 2.0 * coverage;
+            default: return 1.0 + coverage;
+        }
+    }
+    static constexpr double kMaxTermScore = 5.5;
+
+    bool precedes(const Posting& a, const Posting& b) const {
+        if (a.rank != b.rank) return a.rank > b.rank;
+        const Doc& x = docs[a.slot];
+        const Doc& y = docs[b.slot];
+        if (x.name_length != y.name_length) return x.name_length < y.name_length;
+        return x.item_id < y.item_id;
+    }
+
+    uint32_t termFor(const std::string& text) {
+        auto found = term_ids.find(text);
+        if (found != term_ids.end()) return found->second;
+        uint32_t id;
+        if (!free_terms.empty()) {
+            id = free_terms.back();
+            free_terms.pop_back();
+        } else {
+            id = static_cast<uint32_t>(terms.size());
+            terms.emplace_back();
+        }
+        terms[id].text = text;
+        dictionary.emplace(text, id);
+        term_ids.emplace(text, id);
+        return id;
+    }
+
+    // Fills the slot's tokens and adds its postings, in order when `sorted`
+    // or appended for build() to sort afterwards
+    void addDocLocked(uint32_t slot, const Item& item, bool sorted) {
+        Doc& doc = docs[slot];
+        doc.item_id = item.getId();
+        doc.name_length = static_cast<uint32_t>(item.getName().size());
+        doc.text_hash = textHash(item);
+        doc.tokens.clear();
+
+        auto add = [&doc, this](const std::string& word, uint8_t rank) {
+            uint32_t term = termFor(word);
+            for (Token& token : doc.tokens) {
+                if (token.term == term) {
+                    token.rank = std::max(token.rank, rank);
+                    return;
+                }
+            }
+            doc.tokens.push_back(Token{term, rank});
+        };
+        std::vector<std::string> name = searchTokens(item.getName());
+        for (size_t i = 0; i < name.size(); ++i) add(name[i], i == 0 ? kFirstNameWord : kNameWord);
+        for (const std::string& word : searchTokens(item.getCompany())) add(word, kCompanyWord);
+
+        for (const Token& token : doc.tokens) {
+            std::vector<Posting>& postings = terms[token.term].postings;
+            Posting posting{slot, token.rank};
+            if (!sorted) {
+                postings.push_back(posting);
+                continue;
+            }
+            auto at = std::lower_bound(postings.begin(), postings.end(), posting,
+                                       [this](const Posting& a, const Posting& b) { return precedes(a, b); });
+            postings.insert(at, posting);
+        }
+    }
+
+    void clearSlotLocked(uint32_t slot) {
+        for (const Token& token : docs[slot].tokens) {
+            Term& term = terms[token.term];
+            Posting posting{slot, token.rank};
+            auto at = std::lower_bound(term.postings.begin(), term.postings.end(), posting,
+                                       [this](const Posting& a, const Posting& b) { return precedes(a, b); });
+            if (at != term.postings.end() && at->slot == slot) term.postings.erase(at);
+            if (term.postings.empty()) {
+                dictionary.erase(term.text);
+                term_ids.erase(term.text);
+                term.text.clear();
+                term.postings.shrink_to_fit();
+                free_terms.push_back(token.term);
+            }
+        }
+        docs[slot].tokens.clear();
+    }
+
+    double tokenScore(const Token& token, const std::string& query_term) const {
+        const std::string& text = terms[token.term].text;
+        if (!startsWith(text, query_term)) return 0.0;
+        return rankScore(token.rank, static_cast<double>(query_term.size()) / static_cast<double>(text.size()));
+    }
+
+    struct Ranked {
+        double score;
+        uint32_t name_length;
+        int item_id;
+
+        // Better-ranked compares less, so the heap top is the entry to evict
+        bool operator<(const Ranked& other) const {
+            if (score != other.score) return score > other.score;
+            if (name_length != other.name_length) return name_length < other.name_length;
+            return item_id < other.item_id;
+        }
+    };
+
+public:
+    ItemSearchIndex() = default;
+    ItemSearchIndex(const ItemSearchIndex&) = delete;
+    ItemSearchIndex& operator=(const ItemSearchIndex&) = delete;
+
+    // Replaces the contents with `items`, sorting each posting list once
+    // instead of inserting into it item by item
+    template<typename Items>
+    void build(const Items& items) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        dictionary.clear();
+        term_ids.clear();
+        terms.clear();
+        free_terms.clear();
+        docs.clear();
+        free_docs.clear();
+        slot_of.clear();
+        for (const auto& item : items) {
+            const Item& record = *item;
+            if (slot_of.count(record.getId())) continue;
+            uint32_t slot = static_cast<uint32_t>(docs.size());
+            docs.emplace_back();
+            slot_of.emplace(record.getId(), slot);
+            addDocLocked(slot, record, false);
+        }
+        for (Term& term : terms) {
+            std::sort(term.postings.begin(), term.postings.end(),
+                      [this](const Posting& a, const Posting& b) { return precedes(a, b); });
+        }
+    }
+
+    // Adds or refreshes an item; a no-op when its name and company have not
+    // changed, so stock updates cost one hash
+    void put(const Item& item) {
+        size_t hash = textHash(item);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto found = slot_of.find(item.getId());
+        uint32_t slot;
+        if (found != slot_of.end()) {
+            slot = found->second;
+            if (docs[slot].text_hash == hash) return;
+            clearSlotLocked(slot);
+        } else if (!free_docs.empty()) {
+            slot = free_docs.back();
+            free_docs.pop_back();
+            slot_of.emplace(item.getId(), slot);
+        } else {
+            slot = static_cast<uint32_t>(docs.size());
+            docs.emplace_back();
+            slot_of.emplace(item.getId(), slot);
+        }
+        addDocLocked(slot, item, true);
+    }
+
+    void remove(int item_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto found = slot_of.find(item_id);
+        if (found == slot_of.end()) return;
+        clearSlotLocked(found->second);
+        docs[found->second] = Doc();
+        free_docs.push_back(found->second);
+        slot_of.erase(found);
+    }
+
+    // Best `limit` matches for `query`, highest score first
+    std::vector<SearchHit> search(const std::string& query, size_t limit) const {
+        std::vector<SearchHit> hits;
+        std::vector<std::string> query_terms = searchTokens(query, 8);
+        if (query_terms.empty() || limit == 0) return hits;
+
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+
+        // Pick the query term whose dictionary range has the fewest postings
+        auto driver_first = dictionary.end(), driver_last = dictionary.end();
+        size_t driver_term = 0;
+        size_t driver_cost = SIZE_MAX;
+        for (size_t q = 0; q < query_terms.size(); ++q) {
+            auto first = dictionary.lower_bound(query_terms[q]);
+            auto last = first;
+            size_t cost = 0;
+            while (last != dictionary.end() && startsWith(last->first, query_terms[q]) && cost < driver_cost) {
+                cost += terms[last->second].postings.size();
+                ++last;
+            }
+            if (cost == 0) return hits;
+            if (cost < driver_cost) {
+                while (last != dictionary.end() && startsWith(last->first, query_terms[q])) ++last;
+                driver_first = first;
+                driver_last = last;
+                driver_term = q;
+                driver_cost = cost;
+            }
+        }
+
+        // Shortest words first: for a fixed prefix they score highest
+        const std::string& lead = query_terms[driver_term];
+        std::vector<uint32_t> range;
+        for (auto it = driver_first; it != driver_last; ++it) range.push_back(it->second);
+        std::stable_sort(range.begin(), range.end(), [this](uint32_t a, uint32_t b) {
+            return terms[a].text.size() < terms[b].text.size();
+        });
+        double other_terms = kMaxTermScore * static_cast<double>(query_terms.size() - 1);
+
+        // Other query terms whose ranges are not much bigger than the
+        // driver's become bitsets, so most non-matching candidates are
+        // rejected without reading their words
+        std::vector<std::vector<bool>> filters;
+        for (size_t q = 0; q < query_terms.size(); ++q) {
+            if (q == driver_term) continue;
+            std::vector<bool> filter(docs.size());
+            size_t cost = 0;
+            for (auto it = dictionary.lower_bound(query_terms[q]);
+                 it != dictionary.end() && startsWith(it->first, query_terms[q]) && cost <= 4 * driver_cost; ++it) {
+                for (const Posting& posting : terms[it->second].postings) filter[posting.slot] = true;
+                cost += terms[it->second].postings.size();
+            }
+            if (cost <= 4 * driver_cost) filters.push_back(std::move(filter));
+        }
+
+        // An item under several words of the range is scored once; one that
+        // was cut off under an earlier word stays unseen, so a later word
+        // where it ranks higher still picks it up
+        std::vector<bool> seen(range.size() > 1 ? docs.size() : 0);
+        std::priority_queue<Ranked> best;
+        for (uint32_t term : range) {
+            double coverage = static_cast<double>(lead.size()) / static_cast<double>(terms[term].text.size());
+            if (best.size() == limit && rankScore(kFirstNameWord, coverage) + other_terms < best.top().score) break;
+
+            for (const Posting& posting : terms[term].postings) {
+                const Doc& doc = docs[posting.slot];
+                if (best.size() == limit) {
+                    Ranked ceiling{rankScore(posting.rank, coverage) + other_terms, doc.name_length, doc.item_id};
+                    if (!(ceiling < best.top())) break;
+                }
+                bool filtered = false;
+                for (const auto& filter : filters) filtered = filtered || !filter[posting.slot];
+                if (filtered) continue;
+                if (!seen.empty()) {
+                    if (seen[posting.slot]) continue;
+                    seen[posting.slot] = true;
+                }
+
+                double score = 0.0;
+                for (const std::string& query_term : query_terms) {
+                    double term_best = 0.0;
+                    for (const Token& token : doc.tokens) term_best = std::max(term_best, tokenScore(token, query_term));
+                    if (term_best == 0.0) {
+                        score = 0.0;
+                        break;
+                    }
+                    score += term_best;
+                }
+                if (score == 0.0) continue;
+
+                Ranked ranked{score, doc.name_length, doc.item_id};
+                if (best.size() < limit) {
+                    best.push(ranked);
+                } else if (ranked < best.top()) {
+                    best.pop();
+                    best.push(ranked);
+                }
+            }
+        }
+
+        hits.resize(best.size());
+        for (size_t i = hits.size(); i-- > 0;) {
+            hits[i] = SearchHit{best.top().item_id, best.top().score};
+            best.pop();
+        }
+        return hits;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return slot_of.size();
+    }
+
+    size_t termCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return dictionary.size();
+    }
+};
+
+} // namespace dsms
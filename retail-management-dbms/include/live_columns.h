@@ -0,0 +1,176 @@
+// live_columns.h - Report columns kept current from a repository's writes
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include "repository.h"
+
+namespace dsms {
+
+struct LiveColumnsStats {
+    size_t rows = 0;
+    size_t tail_rows = 0;
+    size_t bytes = 0;
+    uint64_t rebuilds = 0;          // full reloads from findAll()
+    uint64_t drop_passes = 0;       // passes dropping updated or removed rows
+};
+
+// Columnar copy of a repository for reports: a time-sorted base built once
+// from findAll() plus a time-sorted tail of the records written since,
+// which arrive through the repository's write listener. An update or
+// remove drops the record's rows by id in one pass over the columns at the
+// next snapshot, and an update appends the new version to the tail, so
+// nothing is reloaded from the repository unless resyncCount() moves. The
+// tail is folded into the base once it reaches an eighth of it. The bytes
+// held are charged to the repository's memory budget.
+//
+// Columns needs size(), bytes(), appendFrom(), removeIds() and
+// sortByTime(); `append` adds one record to it, with its id.
+template<typename T, typename Columns>
+class LiveColumns {
+public:
+    struct Snapshot {
+        std::shared_ptr<const Columns> base;
+        std::shared_ptr<const Columns> tail;
+    };
+
+    using Append = std::function<void(Columns&, const T&)>;
+
+private:
+    static constexpr size_t kMinFoldRows = 4096;
+
+    BackedRepository<T>& repo;
+    Append append;
+
+    // build_mutex_ is held by the one caller refreshing the columns, which
+    // alone touches base and tail; mutex_ only guards what the listener
+    // records, so writers never wait for a reload or a drop pass
+    std::mutex build_mutex_;
+    std::shared_ptr<Columns> base;
+    std::shared_ptr<Columns> tail;
+    int64_t charged_bytes = 0;
+
+    std::mutex mutex_;
+    bool built = false;
+    bool building = false;
+    uint64_t built_resyncs = 0;
+    std::map<int, T> pending;       // latest version of each record written since the last snapshot
+    std::vector<int> dropped;       // ids whose rows in base or tail are stale
+
+    std::atomic<size_t> rows{0};
+    std::atomic<size_t> tail_rows{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<uint64_t> rebuilds{0};
+    std::atomic<uint64_t> drop_passes{0};
+
+    void onWrite(ChangeOp op, int id, const T* record) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!built && !building) return;
+        // A new id has no rows yet, unless the reload in progress saw it
+        if (op != ChangeOp::Insert || building) dropped.push_back(id);
+        if (record) {
+            pending.insert_or_assign(id, *record);
+        } else {
+            pending.erase(id);
+        }
+    }
+
+    // Copied first when a running report still reads `columns`
+    static void dropRows(std::shared_ptr<Columns>& columns, const std::vector<int>& ids) {
+        if (columns->size() == 0) return;
+        if (columns.use_count() > 1) columns = std::make_shared<Columns>(*columns);
+        columns->removeIds(ids);
+    }
+
+public:
+    LiveColumns(BackedRepository<T>& repository, Append append_record)
+        : repo(repository), append(std::move(append_record)) {
+        repo.addWriteListener([this](ChangeOp op, int id, const T* record) { onWrite(op, id, record); });
+    }
+
+    ~LiveColumns() {
+        repo.adjustDerivedBytes(-charged_bytes);
+    }
+
+    LiveColumns(const LiveColumns&) = delete;
+    LiveColumns& operator=(const LiveColumns&) = delete;
+
+    // The columns as of now. Reports keep their snapshot, so later writes
+    // never disturb a report that is still running.
+    Snapshot snapshot() {
+        std::lock_guard<std::mutex> build_lock(build_mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t resyncs = repo.resyncCount();
+        if (!built || resyncs != built_resyncs) {
+            built = false;
+            building = true;
+            pending.clear();
+            dropped.clear();
+            lock.unlock();
+
+            auto columns = std::make_shared<Columns>();
+            for (const auto& record : repo.findAll()) append(*columns, *record);
+            columns->sortByTime();
+            base = columns;
+            tail = std::make_shared<Columns>();
+            ++rebuilds;
+
+            lock.lock();
+            building = false;
+            built = true;
+            built_resyncs = resyncs;
+        }
+        std::map<int, T> written;
+        std::vector<int> stale;
+        written.swap(pending);
+        stale.swap(dropped);
+        lock.unlock();
+
+        if (!stale.empty()) {
+            std::sort(stale.begin(), stale.end());
+            stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+            dropRows(base, stale);
+            dropRows(tail, stale);
+            ++drop_passes;
+        }
+        if (!written.empty()) {
+            if (tail.use_count() > 1) tail = std::make_shared<Columns>(*tail);
+            for (const auto& entry : written) append(*tail, entry.second);
+            tail->sortByTime();
+            if (tail->size() >= std::max(base->size() / 8, kMinFoldRows)) {
+                if (base.use_count() > 1) base = std::make_shared<Columns>(*base);
+                base->appendFrom(*tail);
+                base->sortByTime();
+                tail = std::make_shared<Columns>();
+            }
+        }
+
+        int64_t held = static_cast<int64_t>(base->bytes() + tail->bytes());
+        if (held != charged_bytes) {
+            repo.adjustDerivedBytes(held - charged_bytes);
+            charged_bytes = held;
+        }
+        rows = base->size() + tail->size();
+        tail_rows = tail->size();
+        bytes = static_cast<size_t>(held);
+        return Snapshot{base, tail};
+    }
+
+    LiveColumnsStats stats() const {
+        LiveColumnsStats result;
+        result.rows = rows.load();
+        result.tail_rows = tail_rows.load();
+        result.bytes = bytes.load();
+        result.rebuilds = rebuilds.load();
+        result.drop_passes = drop_passes.load();
+        return result;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,127 @@
+// low_stock_index.h - Ordered index of items by stock headroom, with low-stock alerts
+#pragma once
+
+#include <set>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <ctime>
+#include "models.h"
+
+namespace dsms {
+
+struct LowStockEntry {
+    int item_id = 0;
+    int quantity = 0;
+    int reorder_point = 0;
+};
+
+// Items with a reorder point, ordered by headroom (quantity - reorder
+// point). An item is low once headroom <= 0, so the low items are a prefix
+// of the order, most urgent first. Each change is O(log n).
+class LowStockIndex {
+private:
+    std::set<std::pair<int64_t, int>> by_headroom;
+    std::unordered_map<int, LowStockEntry> entries;
+
+    static int64_t headroom(const LowStockEntry& entry) {
+        return static_cast<int64_t>(entry.quantity) - entry.reorder_point;
+    }
+
+public:
+    // Returns whether the item is low after the change and sets `was_low`
+    // to whether it was before; items without a reorder point are dropped
+    bool update(int item_id, int quantity, int reorder_point, bool& was_low) {
+        was_low = false;
+        auto found = entries.find(item_id);
+        if (found != entries.end()) {
+            was_low = headroom(found->second) <= 0;
+            by_headroom.erase({headroom(found->second), item_id});
+            entries.erase(found);
+        }
+        if (reorder_point <= 0) return false;
+
+        LowStockEntry entry{item_id, quantity, reorder_point};
+        entries.emplace(item_id, entry);
+        by_headroom.insert({headroom(entry), item_id});
+        return headroom(entry) <= 0;
+    }
+
+    void remove(int item_id) {
+        bool was_low;
+        update(item_id, 0, 0, was_low);
+    }
+
+    // Low items, most urgent first, at most `limit`
+    std::vector<LowStockEntry> low(size_t limit) const {
+        std::vector<LowStockEntry> result;
+        for (auto it = by_headroom.begin(); it != by_headroom.end() && it->first <= 0 && result.size() < limit; ++it) {
+            result.push_back(entries.at(it->second));
+        }
+        return result;
+    }
+
+    size_t size() const { return entries.size(); }
+};
+
+struct LowStockAlert {
+    uint64_t sequence = 0;
+    time_t time = 0;
+    LowStockEntry entry;
+    bool low = true;     // false: the item recovered above its reorder point
+};
+
+// Sequence-numbered log of the most recent alerts. Pollers resume from the
+// last sequence they saw; listeners are called as alerts are raised.
+class LowStockAlertLog {
+private:
+    mutable std::mutex mutex_;
+    std::deque<LowStockAlert> recent;
+    size_t capacity;
+    uint64_t next_sequence = 1;
+    std::vector<std::function<void(const LowStockAlert&)>> listeners;
+
+public:
+    explicit LowStockAlertLog(size_t max_alerts = 1024) : capacity(max_alerts) {}
+
+    void addListener(std::function<void(const LowStockAlert&)> listener) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners.push_back(std::move(listener));
+    }
+
+    void raise(const LowStockEntry& entry, bool low) {
+        LowStockAlert alert;
+        std::vector<std::function<void(const LowStockAlert&)>> notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            alert.sequence = next_sequence++;
+            alert.time = time(nullptr);
+            alert.entry = entry;
+            alert.low = low;
+            recent.push_back(alert);
+            if (recent.size() > capacity) recent.pop_front();
+            notify = listeners;
+        }
+        for (const auto& listener : notify) listener(alert);
+    }
+
+    // Alerts with sequence > after that are still retained
+    std::vector<LowStockAlert> since(uint64_t after) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<LowStockAlert> result;
+        for (const auto& alert : recent) {
+            if (alert.sequence > after) result.push_back(alert);
+        }
+        return result;
+    }
+
+    uint64_t lastSequence() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return next_sequence - 1;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,182 @@
+// model_serialization.h - JSON (de)serialization of models and data files
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <zlib.h>
+#include <nlohmann/json.hpp>
+#include "models.h"
+
+namespace dsms {
+
+// Serialization Functions for Item, Sale, FinancialRecord, Promotion.
+// Timestamps and revisions are optional on input so files written before
+// they were stored still load.
+inline void readTimestamps(const nlohmann::json& j, Model& model) {
+    if (j.contains("created_at") && j.contains("updated_at")) {
+        model.setTimestamps(j.at("created_at").get<time_t>(), j.at("updated_at").get<time_t>());
+    }
+    model.setRevision(j.value("revision", uint64_t(0)));
+}
+
+inline void to_json(nlohmann::json& j, const Item& item) {
+    j = nlohmann::json{
+        {"id", item.getId()},
+        {"name", item.getName()},
+        {"company", item.getCompany()},
+        {"quantity", item.getQuantity()},
+        {"price", item.getPrice()},
+        {"department", item.getDepartment()},
+        {"reorder_point", item.getReorderPoint()},
+        {"barcode", item.getBarcode()},
+        {"created_at", item.getCreatedAt()},
+        {"updated_at", item.getUpdatedAt()},
+        {"revision", item.getRevision()}
+    };
+}
+
+inline void from_json(const nlohmann::json& j, Item& item) {
+    item.setId(j.at("id").get<int>());
+    item.setName(j.at("name").get<std::string>());
+    item.setCompany(j.at("company").get<std::string>());
+    item.setQuantity(j.at("quantity").get<int>());
+    item.setPrice(j.at("price").get<double>());
+    item.setDepartment(j.at("department").get<std::string>());
+    item.setReorderPoint(j.value("reorder_point", 0));
+    item.setBarcode(j.value("barcode", std::string()));
+    readTimestamps(j, item);
+}
+
+inline void to_json(nlohmann::json& j, const Sale& sale) {
+    j = nlohmann::json{
+        {"id", sale.getId()},
+        {"item_id", sale.getItemId()},
+        {"quantity", sale.getQuantity()},
+        {"total", sale.getTotal()},
+        {"timestamp", sale.getTimestamp()},
+        {"created_at", sale.getCreatedAt()},
+        {"updated_at", sale.getUpdatedAt()},
+        {"revision", sale.getRevision()}
+    };
+}
+
+inline void from_json(const nlohmann::json& j, Sale& sale) {
+    sale.setId(j.at("id").get<int>());
+    sale.setItemId(j.at("item_id").get<int>());
+    sale.setQuantity(j.at("quantity").get<int>());
+    sale.setTotal(j.at("total").get<double>());
+    sale.setTimestamp(j.at("timestamp").get<time_t>());
+    readTimestamps(j, sale);
+}
+
+inline void to_json(nlohmann::json& j, const FinancialRecord& record) {
+    j = nlohmann::json{
+        {"id", record.getId()},
+        {"category", record.getCategory()},
+        {"amount", record.getAmount()},
+        {"description", record.getDescription()},
+        {"date", record.getDate()},
+        {"created_at", record.getCreatedAt()},
+        {"updated_at", record.getUpdatedAt()},
+        {"revision", record.getRevision()}
+    };
+}
+
+inline void from_json(const nlohmann::json& j, FinancialRecord& record) {
+    record.setId(j.at("id").get<int>());
+    record.setCategory(j.at("category").get<std::string>());
+    record.setAmount(j.at("amount").get<double>());
+    record.setDescription(j.value("description", std::string()));
+    record.setDate(j.at("date").get<time_t>());
+    readTimestamps(j, record);
+}
+
+inline void to_json(nlohmann::json& j, const Promotion& promo) {
+    j = nlohmann::json{
+        {"id", promo.getId()},
+        {"department", promo.getDepartment()},
+        {"discount", promo.getDiscount()},
+        {"start_date", promo.getStartDate()},
+        {"end_date", promo.getEndDate()},
+        {"item_ids", promo.getItemIds()},
+        {"created_at", promo.getCreatedAt()},
+        {"updated_at", promo.getUpdatedAt()},
+        {"revision", promo.getRevision()}
+    };
+}
+
+inline void from_json(const nlohmann::json& j, Promotion& promo) {
+    promo.setId(j.at("id").get<int>());
+    if (j.contains("department")) {
+        promo.setDepartment(j.at("department").get<std::string>());
+        promo.setDiscount(j.at("discount").get<double>());
+        promo.setStartDate(j.at("start_date").get<time_t>());
+        promo.setEndDate(j.at("end_date").get<time_t>());
+        promo.setItemIds(j.value("item_ids", std::vector<int>()));
+    } else {
+        // Older files only kept the description and an active flag
+        promo.setDescription(j.at("description").get<std::string>());
+        promo.setActive(j.at("active").get<bool>());
+    }
+    readTimestamps(j, promo);
+}
+
+// Data files are {"format": kJsonDataFormat, "count": n, "checksum": crc32
+// of the compact records array, "records": [...]}
+constexpr const char* kJsonDataFormat = "dsms-json-1";
+
+inline std::string dataChecksum(const std::string& text) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(text.data()), static_cast<uInt>(text.size()));
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08lx", static_cast<unsigned long>(crc));
+    return hex;
+}
+
+inline std::string encodeDataFile(const nlohmann::json& records) {
+    std::string body = records.dump();
+    return "{\"format\":\"" + std::string(kJsonDataFormat) + "\",\"count\":" + std::to_string(records.size()) +
+           ",\"checksum\":\"" + dataChecksum(body) + "\",\"records\":" + body + "}";
+}
+
+// Parse one data file. Accepts the checksummed envelope written by
+// encodeDataFile() and, for files from older versions, a bare array.
+// Returns false with `error` set when the file is torn or corrupt.
+template<typename T>
+bool decodeDataFile(const std::string& text, std::vector<T>& records, std::string& error) {
+    nlohmann::json document = nlohmann::json::parse(text, nullptr, false);
+    if (document.is_discarded()) {
+        error = "not valid JSON (torn write?)";
+        return false;
+    }
+
+    const nlohmann::json* list = &document;
+    if (document.is_object()) {
+        if (document.value("format", std::string()) != kJsonDataFormat || !document.contains("records")) {
+            error = "unknown file format";
+            return false;
+        }
+        list = &document["records"];
+        if (dataChecksum(list->dump()) != document.value("checksum", std::string())) {
+            error = "checksum mismatch";
+            return false;
+        }
+    } else if (!document.is_array()) {
+        error = "expected an array of records";
+        return false;
+    }
+
+    try {
+        for (const auto& itemData : *list) {
+            records.push_back(itemData.get<T>()); // Deserialize using from_json
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+} // namespace dsms
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <ctime>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include <iomanip>
@@ -56,9 +57,10 @@ protected:
     int id;
     time_t created_at;
     time_t updated_at;
+    uint64_t revision;      // bumped by the repository on every write; 0 = never stored
 
 public:
-    Model() : id(0), created_at(time(nullptr)), updated_at(time(nullptr)) {}
+    Model() : id(0), created_at(time(nullptr)), updated_at(time(nullptr)), revision(0) {}
     virtual ~Model() = default;
     
     int getId() const { return id; }
@@ -67,6 +69,12 @@ public:
     time_t getCreatedAt() const { return created_at; }
     time_t getUpdatedAt() const { return updated_at; }
     void updateTimestamp() { updated_at = time(nullptr); }
+
+    // Restore persisted timestamps; the field setters would stamp "now"
+    void setTimestamps(time_t created, time_t updated) { created_at = created; updated_at = updated; }
+
+    uint64_t getRevision() const { return revision; }
+    void setRevision(uint64_t r) { revision = r; }
     
     virtual std::string toJsonString() const = 0;
 };
@@ -78,21 +86,27 @@ private:
     int quantity;
     double price;
     std::string department;
+    int reorder_point;      // alert when quantity falls to this; 0 = never
+    std::string barcode;    // EAN/UPC or SKU as scanned; empty = none
 
 public:
-    Item() : Model(), quantity(0), price(0.0) {}
+    Item() : Model(), quantity(0), price(0.0), reorder_point(0) {}
     
     std::string getName() const { return name; }
     std::string getCompany() const { return company; }
     int getQuantity() const { return quantity; }
     double getPrice() const { return price; }
     std::string getDepartment() const { return department; }
+    int getReorderPoint() const { return reorder_point; }
+    std::string getBarcode() const { return barcode; }
     
     void setName(const std::string& n) { name = n; updateTimestamp(); }
     void setCompany(const std::string& c) { company = c; updateTimestamp(); }
     void setQuantity(int q) { quantity = q; updateTimestamp(); }
     void setPrice(double p) { price = p; updateTimestamp(); }
     void setDepartment(const std::string& d) { department = d; updateTimestamp(); }
+    void setReorderPoint(int r) { reorder_point = r; updateTimestamp(); }
+    void setBarcode(const std::string& b) { barcode = b; updateTimestamp(); }
     
     std::string toJsonString() const override {
         std::ostringstream ss;
@@ -103,8 +117,11 @@ public:
            << "\"quantity\":" << quantity << ","
            << "\"price\":" << price << ","
            << "\"department\":\"" << helpers::escapeJson(department) << "\","
+           << "\"reorder_point\":" << reorder_point << ","
+           << "\"barcode\":\"" << helpers::escapeJson(barcode) << "\","
            << "\"created_at\":\"" << helpers::formatTimeToISO(created_at) << "\","
-           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\""
+           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\","
+           << "\"revision\":" << revision
            << "}";
         return ss.str();
     }
@@ -139,7 +156,8 @@ public:
            << "\"total\":" << total << ","
            << "\"timestamp\":\"" << helpers::formatTimeToISO(timestamp) << "\","
            << "\"created_at\":\"" << helpers::formatTimeToISO(created_at) << "\","
-           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\""
+           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\","
+           << "\"revision\":" << revision
            << "}";
         return ss.str();
     }
@@ -177,7 +195,8 @@ public:
            << "\"amount\":" << amount << ","
            << "\"description\":\"" << helpers::escapeJson(description) << "\","
            << "\"created_at\":\"" << helpers::formatTimeToISO(created_at) << "\","
-           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\""
+           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\","
+           << "\"revision\":" << revision
            << "}";
         return ss.str();
     }
@@ -246,8 +265,11 @@ public:
 
         ss << "],"
            << "\"created_at\":\"" << helpers::formatTimeToISO(created_at) << "\","
-           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\""
+           << "\"updated_at\":\"" << helpers::formatTimeToISO(updated_at) << "\","
+           << "\"revision\":" << revision
            << "}";
         return ss.str();
     }
-};
\ No newline at end of file
+};
+
+} // namespace dsms
@@ -0,0 +1,819 @@
+// partitioned_sale_store.h - Sales stored in per-day or per-month segments
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include "repository_base.h"
+#include "model_serialization.h"
+#include "durable_file.h"
+
+namespace dsms {
+
+enum class PartitionGranularity { Day, Month };
+
+// Days since 1970-01-01 for a proleptic Gregorian date, and back (UTC)
+inline int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+inline void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+// Start of the UTC day containing `ts`, and its "YYYY-MM-DD" key
+inline time_t utcDayStart(time_t ts) {
+    int64_t days = static_cast<int64_t>(ts) / 86400 - (ts < 0 && ts % 86400 != 0);
+    return static_cast<time_t>(days * 86400);
+}
+
+inline std::string utcDayKey(time_t ts) {
+    int64_t y;
+    unsigned m, d;
+    civilFromDays(static_cast<int64_t>(utcDayStart(ts)) / 86400, y, m, d);
+    char key[32];
+    std::snprintf(key, sizeof(key), "%04lld-%02u-%02u", static_cast<long long>(y), m, d);
+    return key;
+}
+
+struct SalePartitionInfo {
+    std::string key;            // "2024-05-17" (day) or "2024-05" (month)
+    time_t start = 0;           // the partition covers [start, end)
+    time_t end = 0;
+    size_t count = 0;
+    time_t min_ts = 0;          // actual timestamp and id ranges of its sales
+    time_t max_ts = 0;
+    int min_id = 0;
+    int max_id = 0;
+    uint64_t bytes = 0;         // segment file size, to spot a stale manifest
+    bool frozen = false;        // compacted; not kept in memory between queries
+};
+
+// Sale storage split by sale timestamp into segment files under `dir`
+// (sales-<key>.json, same checksummed format as the JSON repositories)
+// plus manifest.json holding each segment's ranges. Range queries open only
+// the segments whose timestamps overlap, a write rewrites one segment
+// instead of every sale, and segments older than freeze_after_days are
+// compacted into frozen month segments that are dropped from memory after
+// each use. Writes are synchronous whatever the configured durability.
+class PartitionedSaleStore : public Repository<Sale> {
+private:
+    struct Partition {
+        SalePartitionInfo info;
+        bool loaded = false;
+        bool referenced = false;        // CLOCK bit, set on every access
+        size_t resident_bytes = 0;
+        std::map<int, std::shared_ptr<Sale>> records;
+    };
+
+    // Approximate heap cost of one resident sale: the object, its
+    // shared_ptr control block and the map node
+    static constexpr size_t kSaleResidentBytes = sizeof(Sale) + 96;
+
+    std::string dir;
+    PartitionGranularity granularity;
+    int freeze_after_days;
+    std::map<std::string, Partition> partitions;     // key order is time order
+    int next_id = 1;
+    std::atomic<uint64_t> version{0};
+    std::atomic<uint64_t> segment_loads{0};
+    PersistenceCounters counters;
+    mutable std::mutex mutex_;
+
+    // Memory budget for resident partitions (0 = unbounded). When exceeded,
+    // a CLOCK sweep evicts partitions not accessed since the hand last
+    // passed; evicted partitions are paged back in from their segment. The
+    // partition holding the current time is never evicted.
+    size_t memory_budget;
+    size_t resident_bytes = 0;
+    int64_t derived_bytes = 0;      // see adjustDerivedBytes
+    std::string clock_hand;
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> cache_misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    static std::string monthKey(int64_t y, unsigned m) {
+        char key[32];
+        std::snprintf(key, sizeof(key), "%04lld-%02u", static_cast<long long>(y), m);
+        return key;
+    }
+
+    static SalePartitionInfo bounds(time_t ts, PartitionGranularity unit) {
+        int64_t days = static_cast<int64_t>(utcDayStart(ts)) / 86400;
+        int64_t y;
+        unsigned m, d;
+        civilFromDays(days, y, m, d);
+
+        SalePartitionInfo info;
+        if (unit == PartitionGranularity::Day) {
+            info.key = utcDayKey(ts);
+            info.start = static_cast<time_t>(days * 86400);
+            info.end = info.start + 86400;
+        } else {
+            info.key = monthKey(y, m);
+            info.start = static_cast<time_t>(daysFromCivil(y, m, 1) * 86400);
+            info.end = static_cast<time_t>(daysFromCivil(m == 12 ? y + 1 : y, m == 12 ? 1 : m + 1, 1) * 86400);
+        }
+        return info;
+    }
+
+    std::string segmentPath(const std::string& key) const {
+        return dir + "/sales-" + key + ".json";
+    }
+
+    std::string manifestPath() const {
+        return dir + "/manifest.json";
+    }
+
+    // Recompute the ranges of a loaded partition
+    static void refreshInfo(Partition& partition) {
+        SalePartitionInfo& info = partition.info;
+        info.count = partition.records.size();
+        if (partition.records.empty()) return;
+        info.min_id = partition.records.begin()->first;
+        info.max_id = partition.records.rbegin()->first;
+        info.min_ts = info.max_ts = partition.records.begin()->second->getTimestamp();
+        for (const auto& entry : partition.records) {
+            info.min_ts = std::min(info.min_ts, entry.second->getTimestamp());
+            info.max_ts = std::max(info.max_ts, entry.second->getTimestamp());
+        }
+    }
+
+    // Keep resident_bytes in step with a partition's record count
+    void accountLocked(Partition& partition) {
+        size_t bytes = partition.loaded ? partition.records.size() * kSaleResidentBytes : 0;
+        resident_bytes = resident_bytes - partition.resident_bytes + bytes;
+        partition.resident_bytes = bytes;
+    }
+
+    void evictLocked(Partition& partition) {
+        partition.records.clear();
+        partition.loaded = false;
+        partition.referenced = false;
+        accountLocked(partition);
+    }
+
+    bool loadLocked(Partition& partition) {
+        partition.referenced = true;
+        if (partition.loaded) {
+            ++cache_hits;
+            return true;
+        }
+        ++cache_misses;
+        std::string path = segmentPath(partition.info.key);
+        std::vector<Sale> sales;
+        std::string text, error;
+        bool ok = false;
+        for (const std::string& candidate : {path, backupPathFor(path)}) {
+            sales.clear();
+            if (readWholeFile(candidate, text) && decodeDataFile<Sale>(text, sales, error)) {
+                ok = true;
+                break;
+            }
+        }
+        if (!ok && std::filesystem::exists(path)) {
+            // Refuse to treat an unreadable segment as empty; a later write
+            // would otherwise replace it
+            std::cerr << "Cannot read sales segment " << path << ": " << error << std::endl;
+            return false;
+        }
+
+        partition.records.clear();
+        for (const Sale& sale : sales) {
+            partition.records[sale.getId()] = std::make_shared<Sale>(sale);
+        }
+        partition.loaded = true;
+        ++segment_loads;
+        accountLocked(partition);
+        return true;
+    }
+
+    // Frozen partitions are only resident while a call is using them
+    void releaseIfCold(Partition& partition) {
+        if (partition.info.frozen && partition.loaded) {
+            evictLocked(partition);
+        }
+    }
+
+    bool overBudgetLocked() const {
+        return static_cast<int64_t>(resident_bytes) + derived_bytes > static_cast<int64_t>(memory_budget);
+    }
+
+    void enforceBudgetLocked() {
+        if (memory_budget == 0 || !overBudgetLocked()) return;
+        std::string pinned = bounds(std::time(nullptr), granularity).key;
+
+        // Two full turns clear every reference bit, so this always ends
+        size_t steps = partitions.size() * 2;
+        auto it = partitions.lower_bound(clock_hand);
+        while (overBudgetLocked() && steps-- > 0) {
+            if (it == partitions.end()) it = partitions.begin();
+            Partition& partition = it->second;
+            if (partition.loaded && it->first != pinned) {
+                if (partition.referenced) {
+                    partition.referenced = false;
+                } else {
+                    evictLocked(partition);
+                    ++evictions;
+                }
+            }
+            ++it;
+        }
+        clock_hand = it == partitions.end() ? std::string() : it->first;
+    }
+
+    bool writeManifestLocked() {
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& entry : partitions) {
+            const SalePartitionInfo& info = entry.second.info;
+            list.push_back({
+                {"key", info.key}, {"start", info.start}, {"end", info.end}, {"count", info.count},
+                {"min_ts", info.min_ts}, {"max_ts", info.max_ts},
+                {"min_id", info.min_id}, {"max_id", info.max_id},
+                {"bytes", info.bytes}, {"frozen", info.frozen}
+            });
+        }
+        nlohmann::json manifest = {
+            {"format", "dsms-sales-manifest-1"},
+            {"granularity", granularity == PartitionGranularity::Day ? "day" : "month"},
+            {"next_id", next_id},
+            {"partitions", list}
+        };
+        std::string error;
+        if (!writeFileAtomically(manifestPath(), manifest.dump(2), error)) {
+            std::cerr << "Error saving sales manifest: " << error << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Persist one loaded partition, then the manifest. An emptied partition
+    // is deleted.
+    bool writeSegmentLocked(const std::string& key) {
+        Partition& partition = partitions[key];
+        std::string path = segmentPath(key);
+        auto started = std::chrono::steady_clock::now();
+
+        accountLocked(partition);
+        if (partition.records.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            std::filesystem::remove(backupPathFor(path), ec);
+            partitions.erase(key);
+            counters.recordFlush(started, true);
+            return writeManifestLocked();
+        }
+
+        refreshInfo(partition);
+        nlohmann::json records = nlohmann::json::array();
+        for (const auto& entry : partition.records) records.push_back(*entry.second);
+        std::string document = encodeDataFile(records);
+
+        std::string error;
+        bool ok = writeFileAtomically(path, document, error);
+        counters.recordFlush(started, ok);
+        if (!ok) {
+            std::cerr << "Error saving sales segment: " << error << std::endl;
+            return false;
+        }
+        partition.info.bytes = document.size();
+        return writeManifestLocked();
+    }
+
+    // Partition a sale with timestamp `ts` belongs in. A frozen month
+    // partition absorbs late writes to its range.
+    Partition& partitionForLocked(time_t ts) {
+        SalePartitionInfo month = bounds(ts, PartitionGranularity::Month);
+        auto frozen = partitions.find(month.key);
+        if (frozen != partitions.end() && frozen->second.info.frozen) return frozen->second;
+
+        SalePartitionInfo info = bounds(ts, granularity);
+        Partition& partition = partitions[info.key];
+        if (partition.info.key.empty()) {
+            partition.info = info;
+            partition.loaded = true;        // brand new, nothing on disk
+        }
+        return partition;
+    }
+
+    // The partition holding `id`, already loaded, or nullptr. Only
+    // partitions whose id range covers `id` are opened; the caller releases
+    // the one returned when done with it.
+    Partition* locateLocked(int id) {
+        for (auto& entry : partitions) {
+            Partition& partition = entry.second;
+            if (id < partition.info.min_id || id > partition.info.max_id) continue;
+            if (!loadLocked(partition)) continue;
+            if (partition.records.count(id)) return &partition;
+            releaseIfCold(partition);
+        }
+        return nullptr;
+    }
+
+    // After a failed rewrite of partition `key`, drops its records so the
+    // next access reads what the disk holds, and returns which of `erased`
+    // are gone from there
+    std::vector<int> reloadAfterFailedWriteLocked(const std::string& key, const std::vector<int>& erased) {
+        auto it = partitions.find(key);
+        if (it == partitions.end()) return erased;      // emptied segment deleted; only the manifest failed
+        Partition& partition = it->second;
+        evictLocked(partition);
+        if (!loadLocked(partition)) return std::vector<int>();
+        refreshInfo(partition);     // the failed write already narrowed the ranges
+        std::vector<int> gone;
+        for (int id : erased) {
+            if (!partition.records.count(id)) gone.push_back(id);
+        }
+        releaseIfCold(partition);
+        return gone;
+    }
+
+    // Remove `id` from a loaded partition, rewriting its segment. As in
+    // putLocked, a failed manifest write alone still leaves it removed.
+    bool eraseLocked(Partition& partition, int id) {
+        std::string key = partition.info.key;
+        partition.records.erase(id);
+        bool ok = writeSegmentLocked(key) || !reloadAfterFailedWriteLocked(key, {id}).empty();
+        auto it = partitions.find(key);
+        if (it != partitions.end()) releaseIfCold(it->second);
+        return ok;
+    }
+
+    // Stores `sale` in its partition. When the write fails the partition
+    // goes back to what its segment holds, which has the sale only when
+    // just the manifest failed; startup rescans such a segment, so the sale
+    // counts as stored.
+    bool putLocked(const Sale& sale) {
+        Partition& partition = partitionForLocked(sale.getTimestamp());
+        if (!loadLocked(partition)) return false;
+        partition.records[sale.getId()] = std::make_shared<Sale>(sale);
+        std::string key = partition.info.key;
+        bool ok = writeSegmentLocked(key);
+        if (!ok) {
+            Partition& written = partitions[key];
+            evictLocked(written);
+            if (loadLocked(written)) {
+                refreshInfo(written);
+                auto found = written.records.find(sale.getId());
+                ok = found != written.records.end() && found->second->toJsonString() == sale.toJsonString();
+            }
+        }
+        releaseIfCold(partitions[key]);
+        return ok;
+    }
+
+    // Bring the manifest in line with the segment files actually present,
+    // rescanning any segment written after the manifest (crash between the
+    // two writes) or missing from it
+    void reconcileLocked() {
+        bool changed = false;
+        std::map<std::string, std::string> on_disk;   // key -> path
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            std::string name = entry.path().filename().string();
+            if (name.compare(0, 6, "sales-") != 0 || entry.path().extension() != ".json") continue;
+            on_disk[name.substr(6, name.size() - 11)] = entry.path().string();
+        }
+
+        for (auto it = partitions.begin(); it != partitions.end();) {
+            if (!on_disk.count(it->first)) {
+                it = partitions.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+
+        for (const auto& entry : on_disk) {
+            Partition& partition = partitions[entry.first];
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(entry.second, ec);
+            if (!partition.info.key.empty() && partition.info.bytes == size) continue;
+
+            bool frozen = partition.info.frozen;
+            bool is_month = entry.first.size() == 7;
+            partition.info = SalePartitionInfo();
+            partition.info.key = entry.first;
+            partition.info.frozen = frozen;
+            partition.loaded = false;
+            if (!loadLocked(partition)) continue;
+            refreshInfo(partition);
+            if (!partition.records.empty()) {
+                SalePartitionInfo range = bounds(partition.info.min_ts,
+                    is_month ? PartitionGranularity::Month : PartitionGranularity::Day);
+                partition.info.start = range.start;
+                partition.info.end = range.end;
+            }
+            partition.info.bytes = size;
+            if (partition.info.count > 0) next_id = std::max(next_id, partition.info.max_id + 1);
+            releaseIfCold(partition);
+            changed = true;
+        }
+
+        if (changed) writeManifestLocked();
+    }
+
+    void loadManifestLocked() {
+        std::string text;
+        if (!readWholeFile(manifestPath(), text)) return;
+        nlohmann::json manifest = nlohmann::json::parse(text, nullptr, false);
+        if (manifest.is_discarded() || !manifest.is_object()) {
+            std::cerr << "Ignoring unreadable sales manifest, rescanning segments" << std::endl;
+            return;
+        }
+        next_id = manifest.value("next_id", 1);
+        for (const auto& entry : manifest.value("partitions", nlohmann::json::array())) {
+            Partition partition;
+            SalePartitionInfo& info = partition.info;
+            info.key = entry.value("key", std::string());
+            if (info.key.empty()) continue;
+            info.start = entry.value("start", static_cast<time_t>(0));
+            info.end = entry.value("end", static_cast<time_t>(0));
+            info.count = entry.value("count", static_cast<size_t>(0));
+            info.min_ts = entry.value("min_ts", static_cast<time_t>(0));
+            info.max_ts = entry.value("max_ts", static_cast<time_t>(0));
+            info.min_id = entry.value("min_id", 0);
+            info.max_id = entry.value("max_id", 0);
+            info.bytes = entry.value("bytes", static_cast<uint64_t>(0));
+            info.frozen = entry.value("frozen", false);
+            partitions[info.key] = std::move(partition);
+        }
+    }
+
+    // One-time import of a single-file sales store
+    void migrateLocked(const std::string& legacy_file) {
+        std::string text, error;
+        std::vector<Sale> sales;
+        if (legacy_file.empty() || !readWholeFile(legacy_file, text)) return;
+        if (!decodeDataFile<Sale>(text, sales, error)) {
+            std::cerr << "Not migrating " << legacy_file << ": " << error << std::endl;
+            return;
+        }
+
+        std::vector<std::string> touched;
+        for (const Sale& sale : sales) {
+            Partition& partition = partitionForLocked(sale.getTimestamp());
+            partition.records[sale.getId()] = std::make_shared<Sale>(sale);
+            touched.push_back(partition.info.key);
+            next_id = std::max(next_id, sale.getId() + 1);
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        for (const std::string& key : touched) {
+            if (!writeSegmentLocked(key)) return;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(legacy_file, legacy_file + ".migrated", ec);
+        std::cerr << "Migrated " << sales.size() << " sales from " << legacy_file << " into "
+                  << touched.size() << " partitions" << std::endl;
+    }
+
+    size_t compactLocked(time_t now) {
+        if (freeze_after_days <= 0) return 0;
+        time_t cutoff = now - static_cast<time_t>(freeze_after_days) * 86400;
+
+        std::vector<std::string> candidates;
+        for (const auto& entry : partitions) {
+            if (!entry.second.info.frozen && entry.second.info.end <= cutoff) {
+                candidates.push_back(entry.first);
+            }
+        }
+
+        size_t compacted = 0;
+        for (const std::string& key : candidates) {
+            Partition& source = partitions[key];
+            if (!loadLocked(source)) continue;
+
+            SalePartitionInfo month = bounds(source.info.start, PartitionGranularity::Month);
+            if (month.key == key) {
+                source.info.frozen = true;
+                writeManifestLocked();
+                releaseIfCold(source);
+                ++compacted;
+                continue;
+            }
+
+            Partition& target = partitions[month.key];
+            if (target.info.key.empty()) {
+                target.info = month;
+                target.loaded = true;
+            }
+            if (!loadLocked(target)) continue;
+            target.info.frozen = true;
+            for (const auto& entry : source.records) target.records[entry.first] = entry.second;
+            if (!writeSegmentLocked(month.key)) continue;
+            releaseIfCold(partitions[month.key]);
+
+            // The month segment now holds these sales; drop the day segment
+            partitions[key].records.clear();
+            writeSegmentLocked(key);
+            ++compacted;
+        }
+        return compacted;
+    }
+
+public:
+    PartitionedSaleStore(const std::string& directory, PartitionGranularity unit = PartitionGranularity::Day,
+                         int freeze_days = 30, const std::string& legacy_file = std::string(),
+                         size_t memory_budget_bytes = 0)
+        : dir(directory), granularity(unit), freeze_after_days(freeze_days), memory_budget(memory_budget_bytes) {
+        std::filesystem::create_directories(dir);
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool fresh = !std::filesystem::exists(manifestPath());
+        loadManifestLocked();
+        reconcileLocked();
+        if (fresh && partitions.empty()) migrateLocked(legacy_file);
+        compactLocked(std::time(nullptr));
+        enforceBudgetLocked();
+    }
+
+    std::shared_ptr<Sale> findById(int id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Partition* partition = locateLocked(id);
+        if (!partition) return nullptr;
+        std::shared_ptr<Sale> sale = partition->records[id];
+        releaseIfCold(*partition);
+        enforceBudgetLocked();
+        return sale;
+    }
+
+    std::vector<std::shared_ptr<Sale>> findAll() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::shared_ptr<Sale>> result;
+        for (auto& entry : partitions) {
+            if (!loadLocked(entry.second)) continue;
+            for (const auto& record : entry.second.records) result.push_back(record.second);
+            releaseIfCold(entry.second);
+            enforceBudgetLocked();
+        }
+        std::sort(result.begin(), result.end(), [](const std::shared_ptr<Sale>& a, const std::shared_ptr<Sale>& b) {
+            return a->getId() < b->getId();
+        });
+        return result;
+    }
+
+    bool save(const Sale& sale) override {
+        int id;
+        return saveWithId(sale, id);
+    }
+
+    // A failed save leaves nothing behind: not the sale, not its id, and
+    // not a version bump, unless the sale already left its old partition
+    bool saveWithId(const Sale& sale, int& id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Sale stored = sale;
+        int previous_next_id = next_id;
+        bool moved = false;
+        if (stored.getId() <= 0) {
+            stored.setId(next_id++);
+        } else {
+            next_id = std::max(next_id, stored.getId() + 1);
+            // Left loaded when the sale stays in its partition; putLocked
+            // writes and releases it
+            Partition* previous = locateLocked(stored.getId());
+            if (previous && previous != &partitionForLocked(stored.getTimestamp())) {
+                if (!eraseLocked(*previous, stored.getId())) {
+                    next_id = previous_next_id;
+                    return false;
+                }
+                moved = true;
+            }
+        }
+        id = stored.getId();
+        bool ok = putLocked(stored);
+        if (!ok) next_id = previous_next_id;
+        if (ok || moved) ++version;
+        compactLocked(std::time(nullptr));
+        enforceBudgetLocked();
+        return ok;
+    }
+
+    bool update(const Sale& sale) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Partition* previous = locateLocked(sale.getId());
+        if (!previous) return false;
+        bool moved = previous != &partitionForLocked(sale.getTimestamp());
+        if (moved && !eraseLocked(*previous, sale.getId())) return false;
+        bool ok = putLocked(sale);
+        if (ok || moved) ++version;
+        enforceBudgetLocked();
+        return ok;
+    }
+
+    bool remove(int id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Partition* partition = locateLocked(id);
+        if (!partition) return false;
+        bool ok = eraseLocked(*partition, id);
+        if (ok) ++version;
+        enforceBudgetLocked();
+        return ok;
+    }
+
+    // One segment rewrite per partition touched, as removeMany() does. A
+    // sale whose timestamp moved it to another partition leaves the old
+    // one first; if that rewrite fails the sale is not stored.
+    size_t saveMany(const std::vector<Sale>& sales, std::vector<int>* stored_ids = nullptr) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<int, const Sale*> batch;       // the last version of each id
+        for (const Sale& sale : sales) {
+            if (sale.getId() > 0) batch[sale.getId()] = &sale;
+        }
+        if (batch.empty()) return 0;
+
+        std::vector<std::string> keys;
+        for (const auto& entry : partitions) keys.push_back(entry.first);
+        for (const std::string& key : keys) {
+            Partition& partition = partitions[key];
+            auto first = batch.lower_bound(partition.info.min_id);
+            auto last = batch.upper_bound(partition.info.max_id);
+            if (first == last || !loadLocked(partition)) continue;
+
+            std::vector<int> moved;
+            for (auto it = first; it != last; ++it) {
+                if (!partition.records.count(it->first)) continue;
+                if (&partitionForLocked(it->second->getTimestamp()) == &partition) continue;
+                partition.records.erase(it->first);
+                moved.push_back(it->first);
+            }
+            if (!moved.empty() && !writeSegmentLocked(key)) {
+                std::vector<int> gone = reloadAfterFailedWriteLocked(key, moved);
+                for (int id : moved) {
+                    if (!std::binary_search(gone.begin(), gone.end(), id)) batch.erase(id);
+                }
+            }
+            auto it = partitions.find(key);
+            if (it != partitions.end()) releaseIfCold(it->second);
+        }
+
+        std::map<std::string, std::vector<int>> placed;
+        for (const auto& entry : batch) {
+            Partition& partition = partitionForLocked(entry.second->getTimestamp());
+            if (!loadLocked(partition)) continue;
+            partition.records[entry.first] = std::make_shared<Sale>(*entry.second);
+            placed[partition.info.key].push_back(entry.first);
+            next_id = std::max(next_id, entry.first + 1);
+        }
+
+        std::vector<int> stored;
+        for (const auto& entry : placed) {
+            if (writeSegmentLocked(entry.first)) {
+                stored.insert(stored.end(), entry.second.begin(), entry.second.end());
+            } else {
+                reloadAfterFailedWriteLocked(entry.first, {});
+            }
+            auto it = partitions.find(entry.first);
+            if (it != partitions.end()) releaseIfCold(it->second);
+        }
+        if (!stored.empty()) ++version;
+        compactLocked(std::time(nullptr));
+        enforceBudgetLocked();
+        if (stored_ids) stored_ids->insert(stored_ids->end(), stored.begin(), stored.end());
+        return stored.size();
+    }
+
+    // One segment load and rewrite per partition touched. The ids are
+    // matched against each partition's id range from the manifest, so a
+    // frozen segment is parsed once per batch rather than once per id.
+    size_t removeMany(const std::vector<int>& ids, std::vector<int>* removed_ids = nullptr) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<int> sorted(ids);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+        // Collected first: an emptied partition leaves the map when written
+        std::vector<std::string> keys;
+        for (const auto& entry : partitions) keys.push_back(entry.first);
+
+        std::vector<int> removed;
+        for (const std::string& key : keys) {
+            Partition& partition = partitions[key];
+            auto first = std::lower_bound(sorted.begin(), sorted.end(), partition.info.min_id);
+            auto last = std::upper_bound(first, sorted.end(), partition.info.max_id);
+            if (first == last || !loadLocked(partition)) continue;
+
+            std::vector<int> erased;
+            for (auto id = first; id != last; ++id) {
+                if (partition.records.erase(*id) > 0) erased.push_back(*id);
+            }
+            if (erased.empty()) {
+                releaseIfCold(partition);
+                continue;
+            }
+            if (!writeSegmentLocked(key)) erased = reloadAfterFailedWriteLocked(key, erased);
+            auto it = partitions.find(key);
+            if (it != partitions.end()) releaseIfCold(it->second);
+            removed.insert(removed.end(), erased.begin(), erased.end());
+        }
+        if (!removed.empty()) ++version;
+        enforceBudgetLocked();
+        if (removed_ids) removed_ids->insert(removed_ids->end(), removed.begin(), removed.end());
+        return removed.size();
+    }
+
+    uint64_t getVersion() const override {
+        return version.load();
+    }
+
+    // Only "timestamp" is partitioned; segments whose recorded range misses
+    // [start, end] are never opened
+    bool findByRange(const std::string& column, time_t start, time_t end,
+                     std::vector<std::shared_ptr<Sale>>& out) override {
+        if (column != "timestamp") return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.clear();
+        for (auto& entry : partitions) {
+            Partition& partition = entry.second;
+            if (partition.info.count == 0 || partition.info.max_ts < start || partition.info.min_ts > end) continue;
+            if (!loadLocked(partition)) continue;
+            for (const auto& record : partition.records) {
+                time_t ts = record.second->getTimestamp();
+                if (ts >= start && ts <= end) out.push_back(record.second);
+            }
+            releaseIfCold(partition);
+            enforceBudgetLocked();
+        }
+        std::sort(out.begin(), out.end(), [](const std::shared_ptr<Sale>& a, const std::shared_ptr<Sale>& b) {
+            return a->getTimestamp() != b->getTimestamp() ? a->getTimestamp() < b->getTimestamp()
+                                                          : a->getId() < b->getId();
+        });
+        return true;
+    }
+
+    PersistenceStats persistenceStats() const override {
+        return counters.stats();
+    }
+
+    ResidencyStats residencyStats() const override {
+        ResidencyStats stats;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.bounded = memory_budget > 0;
+        stats.budget_bytes = memory_budget;
+        stats.resident_bytes = resident_bytes;
+        stats.derived_bytes = static_cast<size_t>(std::max<int64_t>(derived_bytes, 0));
+        for (const auto& entry : partitions) {
+            if (entry.second.loaded) {
+                ++stats.resident_partitions;
+                stats.resident_records += entry.second.records.size();
+            }
+        }
+        stats.partitions = partitions.size();
+        stats.hits = cache_hits.load();
+        stats.misses = cache_misses.load();
+        stats.evictions = evictions.load();
+        return stats;
+    }
+
+    // Report columns built from these sales share the memory budget, so
+    // partitions are evicted to make room for them
+    void adjustDerivedBytes(int64_t delta) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        derived_bytes += delta;
+        enforceBudgetLocked();
+    }
+
+    // Merge day partitions older than freeze_after_days into frozen month
+    // partitions. Returns how many partitions were compacted.
+    size_t compact(time_t now = std::time(nullptr)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return compactLocked(now);
+    }
+
+    std::vector<SalePartitionInfo> partitionInfo() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SalePartitionInfo> result;
+        for (const auto& entry : partitions) result.push_back(entry.second.info);
+        return result;
+    }
+
+    // Segment files read from disk since startup
+    uint64_t segmentLoads() const {
+        return segment_loads.load();
+    }
+};
+
+} // namespace dsms
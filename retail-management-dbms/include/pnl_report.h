@@ -0,0 +1,304 @@
+// pnl_report.h - Profit-and-loss report merging sales with financial records
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <limits>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include "report_kernels.h"
+
+namespace dsms {
+
+// Records in category "income" or "income:<anything>" are income; every
+// other category is an expense. Amounts are positive either way.
+inline bool isIncomeCategory(const std::string& category) {
+    return category.compare(0, 6, "income") == 0 && (category.size() == 6 || category[6] == ':');
+}
+
+// Financial records as parallel arrays sorted by date, with categories
+// dictionary-encoded so the P&L pass accumulates into a dense array
+struct FinancialColumns {
+    std::vector<int64_t> dates;
+    std::vector<double> amounts;
+    std::vector<uint32_t> categories;
+    std::vector<int32_t> record_ids;    // only kept by copies that drop records later
+    std::vector<std::string> category_names;
+    std::vector<uint8_t> category_is_income;
+
+    size_t size() const { return dates.size(); }
+
+    size_t bytes() const {
+        // Category names are held twice, in category_names and the index
+        size_t names = 0;
+        for (const auto& name : category_names) names += 2 * (sizeof(std::string) + name.capacity());
+        return dates.capacity() * sizeof(int64_t) + amounts.capacity() * sizeof(double) +
+               categories.capacity() * sizeof(uint32_t) + record_ids.capacity() * sizeof(int32_t) + names;
+    }
+
+    void append(int64_t date, double amount, const std::string& category) {
+        auto found = index.find(category);
+        if (found == index.end()) {
+            found = index.emplace(category, static_cast<uint32_t>(category_names.size())).first;
+            category_names.push_back(category);
+            category_is_income.push_back(isIncomeCategory(category) ? 1 : 0);
+        }
+        dates.push_back(date);
+        amounts.push_back(amount);
+        categories.push_back(found->second);
+    }
+
+    void append(int32_t record_id, int64_t date, double amount, const std::string& category) {
+        append(date, amount, category);
+        record_ids.push_back(record_id);
+    }
+
+    // Rows of `other`, its categories mapped onto this dictionary by name
+    void appendFrom(const FinancialColumns& other) {
+        for (size_t i = 0; i < other.size(); ++i) {
+            append(other.dates[i], other.amounts[i], other.category_names[other.categories[i]]);
+        }
+        record_ids.insert(record_ids.end(), other.record_ids.begin(), other.record_ids.end());
+    }
+
+    // Drops the rows whose record id is in `sorted_ids`, keeping the order;
+    // needs the record_ids column. The category dictionary is left as is.
+    // Returns how many were dropped.
+    size_t removeIds(const std::vector<int>& sorted_ids) {
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (std::binary_search(sorted_ids.begin(), sorted_ids.end(), record_ids[i])) continue;
+            dates[kept] = dates[i];
+            amounts[kept] = amounts[i];
+            categories[kept] = categories[i];
+            record_ids[kept] = record_ids[i];
+            ++kept;
+        }
+        size_t dropped = size() - kept;
+        dates.resize(kept);
+        amounts.resize(kept);
+        categories.resize(kept);
+        record_ids.resize(kept);
+        return dropped;
+    }
+
+    void sortByTime() {
+        if (std::is_sorted(dates.begin(), dates.end())) return;
+        std::vector<std::pair<int64_t, uint32_t>> keys(size());
+        for (size_t i = 0; i < keys.size(); ++i) keys[i] = {dates[i], static_cast<uint32_t>(i)};
+        std::sort(keys.begin(), keys.end());
+        std::vector<double> sorted_amounts(size());
+        std::vector<uint32_t> sorted_categories(size());
+        std::vector<int32_t> sorted_ids(record_ids.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            dates[i] = keys[i].first;
+            sorted_amounts[i] = amounts[keys[i].second];
+            sorted_categories[i] = categories[keys[i].second];
+            if (!sorted_ids.empty()) sorted_ids[i] = record_ids[keys[i].second];
+        }
+        amounts.swap(sorted_amounts);
+        categories.swap(sorted_categories);
+        record_ids.swap(sorted_ids);
+    }
+
+    std::pair<size_t, size_t> rangeOf(time_t start, time_t end) const {
+        auto first = std::lower_bound(dates.begin(), dates.end(), static_cast<int64_t>(start));
+        auto last = std::upper_bound(first, dates.end(), static_cast<int64_t>(end));
+        return {static_cast<size_t>(first - dates.begin()), static_cast<size_t>(last - dates.begin())};
+    }
+
+private:
+    std::map<std::string, uint32_t> index;
+};
+
+struct PnlLine {
+    std::string category;
+    bool income = false;
+    double amount = 0.0;
+    uint64_t records = 0;
+};
+
+struct PnlPeriod {
+    int64_t day_start = 0;           // unused for the whole-range totals
+    SaleAggregate sales;
+    double income = 0.0;
+    double expenses = 0.0;
+    std::vector<PnlLine> lines;      // categories with records, by name
+
+    double net() const { return sales.revenue + income - expenses; }
+};
+
+struct PnlReport {
+    PnlPeriod total;
+    std::vector<PnlPeriod> days;     // only days with activity
+};
+
+namespace detail {
+
+// Dense per-category accumulator that remembers which slots it touched,
+// so emptying it costs the number of categories used, not defined
+struct CategoryTotals {
+    std::vector<double> amounts;
+    std::vector<uint64_t> records;
+    std::vector<uint32_t> touched;
+
+    explicit CategoryTotals(size_t categories) : amounts(categories, 0.0), records(categories, 0) {}
+
+    void add(uint32_t category, double amount) {
+        if (records[category]++ == 0) touched.push_back(category);
+        amounts[category] += amount;
+    }
+
+    // Moves the touched categories into `period` and resets them
+    void drain(const FinancialColumns& columns, PnlPeriod& period) {
+        for (uint32_t category : touched) {
+            PnlLine line;
+            line.category = columns.category_names[category];
+            line.income = columns.category_is_income[category] != 0;
+            line.amount = amounts[category];
+            line.records = records[category];
+            (line.income ? period.income : period.expenses) += line.amount;
+            period.lines.push_back(std::move(line));
+            amounts[category] = 0.0;
+            records[category] = 0;
+        }
+        touched.clear();
+        std::sort(period.lines.begin(), period.lines.end(),
+                  [](const PnlLine& a, const PnlLine& b) { return a.category < b.category; });
+    }
+};
+
+} // namespace detail
+
+// One pass over both time-sorted streams: each UTC day takes the next
+// contiguous run of sales (summed by the vector kernel) and of financial
+// records, so there are no per-record lookups and the cost is linear in
+// the rows inside [start, end] plus a binary search per active day.
+inline PnlReport runProfitAndLoss(const SaleColumns& sales, const FinancialColumns& records,
+                                  time_t start, time_t end, bool by_day) {
+    PnlReport report;
+    auto sale_range = sales.rangeOf(start, end);
+    auto record_range = records.rangeOf(start, end);
+    const int64_t* sale_ts = sales.timestamps.data();
+    const int64_t* record_ts = records.dates.data();
+    size_t s = sale_range.first, f = record_range.first;
+
+    detail::CategoryTotals day_totals(records.category_names.size());
+    detail::CategoryTotals period_totals(records.category_names.size());
+    const int64_t none = std::numeric_limits<int64_t>::max();
+
+    while (s < sale_range.second || f < record_range.second) {
+        int64_t next = std::min(s < sale_range.second ? sale_ts[s] : none,
+                                f < record_range.second ? record_ts[f] : none);
+        int64_t day_start = (next >= 0 ? next / 86400 : (next - 86399) / 86400) * 86400;
+        int64_t day_end = day_start + 86400;
+
+        size_t sale_end = static_cast<size_t>(
+            std::lower_bound(sale_ts + s, sale_ts + sale_range.second, day_end) - sale_ts);
+        PnlPeriod day;
+        day.day_start = day_start;
+        day.sales = kernels::aggregate(sales.totals.data() + s, sales.quantities.data() + s, sale_end - s);
+        report.total.sales.merge(day.sales);
+        s = sale_end;
+
+        for (; f < record_range.second && record_ts[f] < day_end; ++f) {
+            uint32_t category = records.categories[f];
+            period_totals.add(category, records.amounts[f]);
+            if (by_day) day_totals.add(category, records.amounts[f]);
+        }
+        if (by_day) {
+            day_totals.drain(records, day);
+            report.days.push_back(std::move(day));
+        }
+    }
+    period_totals.drain(records, report.total);
+    return report;
+}
+
+namespace detail {
+
+inline void mergePeriod(PnlPeriod& into, const PnlPeriod& next) {
+    into.sales.merge(next.sales);
+    into.income += next.income;
+    into.expenses += next.expenses;
+    if (next.lines.empty()) return;
+    std::vector<PnlLine> lines;
+    lines.reserve(into.lines.size() + next.lines.size());
+    auto a = into.lines.begin();
+    auto b = next.lines.begin();
+    while (a != into.lines.end() || b != next.lines.end()) {
+        if (b == next.lines.end() || (a != into.lines.end() && a->category < b->category)) {
+            lines.push_back(*a++);
+        } else if (a == into.lines.end() || b->category < a->category) {
+            lines.push_back(*b++);
+        } else {
+            lines.push_back(*a++);
+            lines.back().amount += b->amount;
+            lines.back().records += (b++)->records;
+        }
+    }
+    into.lines.swap(lines);
+}
+
+} // namespace detail
+
+// Folds a report over other rows of the same range into `into`, matching
+// categories by name and days by date
+inline void mergeProfitAndLoss(PnlReport& into, const PnlReport& next) {
+    detail::mergePeriod(into.total, next.total);
+    if (next.days.empty()) return;
+    std::vector<PnlPeriod> days;
+    days.reserve(into.days.size() + next.days.size());
+    auto a = into.days.begin();
+    auto b = next.days.begin();
+    while (a != into.days.end() || b != next.days.end()) {
+        if (b == next.days.end() || (a != into.days.end() && a->day_start < b->day_start)) {
+            days.push_back(std::move(*a++));
+        } else if (a == into.days.end() || b->day_start < a->day_start) {
+            days.push_back(*b++);
+        } else {
+            days.push_back(std::move(*a++));
+            detail::mergePeriod(days.back(), *b++);
+        }
+    }
+    into.days.swap(days);
+}
+
+// The same with [start, end] cut at UTC day boundaries into up to `threads`
+// slices of about equal rows, run concurrently (the caller takes one) and
+// merged in order. No day spans two slices, so the merge only concatenates
+// the days and adds up the category totals.
+inline PnlReport runProfitAndLoss(const SaleColumns& sales, const FinancialColumns& records,
+                                  time_t start, time_t end, bool by_day, WorkerPool* pool, size_t threads) {
+    auto sale_range = sales.rangeOf(start, end);
+    auto record_range = records.rangeOf(start, end);
+    size_t sale_rows = sale_range.second - sale_range.first;
+    size_t record_rows = record_range.second - record_range.first;
+    size_t slices = std::max<size_t>(1, std::min(threads, (sale_rows + record_rows) / kMinRowsPerReportTask));
+    if (!pool || slices == 1) return runProfitAndLoss(sales, records, start, end, by_day);
+
+    // Cut where the larger stream divides evenly, moved back to the start
+    // of that day; cuts landing on the same day collapse into one
+    const int64_t* ts = sale_rows >= record_rows ? sales.timestamps.data() : records.dates.data();
+    size_t first = sale_rows >= record_rows ? sale_range.first : record_range.first;
+    size_t rows = std::max(sale_rows, record_rows);
+    std::vector<int64_t> cuts{static_cast<int64_t>(start)};
+    for (size_t slice = 1; slice < slices; ++slice) {
+        int64_t at = ts[first + rows * slice / slices];
+        int64_t day_start = (at >= 0 ? at / 86400 : (at - 86399) / 86400) * 86400;
+        if (day_start > cuts.back()) cuts.push_back(day_start);
+    }
+
+    std::vector<PnlReport> parts(cuts.size());
+    parallelFor(pool, parts.size(), [&](size_t part) {
+        int64_t part_end = part + 1 < cuts.size() ? cuts[part + 1] - 1 : static_cast<int64_t>(end);
+        parts[part] = runProfitAndLoss(sales, records, static_cast<time_t>(cuts[part]),
+                                       static_cast<time_t>(part_end), by_day);
+    });
+    for (size_t part = 1; part < parts.size(); ++part) mergeProfitAndLoss(parts[0], parts[part]);
+    return std::move(parts[0]);
+}
+
+} // namespace dsms
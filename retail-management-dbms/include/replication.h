@@ -0,0 +1,785 @@
+// replication.h - Ships the repository change feed to read replicas
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "change_feed.h"
+#include "repository_base.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace dsms {
+
+// Wire protocol, one '\n'-terminated line per message. Records are
+// model_serialization JSON, which never contains a raw newline.
+//
+//   replica -> primary   HELLO <epoch> <sequence>      resume point, 0 0 for none
+//                        ACK <sequence>                applied through sequence
+//   primary -> replica   RESUME <epoch> <sequence>     events follow from sequence
+//                        SNAPSHOT <epoch> <sequence>   full copy as of sequence:
+//                        BEGIN <resource>                every registered repository,
+//                        RECORD <json>                   then every record in it
+//                        END
+//                        EVENT <sequence> <time> <op> <id> <resource> <json>
+//                        PING <sent> <last> <time>     sent through <sent> of <last>
+//
+// A replica resumes when the primary still holds every event after its
+// position (same epoch, i.e. the same primary process, and within the
+// change feed); otherwise it gets a snapshot. Events carry the record as it
+// is when sent rather than as it was written, so replaying an event twice,
+// or one already covered by the snapshot, is harmless.
+
+struct ReplicaLinkStats {
+    std::string peer;
+    uint64_t sent_sequence = 0;
+    uint64_t acked_sequence = 0;
+    uint64_t lag_events = 0;        // feed events not yet acknowledged
+    time_t connected_at = 0;
+    bool snapshot = false;          // began with a full snapshot
+};
+
+struct ReplicationStats {
+    std::string role = "none";      // "primary", "replica" or "none"
+    std::string endpoint;
+
+    // Primary: the feed position and each connected replica
+    uint64_t last_sequence = 0;
+    uint64_t snapshots_served = 0;
+    std::vector<ReplicaLinkStats> replicas;
+
+    // Replica
+    bool connected = false;
+    uint64_t applied_sequence = 0;
+    uint64_t primary_sequence = 0;
+    uint64_t lag_events = 0;
+    double lag_seconds = 0.0;       // since the replica was last caught up
+    uint64_t events_applied = 0;
+    uint64_t snapshots_loaded = 0;
+    uint64_t reconnects = 0;
+    uint64_t skipped = 0;           // records for repositories this replica lacks
+    std::string last_error;
+};
+
+#ifndef _WIN32
+
+// "unix:/path/to/socket" or "host:port"
+struct ReplicationEndpoint {
+    bool local = false;
+    std::string path;
+    std::string host;
+    std::string port;
+
+    static bool parse(const std::string& text, ReplicationEndpoint& out) {
+        out = ReplicationEndpoint();
+        if (text.compare(0, 5, "unix:") == 0) {
+            out.local = true;
+            out.path = text.substr(5);
+            return !out.path.empty() && out.path.size() < sizeof(sockaddr_un::sun_path);
+        }
+        size_t colon = text.rfind(':');
+        if (colon == std::string::npos || colon + 1 == text.size()) return false;
+        out.host = colon > 0 ? text.substr(0, colon) : "0.0.0.0";
+        out.port = text.substr(colon + 1);
+        return true;
+    }
+};
+
+// A non-blocking stream socket carrying lines; every wait is bounded so
+// the threads using it notice a stop request
+class LineSocket {
+private:
+    int fd = -1;
+    std::string buffer;
+    size_t consumed = 0;
+
+public:
+    enum class Read { Line, Timeout, Closed };
+
+    explicit LineSocket(int socket_fd) : fd(socket_fd) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    ~LineSocket() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    LineSocket(const LineSocket&) = delete;
+    LineSocket& operator=(const LineSocket&) = delete;
+
+    bool sendAll(const std::string& data, int timeout_ms = 10000) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd ready{fd, POLLOUT, 0};
+                if (::poll(&ready, 1, timeout_ms) <= 0) return false;    // peer stopped reading
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Read readLine(std::string& line, int timeout_ms) {
+        for (;;) {
+            size_t newline = buffer.find('\n', consumed);
+            if (newline != std::string::npos) {
+                line.assign(buffer, consumed, newline - consumed);
+                consumed = newline + 1;
+                return Read::Line;
+            }
+            buffer.erase(0, consumed);
+            consumed = 0;
+
+            pollfd ready{fd, POLLIN, 0};
+            int polled = ::poll(&ready, 1, timeout_ms);
+            if (polled == 0) return Read::Timeout;
+            if (polled < 0) {
+                if (errno == EINTR) continue;
+                return Read::Closed;
+            }
+            char chunk[65536];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n == 0) return Read::Closed;
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+                return Read::Closed;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+};
+
+inline int replicationListen(const ReplicationEndpoint& endpoint, std::string& error) {
+    int fd = -1;
+    if (endpoint.local) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, endpoint.path.c_str(), sizeof(address.sun_path) - 1);
+        ::unlink(endpoint.path.c_str());    // left behind by a previous run
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+                        ::listen(fd, 16) != 0)) {
+            ::close(fd);
+            fd = -1;
+        }
+    } else {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* found = nullptr;
+        if (::getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &found) != 0) {
+            error = "cannot resolve " + endpoint.host;
+            return -1;
+        }
+        for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+            fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd < 0) continue;
+            int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (::bind(fd, a->ai_addr, a->ai_addrlen) != 0 || ::listen(fd, 16) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(found);
+    }
+    if (fd < 0) error = std::strerror(errno);
+    return fd;
+}
+
+inline int replicationConnect(const ReplicationEndpoint& endpoint, std::string& error, int timeout_ms = 2000) {
+    auto attempt = [&](int family, const sockaddr* address, socklen_t length) {
+        int fd = ::socket(family, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        if (::connect(fd, address, length) != 0) {
+            pollfd ready{fd, POLLOUT, 0};
+            int failure = errno;
+            if (errno == EINPROGRESS && ::poll(&ready, 1, timeout_ms) > 0) {
+                socklen_t size = sizeof(failure);
+                ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &failure, &size);
+            } else if (errno == EINPROGRESS) {
+                failure = ETIMEDOUT;
+            }
+            if (failure != 0) {
+                error = std::strerror(failure);
+                ::close(fd);
+                return -1;
+            }
+        }
+        if (family != AF_UNIX) {
+            int on = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        return fd;
+    };
+
+    if (endpoint.local) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, endpoint.path.c_str(), sizeof(address.sun_path) - 1);
+        return attempt(AF_UNIX, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (::getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &found) != 0) {
+        error = "cannot resolve " + endpoint.host;
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* a = found; a && fd < 0; a = a->ai_next) {
+        fd = attempt(a->ai_family, a->ai_addr, a->ai_addrlen);
+    }
+    ::freeaddrinfo(found);
+    return fd;
+}
+
+// Serves the change feed to replicas: a thread accepts connections and each
+// replica gets its own sender thread, so a slow replica only delays itself.
+// A replica that falls further behind than the change feed holds is
+// disconnected and reloads from a snapshot when it reconnects.
+class ReplicationPrimary {
+private:
+    static constexpr size_t kBatch = 512;
+    static constexpr size_t kFlushBytes = 64 * 1024;
+
+    struct Link {
+        ReplicaLinkStats stats;
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    ChangeFeed& feed;
+    ReplicationRegistry& registry;
+    uint64_t epoch;
+    int listen_fd = -1;
+    std::atomic<bool> running{false};
+    std::thread acceptor;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Link>> links;
+    uint64_t snapshots_served = 0;
+
+    // Appends the wire form of `event`; events for repositories that are
+    // not replicated, and alerts, which replicas raise themselves, are left
+    // out
+    void appendEvent(std::string& out, const ChangeEvent& event) {
+        ReplicationTarget target;
+        if (event.op == ChangeOp::Alert || !registry.find(event.resource, target)) return;
+        std::string data;
+        if (event.op == ChangeOp::Insert || event.op == ChangeOp::Update) {
+            if (!target.read(event.id, data)) return;       // removed since; its remove event follows
+        } else if (event.op == ChangeOp::Purge) {
+            data = event.data;
+        }
+        out += "EVENT " + std::to_string(event.sequence) + " " + std::to_string(event.time) + " " +
+               changeOpName(event.op) + " " + std::to_string(event.id) + " " + event.resource + " " + data + "\n";
+    }
+
+    // Sends every replicated repository; returns false when the replica
+    // went away. Changes made while the snapshot is read are also sent as
+    // events after it, starting from `position`.
+    bool sendSnapshot(LineSocket& socket, uint64_t position) {
+        std::string out = "SNAPSHOT " + std::to_string(epoch) + " " + std::to_string(position) + "\n";
+        bool ok = true;
+        for (const std::string& name : registry.names()) {
+            ReplicationTarget target;
+            if (!ok || !registry.find(name, target)) continue;
+            out += "BEGIN " + name + "\n";
+            target.dump([&](const std::string& json) {
+                if (!ok) return;
+                out += "RECORD " + json + "\n";
+                if (out.size() >= kFlushBytes) {
+                    ok = socket.sendAll(out);
+                    out.clear();
+                }
+            });
+        }
+        return ok && socket.sendAll(out + "END\n");
+    }
+
+    void serve(Link& link, std::unique_ptr<LineSocket> socket) {
+        std::string line;
+        if (socket->readLine(line, 10000) != LineSocket::Read::Line) return;
+        std::istringstream hello(line);
+        std::string word;
+        uint64_t their_epoch = 0, after = 0;
+        hello >> word >> their_epoch >> after;
+        if (word != "HELLO") return;
+
+        std::vector<ChangeEvent> events;
+        uint64_t cursor;
+        if (their_epoch == epoch && feed.since(after, events, 0)) {
+            cursor = after;
+            if (!socket->sendAll("RESUME " + std::to_string(epoch) + " " + std::to_string(cursor) + "\n")) return;
+        } else {
+            cursor = feed.lastSequence();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                link.stats.snapshot = true;
+                ++snapshots_served;
+            }
+            if (!sendSnapshot(*socket, cursor)) return;
+        }
+
+        auto last_ping = std::chrono::steady_clock::time_point();
+        while (running) {
+            feed.waitAfter(cursor, std::chrono::milliseconds(500));
+            events.clear();
+            if (!feed.since(cursor, events, kBatch)) {
+                std::cerr << "Replica " << link.stats.peer << " fell behind the change feed; it will reload" << std::endl;
+                return;
+            }
+            std::string out;
+            for (const ChangeEvent& event : events) {
+                appendEvent(out, event);
+                cursor = event.sequence;
+                if (out.size() >= kFlushBytes) {
+                    if (!socket->sendAll(out)) return;
+                    out.clear();
+                }
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (!events.empty() || now - last_ping >= std::chrono::seconds(1)) {
+                out += "PING " + std::to_string(cursor) + " " + std::to_string(feed.lastSequence()) + " " +
+                       std::to_string(time(nullptr)) + "\n";
+                last_ping = now;
+            }
+            if (!out.empty() && !socket->sendAll(out)) return;
+
+            uint64_t acked = 0;
+            for (;;) {
+                LineSocket::Read read = socket->readLine(line, 0);
+                if (read == LineSocket::Read::Closed) return;
+                if (read == LineSocket::Read::Timeout) break;
+                if (line.compare(0, 4, "ACK ") == 0) acked = std::max<uint64_t>(acked, std::strtoull(line.c_str() + 4, nullptr, 10));
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            link.stats.sent_sequence = cursor;
+            link.stats.acked_sequence = std::max(link.stats.acked_sequence, acked);
+        }
+    }
+
+    void acceptLoop() {
+        while (running) {
+            pollfd ready{listen_fd, POLLIN, 0};
+            if (::poll(&ready, 1, 200) > 0) {
+                sockaddr_storage address{};
+                socklen_t length = sizeof(address);
+                int fd = ::accept(listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+                if (fd >= 0) {
+                    auto link = std::make_unique<Link>();
+                    link->stats.connected_at = time(nullptr);
+                    char host[NI_MAXHOST] = "local", port[NI_MAXSERV] = "";
+                    if (address.ss_family != AF_UNIX) {
+                        ::getnameinfo(reinterpret_cast<sockaddr*>(&address), length, host, sizeof(host), port,
+                                      sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+                        int on = 1;
+                        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                    }
+                    link->stats.peer = port[0] ? std::string(host) + ":" + port : std::string(host);
+                    Link* raw = link.get();
+                    auto socket = std::make_unique<LineSocket>(fd);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    links.push_back(std::move(link));
+                    raw->thread = std::thread([this, raw, socket = std::move(socket)]() mutable {
+                        serve(*raw, std::move(socket));
+                        raw->done = true;
+                    });
+                }
+            }
+            reap(false);
+        }
+    }
+
+    // Joins finished sender threads, or all of them when `all`
+    void reap(bool all) {
+        std::vector<std::unique_ptr<Link>> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto keep = std::partition(links.begin(), links.end(),
+                                       [all](const std::unique_ptr<Link>& link) { return !all && !link->done; });
+            std::move(keep, links.end(), std::back_inserter(finished));
+            links.erase(keep, links.end());
+        }
+        for (auto& link : finished) link->thread.join();
+    }
+
+public:
+    ReplicationPrimary(ChangeFeed& change_feed, ReplicationRegistry& targets)
+        : feed(change_feed), registry(targets), epoch(std::random_device()() | 1ULL << 32) {}
+
+    ~ReplicationPrimary() { stop(); }
+
+    ReplicationPrimary(const ReplicationPrimary&) = delete;
+    ReplicationPrimary& operator=(const ReplicationPrimary&) = delete;
+
+    bool start(const std::string& endpoint_text, std::string& error) {
+        ReplicationEndpoint endpoint;
+        if (!ReplicationEndpoint::parse(endpoint_text, endpoint)) {
+            error = "bad endpoint '" + endpoint_text + "'";
+            return false;
+        }
+        listen_fd = replicationListen(endpoint, error);
+        if (listen_fd < 0) return false;
+        running = true;
+        acceptor = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        acceptor.join();
+        reap(true);
+        ::close(listen_fd);
+        listen_fd = -1;
+    }
+
+    void collect(ReplicationStats& stats) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.last_sequence = feed.lastSequence();
+        stats.snapshots_served = snapshots_served;
+        for (const auto& link : links) {
+            if (link->done) continue;
+            ReplicaLinkStats replica = link->stats;
+            replica.lag_events = stats.last_sequence - std::min(stats.last_sequence, replica.acked_sequence);
+            stats.replicas.push_back(replica);
+        }
+    }
+};
+
+// Follows a primary: loads a snapshot, then applies its events as they
+// arrive, reconnecting (and resuming where it can) whenever the connection
+// drops. Writes go through the registered replication targets, so services
+// keep their indexes current and the local change feed sees every change.
+class ReplicaClient {
+private:
+    ReplicationRegistry& registry;
+    ReplicationEndpoint endpoint;
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    // Resume point; only the worker thread touches these
+    uint64_t epoch = 0;
+    uint64_t applied = 0;
+    std::chrono::steady_clock::time_point last_heard;
+
+    mutable std::mutex mutex_;
+    ReplicationStats stats_;
+    std::chrono::steady_clock::time_point caught_up_at = std::chrono::steady_clock::now();
+
+    // Snapshot in progress: the repository being loaded and its records so
+    // far, held until the next BEGIN or the END
+    struct Loading {
+        std::string resource;
+        bool known = false;
+        ReplicationTarget target;
+        std::vector<std::string> records;
+    };
+
+    // Stores a repository's snapshot as one write, then removes what it did
+    // not contain as another. Record by record, every write would rewrite
+    // the repository, and the replica would fall too far behind the socket
+    // for the primary to keep sending.
+    static void load(Loading& loading) {
+        if (!loading.known) return;
+        std::vector<int> stored = loading.target.upsertMany(loading.records);
+        std::set<int> seen(stored.begin(), stored.end());
+        std::vector<int> stale;
+        for (int id : loading.target.ids()) {
+            if (!seen.count(id)) stale.push_back(id);
+        }
+        if (!stale.empty()) loading.target.removeMany(stale);
+    }
+
+    void applyEvent(const std::string& line) {
+        // EVENT <sequence> <time> <op> <id> <resource> <json>
+        size_t field[6];
+        size_t at = 0;
+        for (size_t& start : field) {
+            start = line.find(' ', at);
+            if (start == std::string::npos) throw std::runtime_error("malformed event");
+            at = ++start;
+        }
+        uint64_t sequence = std::strtoull(line.c_str() + field[0], nullptr, 10);
+        std::string op = line.substr(field[2], field[3] - field[2] - 1);
+        int id = std::atoi(line.c_str() + field[3]);
+        std::string resource = line.substr(field[4], field[5] - field[4] - 1);
+        std::string data = line.substr(field[5]);
+
+        ReplicationTarget target;
+        if (!registry.find(resource, target)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.skipped;
+        } else if (op == "insert" || op == "update") {
+            target.upsert(data);
+        } else if (op == "remove") {
+            target.remove(id);
+        } else if (op == "purge") {
+            target.removeMany(nlohmann::json::parse(data).value("ids", std::vector<int>()));
+        }
+        applied = sequence;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.applied_sequence = applied;
+        ++stats_.events_applied;
+    }
+
+    void session(std::string& error) {
+        int fd = replicationConnect(endpoint, error);
+        if (fd < 0) return;
+        LineSocket socket(fd);
+        if (!socket.sendAll("HELLO " + std::to_string(epoch) + " " + std::to_string(applied) + "\n")) {
+            error = "connection closed";
+            return;
+        }
+
+        Loading loading;
+        uint64_t snapshot_epoch = 0, snapshot_position = 0;
+        std::string line;
+        while (running) {
+            LineSocket::Read read = socket.readLine(line, 200);
+            if (read == LineSocket::Read::Closed) {
+                error = "connection closed";
+                return;
+            }
+            if (read == LineSocket::Read::Timeout) {
+                // The primary pings every second; 5s of silence means it is gone
+                if (std::chrono::steady_clock::now() - last_heard > std::chrono::seconds(5)) {
+                    error = "primary stopped responding";
+                    return;
+                }
+                continue;
+            }
+            last_heard = std::chrono::steady_clock::now();
+
+            size_t space = line.find(' ');
+            std::string word = line.substr(0, space);
+            std::string rest = space == std::string::npos ? std::string() : line.substr(space + 1);
+            try {
+                if (word == "EVENT") {
+                    applyEvent(line);
+                } else if (word == "RECORD") {
+                    if (loading.known) loading.records.push_back(std::move(rest));
+                } else if (word == "PING") {
+                    std::istringstream ping(rest);
+                    uint64_t sent = 0, last = 0;
+                    ping >> sent >> last;
+                    applied = std::max(applied, sent);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        stats_.applied_sequence = applied;
+                        stats_.primary_sequence = last;
+                        if (applied >= last) caught_up_at = std::chrono::steady_clock::now();
+                    }
+                    if (!socket.sendAll("ACK " + std::to_string(applied) + "\n")) {
+                        error = "connection closed";
+                        return;
+                    }
+                } else if (word == "BEGIN") {
+                    load(loading);
+                    loading = Loading();
+                    loading.resource = rest;
+                    loading.known = registry.find(rest, loading.target);
+                    if (!loading.known) {
+                        std::cerr << "Replica has no repository '" << rest << "'; skipping it" << std::endl;
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        ++stats_.skipped;
+                    }
+                } else if (word == "SNAPSHOT") {
+                    // Forget the old position until the snapshot is complete
+                    epoch = 0;
+                    applied = 0;
+                    std::istringstream header(rest);
+                    header >> snapshot_epoch >> snapshot_position;
+                } else if (word == "END") {
+                    load(loading);
+                    loading = Loading();
+                    epoch = snapshot_epoch;
+                    applied = snapshot_position;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.applied_sequence = applied;
+                    ++stats_.snapshots_loaded;
+                } else if (word == "RESUME") {
+                    std::istringstream header(rest);
+                    header >> epoch >> applied;
+                }
+            } catch (const std::exception& e) {
+                error = std::string("bad ") + word + " message: " + e.what();
+                return;
+            }
+            if (word == "END" || word == "RESUME") {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.connected = true;
+                stats_.last_error.clear();
+            }
+        }
+    }
+
+    void run() {
+        while (running) {
+            std::string error;
+            last_heard = std::chrono::steady_clock::now();
+            session(error);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.connected = false;
+                if (!error.empty()) stats_.last_error = error;
+                ++stats_.reconnects;
+            }
+            for (int i = 0; i < 10 && running; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+public:
+    explicit ReplicaClient(ReplicationRegistry& targets) : registry(targets) {}
+
+    ~ReplicaClient() { stop(); }
+
+    ReplicaClient(const ReplicaClient&) = delete;
+    ReplicaClient& operator=(const ReplicaClient&) = delete;
+
+    bool start(const std::string& endpoint_text, std::string& error) {
+        if (!ReplicationEndpoint::parse(endpoint_text, endpoint)) {
+            error = "bad endpoint '" + endpoint_text + "'";
+            return false;
+        }
+        running = true;
+        worker = std::thread([this]() { run(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        worker.join();
+    }
+
+    void collect(ReplicationStats& stats) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string role = stats.role, name = stats.endpoint;
+        stats = stats_;
+        stats.role = role;
+        stats.endpoint = name;
+        stats.lag_events = stats_.primary_sequence - std::min(stats_.primary_sequence, stats_.applied_sequence);
+        if (stats.lag_events > 0 || !stats_.connected) {
+            stats.lag_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - caught_up_at).count();
+        }
+    }
+};
+
+#endif // _WIN32
+
+// This process's part in replication, started from main() after the stores
+// are open: a primary listening for replicas, a replica following a
+// primary, or neither
+class ReplicationNode {
+private:
+    std::string role = "none";
+    std::string endpoint;
+#ifndef _WIN32
+    std::unique_ptr<ReplicationPrimary> primary;
+    std::unique_ptr<ReplicaClient> replica;
+#endif
+
+public:
+    // Serves the change feed at `listen`; needs the change feed on
+    bool startPrimary(const std::string& listen, ChangeFeed* feed) {
+#ifndef _WIN32
+        std::string error;
+        if (!feed) {
+            error = "the change feed is off (--change-feed-size=0)";
+        } else {
+            primary = std::make_unique<ReplicationPrimary>(*feed, replicationRegistry());
+            if (primary->start(listen, error)) {
+                role = "primary";
+                endpoint = listen;
+                return true;
+            }
+            primary.reset();
+        }
+        std::cerr << "Replication not started: " << error << std::endl;
+#else
+        (void)listen;
+        (void)feed;
+        std::cerr << "Replication is not supported on this platform" << std::endl;
+#endif
+        return false;
+    }
+
+    // Follows the primary at `source`; the caller keeps this process read-only
+    bool startReplica(const std::string& source) {
+#ifndef _WIN32
+        std::string error;
+        replica = std::make_unique<ReplicaClient>(replicationRegistry());
+        if (replica->start(source, error)) {
+            role = "replica";
+            endpoint = source;
+            return true;
+        }
+        replica.reset();
+        std::cerr << "Replication not started: " << error << std::endl;
+#else
+        (void)source;
+        std::cerr << "Replication is not supported on this platform" << std::endl;
+#endif
+        return false;
+    }
+
+    bool isReplica() const { return role == "replica"; }
+
+    void stop() {
+#ifndef _WIN32
+        if (primary) primary->stop();
+        if (replica) replica->stop();
+#endif
+    }
+
+    ReplicationStats stats() const {
+        ReplicationStats stats;
+        stats.role = role;
+        stats.endpoint = endpoint;
+#ifndef _WIN32
+        if (primary) primary->collect(stats);
+        if (replica) replica->collect(stats);
+#endif
+        return stats;
+    }
+};
+
+// Process-wide node (services_impl.cpp)
+ReplicationNode& getReplication();
+
+} // namespace dsms
@@ -0,0 +1,402 @@
+// report_kernels.h - Columnar sale arrays and aggregation kernels for reports
+#pragma once
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <utility>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include "worker_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DSMS_REPORT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace dsms {
+
+// sum/count/min/max over sale totals, plus the quantity sold
+struct SaleAggregate {
+    double revenue = 0.0;
+    uint64_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double quantity = 0.0;
+
+    void add(double total, int32_t qty) {
+        revenue += total;
+        ++count;
+        min = std::min(min, total);
+        max = std::max(max, total);
+        quantity += qty;
+    }
+
+    void merge(const SaleAggregate& other) {
+        revenue += other.revenue;
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        quantity += other.quantity;
+    }
+};
+
+// Sales as parallel arrays sorted by timestamp, so a time range is a
+// contiguous slice and the kernels stream plain doubles instead of
+// chasing shared_ptr<Sale>
+struct SaleColumns {
+    std::vector<int64_t> timestamps;
+    std::vector<double> totals;
+    std::vector<int32_t> quantities;
+    std::vector<int32_t> item_ids;
+    std::vector<int32_t> sale_ids;      // only kept by copies that drop sales later
+    int32_t max_item_id = 0;
+
+    size_t size() const { return timestamps.size(); }
+
+    size_t bytes() const {
+        return timestamps.capacity() * sizeof(int64_t) + totals.capacity() * sizeof(double) +
+               (quantities.capacity() + item_ids.capacity() + sale_ids.capacity()) * sizeof(int32_t);
+    }
+
+    void reserve(size_t n) {
+        timestamps.reserve(n);
+        totals.reserve(n);
+        quantities.reserve(n);
+        item_ids.reserve(n);
+    }
+
+    void append(int64_t timestamp, double total, int32_t quantity, int32_t item_id) {
+        timestamps.push_back(timestamp);
+        totals.push_back(total);
+        quantities.push_back(quantity);
+        item_ids.push_back(item_id);
+        max_item_id = std::max(max_item_id, item_id);
+    }
+
+    void append(int32_t sale_id, int64_t timestamp, double total, int32_t quantity, int32_t item_id) {
+        append(timestamp, total, quantity, item_id);
+        sale_ids.push_back(sale_id);
+    }
+
+    void appendFrom(const SaleColumns& other) {
+        timestamps.insert(timestamps.end(), other.timestamps.begin(), other.timestamps.end());
+        totals.insert(totals.end(), other.totals.begin(), other.totals.end());
+        quantities.insert(quantities.end(), other.quantities.begin(), other.quantities.end());
+        item_ids.insert(item_ids.end(), other.item_ids.begin(), other.item_ids.end());
+        sale_ids.insert(sale_ids.end(), other.sale_ids.begin(), other.sale_ids.end());
+        max_item_id = std::max(max_item_id, other.max_item_id);
+    }
+
+    // Drops the rows whose sale id is in `sorted_ids`, keeping the order;
+    // needs the sale_ids column. Returns how many were dropped.
+    size_t removeIds(const std::vector<int>& sorted_ids) {
+        size_t kept = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (std::binary_search(sorted_ids.begin(), sorted_ids.end(), sale_ids[i])) continue;
+            timestamps[kept] = timestamps[i];
+            totals[kept] = totals[i];
+            quantities[kept] = quantities[i];
+            item_ids[kept] = item_ids[i];
+            sale_ids[kept] = sale_ids[i];
+            ++kept;
+        }
+        size_t dropped = size() - kept;
+        timestamps.resize(kept);
+        totals.resize(kept);
+        quantities.resize(kept);
+        item_ids.resize(kept);
+        sale_ids.resize(kept);
+        return dropped;
+    }
+
+    void sortByTime() {
+        if (std::is_sorted(timestamps.begin(), timestamps.end())) return;
+        // Sorting (timestamp, row) pairs keeps the comparisons on contiguous
+        // memory; the row index also makes the order stable
+        std::vector<std::pair<int64_t, uint32_t>> keys(size());
+        for (size_t i = 0; i < keys.size(); ++i) keys[i] = {timestamps[i], static_cast<uint32_t>(i)};
+        std::sort(keys.begin(), keys.end());
+        std::vector<uint32_t> order(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) order[i] = keys[i].second;
+        permute(timestamps, order);
+        permute(totals, order);
+        permute(quantities, order);
+        permute(item_ids, order);
+        if (!sale_ids.empty()) permute(sale_ids, order);
+    }
+
+    // Rows [first, last) with start <= timestamp <= end
+    std::pair<size_t, size_t> rangeOf(time_t start, time_t end) const {
+        auto first = std::lower_bound(timestamps.begin(), timestamps.end(), static_cast<int64_t>(start));
+        auto last = std::upper_bound(first, timestamps.end(), static_cast<int64_t>(end));
+        return {static_cast<size_t>(first - timestamps.begin()), static_cast<size_t>(last - timestamps.begin())};
+    }
+
+private:
+    template<typename V>
+    static void permute(std::vector<V>& column, const std::vector<uint32_t>& order) {
+        std::vector<V> sorted(column.size());
+        for (size_t i = 0; i < order.size(); ++i) sorted[i] = column[order[i]];
+        column.swap(sorted);
+    }
+};
+
+namespace kernels {
+
+inline SaleAggregate aggregateScalar(const double* totals, const int32_t* quantities, size_t n) {
+    SaleAggregate result;
+    for (size_t i = 0; i < n; ++i) result.add(totals[i], quantities[i]);
+    return result;
+}
+
+#ifdef DSMS_REPORT_SSE2
+// Four rows per step over two pairs of lanes; quantities are widened to
+// double, which is exact for any realistic total. Summation order differs
+// from the scalar loop, so the last bits of `revenue` can differ too.
+inline SaleAggregate aggregateSse2(const double* totals, const int32_t* quantities, size_t n) {
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    __m128d qty0 = _mm_setzero_pd(), qty1 = _mm_setzero_pd();
+    __m128d min0 = _mm_set1_pd(std::numeric_limits<double>::infinity()), min1 = min0;
+    __m128d max0 = _mm_set1_pd(-std::numeric_limits<double>::infinity()), max1 = max0;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d a = _mm_loadu_pd(totals + i);
+        __m128d b = _mm_loadu_pd(totals + i + 2);
+        sum0 = _mm_add_pd(sum0, a);
+        sum1 = _mm_add_pd(sum1, b);
+        min0 = _mm_min_pd(min0, a);
+        min1 = _mm_min_pd(min1, b);
+        max0 = _mm_max_pd(max0, a);
+        max1 = _mm_max_pd(max1, b);
+
+        __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i));
+        qty0 = _mm_add_pd(qty0, _mm_cvtepi32_pd(q));
+        qty1 = _mm_add_pd(qty1, _mm_cvtepi32_pd(_mm_unpackhi_epi64(q, q)));
+    }
+
+    alignas(16) double lanes[2];
+    SaleAggregate result;
+    _mm_store_pd(lanes, _mm_add_pd(sum0, sum1));
+    result.revenue = lanes[0] + lanes[1];
+    _mm_store_pd(lanes, _mm_add_pd(qty0, qty1));
+    result.quantity = lanes[0] + lanes[1];
+    _mm_store_pd(lanes, _mm_min_pd(min0, min1));
+    result.min = std::min(lanes[0], lanes[1]);
+    _mm_store_pd(lanes, _mm_max_pd(max0, max1));
+    result.max = std::max(lanes[0], lanes[1]);
+    result.count = i;
+
+    result.merge(aggregateScalar(totals + i, quantities + i, n - i));
+    return result;
+}
+#endif
+
+inline SaleAggregate aggregate(const double* totals, const int32_t* quantities, size_t n) {
+#ifdef DSMS_REPORT_SSE2
+    return aggregateSse2(totals, quantities, n);
+#else
+    return aggregateScalar(totals, quantities, n);
+#endif
+}
+
+// Rows [first, last) of `columns`, accumulated into groups[key(row)].
+// Keys are dense indexes chosen by the caller; the loop is a scatter, so
+// it stays scalar but touches only the arrays it needs.
+template<typename Key>
+void aggregateByKey(const SaleColumns& columns, size_t first, size_t last, size_t group_count,
+                    Key key, std::vector<SaleAggregate>& groups) {
+    groups.assign(group_count, SaleAggregate());
+    const double* totals = columns.totals.data();
+    const int32_t* quantities = columns.quantities.data();
+    for (size_t i = first; i < last; ++i) {
+        groups[key(i)].add(totals[i], quantities[i]);
+    }
+}
+
+} // namespace kernels
+
+enum class ReportGrouping {
+    None,
+    Item,
+    Department,
+    Day
+};
+
+inline bool parseReportGrouping(const std::string& name, ReportGrouping& out) {
+    if (name.empty() || name == "none") out = ReportGrouping::None;
+    else if (name == "item") out = ReportGrouping::Item;
+    else if (name == "department") out = ReportGrouping::Department;
+    else if (name == "day") out = ReportGrouping::Day;
+    else return false;
+    return true;
+}
+
+struct SaleReport {
+    SaleAggregate total;
+    std::vector<std::pair<std::string, SaleAggregate>> groups;    // empty groups are omitted
+};
+
+// Maps an item id to an index into `names` (-1 or out of range = unassigned)
+struct DepartmentMap {
+    std::vector<int32_t> department_of_item;
+    std::vector<std::string> names;
+};
+
+// Aggregates of one contiguous row slice. Item and department groups are
+// dense arrays indexed by key; day groups are (day start, aggregate) pairs
+// in time order.
+struct ReportPartial {
+    SaleAggregate total;
+    std::vector<SaleAggregate> groups;
+    std::vector<std::pair<int64_t, SaleAggregate>> days;
+};
+
+inline void aggregateSlice(const SaleColumns& columns, size_t first, size_t last, ReportGrouping grouping,
+                           const DepartmentMap& departments, ReportPartial& out) {
+    out.total = kernels::aggregate(columns.totals.data() + first, columns.quantities.data() + first, last - first);
+    if (first == last) return;
+
+    const int32_t* items = columns.item_ids.data();
+    switch (grouping) {
+    case ReportGrouping::Item:
+        kernels::aggregateByKey(columns, first, last, static_cast<size_t>(columns.max_item_id) + 1,
+                                [items](size_t i) { return static_cast<size_t>(std::max(items[i], 0)); }, out.groups);
+        break;
+    case ReportGrouping::Department: {
+        const std::vector<int32_t>& department_of_item = departments.department_of_item;
+        size_t unassigned = departments.names.size();
+        kernels::aggregateByKey(columns, first, last, unassigned + 1,
+                                [&](size_t i) {
+                                    int32_t item = items[i];
+                                    if (item < 0 || static_cast<size_t>(item) >= department_of_item.size()) return unassigned;
+                                    int32_t department = department_of_item[item];
+                                    return department < 0 ? unassigned : static_cast<size_t>(department);
+                                }, out.groups);
+        break;
+    }
+    case ReportGrouping::Day: {
+        // Rows are sorted by time, so each day is a contiguous slice that
+        // the vector kernel can take whole
+        const int64_t* timestamps = columns.timestamps.data();
+        size_t row = first;
+        while (row < last) {
+            int64_t ts = timestamps[row];
+            int64_t day_start = (ts >= 0 ? ts / 86400 : (ts - 86399) / 86400) * 86400;
+            size_t day_end = static_cast<size_t>(
+                std::lower_bound(timestamps + row, timestamps + last, day_start + 86400) - timestamps);
+            out.days.emplace_back(day_start, kernels::aggregate(columns.totals.data() + row,
+                                                                columns.quantities.data() + row, day_end - row));
+            row = day_end;
+        }
+        break;
+    }
+    case ReportGrouping::None:
+        break;
+    }
+}
+
+// Folds `next` into `into`. When `next` starts on or after `into`'s last
+// day only that boundary day can overlap; otherwise days merge by date.
+inline void mergePartial(ReportPartial& into, const ReportPartial& next) {
+    into.total.merge(next.total);
+    if (into.groups.size() < next.groups.size()) into.groups.resize(next.groups.size());
+    for (size_t i = 0; i < next.groups.size(); ++i) into.groups[i].merge(next.groups[i]);
+
+    if (next.days.empty()) return;
+    if (into.days.empty() || into.days.back().first <= next.days.front().first) {
+        size_t from = 0;
+        if (!into.days.empty() && into.days.back().first == next.days.front().first) {
+            into.days.back().second.merge(next.days.front().second);
+            from = 1;
+        }
+        into.days.insert(into.days.end(), next.days.begin() + from, next.days.end());
+        return;
+    }
+    std::vector<std::pair<int64_t, SaleAggregate>> days;
+    days.reserve(into.days.size() + next.days.size());
+    auto a = into.days.begin();
+    auto b = next.days.begin();
+    while (a != into.days.end() || b != next.days.end()) {
+        if (b == next.days.end() || (a != into.days.end() && a->first < b->first)) {
+            days.push_back(*a++);
+        } else if (a == into.days.end() || b->first < a->first) {
+            days.push_back(*b++);
+        } else {
+            days.push_back(*a++);
+            days.back().second.merge((b++)->second);
+        }
+    }
+    into.days.swap(days);
+}
+
+inline SaleReport finishReport(const ReportPartial& partial, ReportGrouping grouping, const DepartmentMap& departments) {
+    SaleReport report;
+    report.total = partial.total;
+    for (size_t i = 0; i < partial.groups.size(); ++i) {
+        if (partial.groups[i].count == 0) continue;
+        if (grouping == ReportGrouping::Item) {
+            report.groups.emplace_back(std::to_string(i), partial.groups[i]);
+        } else {
+            report.groups.emplace_back(i < departments.names.size() ? departments.names[i] : "", partial.groups[i]);
+        }
+    }
+    for (const auto& day : partial.days) {
+        time_t day_start = static_cast<time_t>(day.first);
+        char key[16];
+        std::tm tm_utc{};
+#ifdef _WIN32
+        gmtime_s(&tm_utc, &day_start);
+#else
+        gmtime_r(&day_start, &tm_utc);
+#endif
+        std::strftime(key, sizeof(key), "%Y-%m-%d", &tm_utc);
+        report.groups.emplace_back(key, day.second);
+    }
+    return report;
+}
+
+// Slices smaller than this are not worth a hand-off to another thread
+constexpr size_t kMinRowsPerReportTask = 1 << 16;
+
+// Aggregate the sales in [start, end], optionally grouped. With a pool the
+// range is cut into up to `threads` slices aggregated concurrently (the
+// caller takes one) and merged in order, so the result does not depend on
+// the thread count beyond floating-point rounding.
+inline ReportPartial aggregateRange(const SaleColumns& columns, time_t start, time_t end, ReportGrouping grouping,
+                                    const DepartmentMap& departments, WorkerPool* pool, size_t threads) {
+    auto range = columns.rangeOf(start, end);
+    size_t rows = range.second - range.first;
+    size_t slices = std::max<size_t>(1, std::min(threads, rows / kMinRowsPerReportTask));
+    if (!pool) slices = 1;
+
+    std::vector<ReportPartial> partials(slices);
+    parallelFor(pool, slices, [&](size_t slice) {
+        size_t first = range.first + rows * slice / slices;
+        size_t last = range.first + rows * (slice + 1) / slices;
+        aggregateSlice(columns, first, last, grouping, departments, partials[slice]);
+    });
+    for (size_t slice = 1; slice < slices; ++slice) mergePartial(partials[0], partials[slice]);
+    return std::move(partials[0]);
+}
+
+inline SaleReport runSaleReport(const SaleColumns& columns, time_t start, time_t end, ReportGrouping grouping,
+                                const DepartmentMap& departments = {}, WorkerPool* pool = nullptr,
+                                size_t threads = 1) {
+    return finishReport(aggregateRange(columns, start, end, grouping, departments, pool, threads),
+                        grouping, departments);
+}
+
+// The same over sales split into a time-sorted base and a time-sorted
+// tail of later appends, whose times may fall anywhere in the base
+inline SaleReport runSaleReport(const SaleColumns& base, const SaleColumns& tail, time_t start, time_t end,
+                                ReportGrouping grouping, const DepartmentMap& departments = {},
+                                WorkerPool* pool = nullptr, size_t threads = 1) {
+    ReportPartial partial = aggregateRange(base, start, end, grouping, departments, pool, threads);
+    mergePartial(partial, aggregateRange(tail, start, end, grouping, departments, pool, threads));
+    return finishReport(partial, grouping, departments);
+}
+
+} // namespace dsms
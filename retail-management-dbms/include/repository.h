@@ -6,142 +6,861 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <set>
 #include <algorithm>
 #include <filesystem>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <array>
 #include <functional>
 #include <ctime>
+#include <chrono>
 #include <nlohmann/json.hpp>
 #include "json_util.h"
 #include "models.h"
+#include "model_serialization.h"
+#include "repository_base.h"
+#include "sqlite_repository.h"
+#include "snapshot.h"
+#include "durable_file.h"
+#include "partitioned_sale_store.h"
+#include "change_feed.h"
 
 namespace fs = std::filesystem;
 
 namespace dsms {
 
-template<typename T>
-class Repository {
-public:
-    virtual ~Repository() = default;
-    virtual std::shared_ptr<T> findById(int id) = 0;
-    virtual std::vector<std::shared_ptr<T>> findAll() = 0;
-    virtual bool save(const T& item) = 0;
-    virtual bool update(const T& item) = 0;
-    virtual bool remove(int id) = 0;
-};
-
+// The JSON file is the source of truth. With snapshots enabled, a binary
+// copy (<name>.snap) is written at checkpoints and mapped on startup when it
+// still matches the JSON file, which skips parsing entirely. Snapshot
+// records are decoded per read; only records that are saved, updated or
+// removed get an entry in `cache` or `removed`, which override the snapshot
+// until the next checkpoint.
 template<typename T>
 class JsonRepository : public Repository<T> {
 private:
     std::string filename;
+    std::string snapshot_file;
+    bool use_snapshot;
+    std::unique_ptr<Snapshot<T>> snapshot;
     std::map<int, std::shared_ptr<T>> cache;
+    std::set<int> removed;      // snapshot ids deleted since the last checkpoint
     int next_id;
+    std::atomic<uint64_t> version{0};
     std::mutex mutex_;
 
+    // Disk writes are ordered by write_mutex_, which may be taken while
+    // holding mutex_ but never the other way round
+    mutable std::mutex write_mutex_;
+    uint64_t written_generation = 0;
+    PersistenceCounters counters;
+
+    // Group/Async: the flusher thread sleeps on work_cv until `version`
+    // passes durable_generation. Writers publish work just by bumping the
+    // atomic `version`; they only take flush_mutex_ to wake the flusher when
+    // it is idle, so a busy flusher costs the request path no locking.
+    DurabilityMode durability;
+    std::chrono::milliseconds async_delay;
+    std::thread flusher;
+    std::mutex flush_mutex_;
+    std::condition_variable work_cv;
+    std::condition_variable flushed_cv;
+    std::atomic<bool> flusher_idle{false};
+    bool stopping = false;
+    uint64_t durable_generation = 0;    // guarded by flush_mutex_
+    uint64_t failed_generation = 0;     // newest generation whose write failed
+
+    // A record put in `cache` by a save, and what it replaced there
+    struct SavedSlot {
+        int id;
+        std::shared_ptr<T> stored;
+        std::shared_ptr<T> previous;    // nullptr: the snapshot's copy, or none
+        bool was_removed;
+    };
+
+    // Callers of the *Locked helpers hold mutex_
+    SavedSlot putLocked(const T& item) {
+        int id = item.getId();
+        auto it = cache.find(id);
+        SavedSlot slot{id, std::make_shared<T>(item), it != cache.end() ? it->second : nullptr, removed.count(id) > 0};
+        cache[id] = slot.stored;
+        removed.erase(id);
+        return slot;
+    }
+
+    // After a failed commit, puts back what the saves replaced, unless a
+    // later write replaced it again, so a record the caller was told is not
+    // saved is not served either. next_id goes back if no other save took
+    // an id since. The version moves on rather than back: readers may have
+    // seen the failed records under the version they were saved at.
+    void rollbackLocked(const std::vector<SavedSlot>& slots, int previous_next_id, int assigned_next_id) {
+        bool changed = false;
+        for (auto slot = slots.rbegin(); slot != slots.rend(); ++slot) {
+            auto it = cache.find(slot->id);
+            if (it == cache.end() || it->second != slot->stored) continue;
+            if (slot->previous) {
+                it->second = slot->previous;
+            } else {
+                cache.erase(it);
+            }
+            if (slot->was_removed) removed.insert(slot->id);
+            changed = true;
+        }
+        if (next_id == assigned_next_id) next_id = previous_next_id;
+        if (changed) ++version;
+    }
+
+    bool existsLocked(int id) const {
+        if (cache.count(id)) return true;
+        return snapshot && !removed.count(id) && snapshot->indexOf(id) < snapshot->size();
+    }
+
+    // Visit every live record in id order, merging the snapshot with cache
+    template<typename Visitor>
+    void forEachLocked(Visitor visit) const {
+        auto it = cache.begin();
+        size_t count = snapshot ? snapshot->size() : 0;
+        for (size_t i = 0; i < count; ++i) {
+            int id = snapshot->idAt(i);
+            for (; it != cache.end() && it->first < id; ++it) visit(it->second);
+            if (it != cache.end() && it->first == id) {
+                visit(it->second);
+                ++it;
+                continue;
+            }
+            if (removed.count(id)) continue;
+            visit(std::make_shared<T>(snapshot->at(i)));
+        }
+        for (; it != cache.end(); ++it) visit(it->second);
+    }
+
+    bool checkpointLocked() {
+        std::vector<std::shared_ptr<T>> records;
+        forEachLocked([&records](const std::shared_ptr<T>& record) { records.push_back(record); });
+
+        // Drop the old mapping before replacing its file (Windows refuses to
+        // rename over a mapped file); the records are fully materialized
+        // meanwhile so nothing is lost if the write fails
+        snapshot.reset();
+        removed.clear();
+        cache.clear();
+        for (const auto& record : records) cache[record->getId()] = record;
+
+        // The snapshot is tagged with the data file's size and mtime, so that
+        // file must hold exactly this image; flush it first if a writer has
+        // not got there yet
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        if (written_generation < version.load()) {
+            nlohmann::json image = nlohmann::json::array();
+            for (const auto& record : records) image.push_back(*record);
+            if (!persistLocked(encodeDataFile(image), version.load())) return false;
+        }
+
+        SnapshotSource source = SnapshotSource::of(filename);
+        if (!Snapshot<T>::write(snapshot_file, records, source)) {
+            std::cerr << "Error writing snapshot: " << snapshot_file << std::endl;
+            return false;
+        }
+        snapshot = Snapshot<T>::open(snapshot_file, source);
+        if (!snapshot) return false;
+        cache.clear();
+        return true;
+    }
+
+    nlohmann::json recordsLocked() const {
+        nlohmann::json records = nlohmann::json::array();
+        forEachLocked([&records](const std::shared_ptr<T>& record) {
+            records.push_back(*record); // Serialize using to_json
+        });
+        return records;
+    }
+
+    // Writes the current image unless a newer one is already on disk.
+    // Runs without mutex_ so readers are not blocked behind fsync; callers
+    // serialize under mutex_ first, so a higher generation is always a newer
+    // image and concurrent writers coalesce onto whichever flushes last.
+    bool persist(const std::string& document, uint64_t generation) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return persistLocked(document, generation);
+    }
+
+    // Caller holds write_mutex_
+    bool persistLocked(const std::string& document, uint64_t generation) {
+        if (written_generation >= generation) {
+            counters.recordCoalesced();
+            return true;
+        }
+        auto started = std::chrono::steady_clock::now();
+        std::string error;
+        bool ok = writeFileAtomically(filename, document, error);
+        counters.recordFlush(started, ok);
+        if (!ok) {
+            std::cerr << "Error saving data: " << error << std::endl;
+            return false;
+        }
+        written_generation = generation;
+        return true;
+    }
+
+    // Make mutation `generation` durable as `durability` demands. Called
+    // with mutex_ held through `lock`; returns with it released.
+    bool commit(std::unique_lock<std::mutex>& lock, uint64_t generation) {
+        if (durability == DurabilityMode::Sync) {
+            std::string document = encodeDataFile(recordsLocked());
+            lock.unlock();
+            return persist(document, generation);
+        }
+        lock.unlock();
+        if (durability == DurabilityMode::Async) {
+            if (flusher_idle.load()) {
+                std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+                work_cv.notify_one();
+            }
+            return true;
+        }
+
+        std::unique_lock<std::mutex> flush_lock(flush_mutex_);
+        work_cv.notify_one();
+        flushed_cv.wait(flush_lock, [this, generation]() {
+            return durable_generation >= generation || failed_generation >= generation || stopping;
+        });
+        return durable_generation >= generation;
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(flush_mutex_);
+        for (;;) {
+            flusher_idle = true;
+            work_cv.wait(lock, [this]() { return stopping || version.load() > durable_generation; });
+            flusher_idle = false;
+
+            // Async: let more changes accumulate so one write covers them
+            if (durability == DurabilityMode::Async && !stopping) {
+                work_cv.wait_for(lock, async_delay, [this]() { return stopping; });
+            }
+            if (version.load() <= durable_generation) {
+                if (stopping) return;
+                continue;
+            }
+
+            lock.unlock();
+            std::string document;
+            uint64_t generation;
+            {
+                std::lock_guard<std::mutex> data_lock(mutex_);
+                generation = version.load();
+                document = encodeDataFile(recordsLocked());
+            }
+            bool ok = persist(document, generation);
+            lock.lock();
+
+            if (ok) {
+                durable_generation = generation;
+            } else {
+                failed_generation = generation;
+            }
+            flushed_cv.notify_all();
+            if (!ok) {
+                if (stopping) return;
+                // Leave the disk a moment before retrying
+                work_cv.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping; });
+            }
+        }
+    }
+
+    void stopFlusher() {
+        if (!flusher.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            stopping = true;
+        }
+        work_cv.notify_all();
+        flusher.join();
+        flushed_cv.notify_all();
+    }
+
     void loadCache() {
         std::lock_guard<std::mutex> lock(mutex_);
         cache.clear();
+        removed.clear();
+        snapshot.reset();
         next_id = 1;
 
-        if (!fs::exists(filename)) {
-            fs::path dir = fs::path(filename).parent_path();
-            if (!dir.empty() && !fs::exists(dir)) {
-                fs::create_directories(dir);
+        std::string backup = backupPathFor(filename);
+        if (!fs::exists(filename) && !fs::exists(backup)) {
+            std::string error;
+            if (!writeFileAtomically(filename, encodeDataFile(nlohmann::json::array()), error)) {
+                std::cerr << "Error creating data file: " << error << std::endl;
             }
-            std::ofstream file(filename);
-            file << "[]";
             return;
         }
 
-        try {
-            std::ifstream file(filename);
-            nlohmann::json jsonData;
-            file >> jsonData;
-
-            for (const auto& itemData : jsonData) {
-                T item = itemData.get<T>(); // Deserialize using from_json
-                cache[item.getId()] = std::make_shared<T>(item);
+        if (use_snapshot) {
+            snapshot = Snapshot<T>::open(snapshot_file, SnapshotSource::of(filename));
+            if (snapshot) {
+                next_id = snapshot->maxId() + 1;
+                return;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error loading data: " << e.what() << std::endl;
         }
-    }
 
-    void saveCache() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        try {
-            nlohmann::json jsonData;
-            for (const auto& pair : cache) {
-                jsonData.push_back(pair.second); // Serialize using to_json
+        // Fall back to the previous generation when the current file is
+        // missing, torn, or fails its checksum
+        std::vector<T> records;
+        std::string loaded_from;
+        for (const std::string& candidate : {filename, backup}) {
+            std::string text, error;
+            if (!readWholeFile(candidate, text)) continue;
+            if (decodeDataFile<T>(text, records, error)) {
+                loaded_from = candidate;
+                break;
             }
+            records.clear();
+            std::cerr << "Ignoring " << candidate << ": " << error << std::endl;
+        }
+
+        for (const T& item : records) {
+            cache[item.getId()] = std::make_shared<T>(item);
+            next_id = std::max(next_id, item.getId() + 1);
+        }
 
-            std::ofstream file(filename);
-            file << jsonData.dump(4);
-        } catch (const std::exception& e) {
-            std::cerr << "Error saving data: " << e.what() << std::endl;
+        if (loaded_from != filename) {
+            if (loaded_from.empty()) {
+                std::cerr << "No readable copy of " << filename << ", starting empty" << std::endl;
+            } else {
+                std::cerr << "Recovered " << filename << " from " << loaded_from << std::endl;
+            }
+            // Keep the damaged file for inspection, then put a good copy in place
+            std::error_code ec;
+            if (fs::exists(filename)) {
+                fs::rename(filename, filename + ".corrupt-" + std::to_string(std::time(nullptr)), ec);
+            }
+            std::string error;
+            if (!writeFileAtomically(filename, encodeDataFile(recordsLocked()), error)) {
+                std::cerr << "Error restoring data file: " << error << std::endl;
+            }
         }
+
+        // Parsed the slow way; leave a snapshot for the next start
+        if (use_snapshot) checkpointLocked();
     }
 
 public:
-    JsonRepository(const std::string& file) : filename(file), next_id(1) {
+    JsonRepository(const std::string& file, bool snapshots = false,
+                   DurabilityMode mode = DurabilityMode::Sync,
+                   std::chrono::milliseconds async_flush_delay = std::chrono::milliseconds(200))
+        : filename(file), snapshot_file(fs::path(file).replace_extension(".snap").string()),
+          use_snapshot(snapshots), next_id(1), durability(mode), async_delay(async_flush_delay) {
         fs::path dir = fs::path(filename).parent_path();
         if (!dir.empty() && !fs::exists(dir)) {
             fs::create_directories(dir);
         }
         loadCache();
+        if (durability != DurabilityMode::Sync) {
+            flusher = std::thread([this]() { flushLoop(); });
+        }
+    }
+
+    ~JsonRepository() override {
+        // Pending Group/Async changes are written before the flusher exits
+        stopFlusher();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (use_snapshot && (!cache.empty() || !removed.empty())) {
+            checkpointLocked();
+        }
+    }
+
+    // Write the current contents as the startup snapshot. Returns false when
+    // snapshots are disabled or the write fails.
+    bool checkpoint() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return use_snapshot && checkpointLocked();
     }
 
     std::shared_ptr<T> findById(int id) override {
         std::lock_guard<std::mutex> lock(mutex_);
         auto it = cache.find(id);
-        return (it != cache.end()) ? it->second : nullptr;
+        if (it != cache.end()) return it->second;
+        if (!snapshot || removed.count(id)) return nullptr;
+        size_t index = snapshot->indexOf(id);
+        return index < snapshot->size() ? std::make_shared<T>(snapshot->at(index)) : nullptr;
     }
 
     std::vector<std::shared_ptr<T>> findAll() override {
         std::lock_guard<std::mutex> lock(mutex_);
         std::vector<std::shared_ptr<T>> result;
-        for (const auto& pair : cache) {
-            result.push_back(pair.second);
-        }
+        forEachLocked([&result](const std::shared_ptr<T>& record) { result.push_back(record); });
         return result;
     }
 
     bool save(const T& item) override {
-        std::lock_guard<std::mutex> lock(mutex_);
+        int id;
+        return saveWithId(item, id);
+    }
+
+    bool saveWithId(const T& item, int& id) override {
+        std::unique_lock<std::mutex> lock(mutex_);
         T mutable_item = item;
+        int previous_next_id = next_id;
         if (mutable_item.getId() <= 0) {
             mutable_item.setId(next_id++);
+        } else {
+            next_id = std::max(next_id, mutable_item.getId() + 1);
         }
-        cache[mutable_item.getId()] = std::make_shared<T>(mutable_item);
-        saveCache();
-        return true;
+        id = mutable_item.getId();
+        SavedSlot slot = putLocked(mutable_item);
+        int assigned_next_id = next_id;
+        if (commit(lock, ++version)) return true;
+        lock.lock();
+        rollbackLocked({slot}, previous_next_id, assigned_next_id);
+        return false;
     }
 
     bool update(const T& item) override {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
         int id = item.getId();
-        if (cache.find(id) == cache.end()) return false;
+        if (!existsLocked(id)) return false;
         cache[id] = std::make_shared<T>(item);
-        saveCache();
-        return true;
+        return commit(lock, ++version);
     }
 
     bool remove(int id) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!existsLocked(id)) return false;
+        cache.erase(id);
+        if (snapshot && snapshot->indexOf(id) < snapshot->size()) {
+            removed.insert(id);
+        }
+        return commit(lock, ++version);
+    }
+
+    // One commit for the batch
+    size_t saveMany(const std::vector<T>& items, std::vector<int>* stored_ids = nullptr) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int previous_next_id = next_id;
+        std::vector<SavedSlot> slots;
+        std::vector<int> stored;
+        for (const auto& item : items) {
+            int id = item.getId();
+            if (id <= 0) continue;
+            next_id = std::max(next_id, id + 1);
+            slots.push_back(putLocked(item));
+            stored.push_back(id);
+        }
+        if (stored.empty()) return 0;
+        int assigned_next_id = next_id;
+        if (!commit(lock, ++version)) {
+            lock.lock();
+            rollbackLocked(slots, previous_next_id, assigned_next_id);
+            return 0;
+        }
+        if (stored_ids) stored_ids->insert(stored_ids->end(), stored.begin(), stored.end());
+        return stored.size();
+    }
+
+    size_t removeMany(const std::vector<int>& ids, std::vector<int>* removed_ids = nullptr) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<int> erased;
+        for (int id : ids) {
+            if (!existsLocked(id)) continue;
+            cache.erase(id);
+            if (snapshot && snapshot->indexOf(id) < snapshot->size()) {
+                removed.insert(id);
+            }
+            erased.push_back(id);
+        }
+        if (erased.empty() || !commit(lock, ++version)) return 0;
+        if (removed_ids) removed_ids->insert(removed_ids->end(), erased.begin(), erased.end());
+        return erased.size();
+    }
+
+    uint64_t getVersion() const override {
+        return version.load();
+    }
+
+    PersistenceStats persistenceStats() const override {
+        PersistenceStats stats = counters.stats();
+        stats.durability = durabilityName(durability);
+        uint64_t current = version.load();
+        uint64_t written;
+        {
+            std::lock_guard<std::mutex> lock(write_mutex_);
+            written = written_generation;
+        }
+        stats.pending = current > written ? current - written : 0;
+        return stats;
+    }
+
+    template<typename Predicate>
+    std::vector<std::shared_ptr<T>> filter(Predicate predicate) {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (cache.erase(id) > 0) {
-            saveCache();
+        std::vector<std::shared_ptr<T>> result;
+        forEachLocked([&](const std::shared_ptr<T>& record) {
+            if (predicate(record)) {
+                result.push_back(record);
+            }
+        });
+        return result;
+    }
+};
+
+// Storage backend selection, read when a named repository is constructed
+enum class StorageBackend { Json, Sqlite };
+
+struct StorageConfig {
+    StorageBackend backend = StorageBackend::Json;
+    std::string data_dir = "data";
+    bool snapshots = false;     // JSON backend only, see JsonRepository
+
+    // Per-repository durability, keyed by storage name ("sales", ...);
+    // repositories not listed use `durability`
+    DurabilityMode durability = DurabilityMode::Sync;
+    std::map<std::string, DurabilityMode> durability_overrides;
+    std::chrono::milliseconds async_flush_delay{200};
+
+    // Sales only: split storage into per-day/month segments (JSON backend)
+    bool partition_sales = false;
+    PartitionGranularity sale_granularity = PartitionGranularity::Day;
+    int sale_freeze_after_days = 30;
+    size_t sale_memory_budget = 0;      // bytes of resident sales, 0 = unbounded
+
+    // Mutations kept for /api/events readers to resume from; 0 turns the
+    // change feed off
+    size_t change_feed_capacity = 4096;
+
+    DurabilityMode durabilityFor(const std::string& name) const {
+        auto it = durability_overrides.find(name);
+        return it != durability_overrides.end() ? it->second : durability;
+    }
+};
+
+inline StorageConfig& storageConfig() {
+    static StorageConfig config;
+    return config;
+}
+
+// Every named repository publishes its mutations here
+inline ChangeFeed& changeFeed() {
+    static ChangeFeed feed(storageConfig().change_feed_capacity);
+    return feed;
+}
+
+// Store ids become directory names, so they are kept to [A-Za-z0-9_-]
+inline bool isValidStoreId(const std::string& store) {
+    if (store.empty() || store.size() > 32) return false;
+    for (char c : store) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Storage name of a repository: "items" for the default store and
+// "stores/<id>/items" for the others. It is the path under data_dir and the
+// change feed resource, so each store has its own files and events.
+inline std::string storeStorageName(const std::string& store, const std::string& name) {
+    return store.empty() ? name : "stores/" + store + "/" + name;
+}
+
+// `name` is the JSON file stem under data_dir and, for SQLite, the table
+// lives in the dsms.db beside it: <data_dir>/dsms.db for the default store,
+// one database per store otherwise. Durability overrides are looked up by
+// the repository name without the store prefix.
+template<typename T>
+std::unique_ptr<Repository<T>> makeBackend(const std::string& name) {
+    const StorageConfig& config = storageConfig();
+    size_t slash = name.rfind('/');
+    std::string dir = slash == std::string::npos ? config.data_dir : config.data_dir + "/" + name.substr(0, slash);
+    DurabilityMode durability = config.durabilityFor(slash == std::string::npos ? name : name.substr(slash + 1));
+    if (config.backend == StorageBackend::Sqlite) {
+        return std::make_unique<SqliteRepository<T>>(dir + "/dsms.db", durability);
+    }
+    return std::make_unique<JsonRepository<T>>(config.data_dir + "/" + name + ".json", config.snapshots,
+                                               durability, config.async_flush_delay);
+}
+
+// Forwards to whichever backend storageConfig() selected and publishes each
+// successful mutation to changeFeed() under the storage name. Every write
+// stamps the record with the next revision (1 for a new record), under the
+// record's stripe, so clients can update conditionally on the revision
+// they read.
+template<typename T>
+class BackedRepository : public Repository<T> {
+protected:
+    std::string name;
+    std::unique_ptr<Repository<T>> backend;
+    ChangeFeed* feed;
+
+    // Held across a mutation and its publish so that events for one record
+    // reach the feed in the order the backend applied them; striped by id
+    // so unrelated writes still commit (and group-commit) concurrently
+    std::array<std::mutex, 16> publish_stripes;
+
+    std::mutex& stripeFor(int id) {
+        return publish_stripes[static_cast<unsigned>(id) % publish_stripes.size()];
+    }
+
+    void publish(ChangeOp op, int id, const T& record) {
+        if (feed) feed->publish(name, op, id, record.toJsonString());
+    }
+
+    // Applied writes reach the write listeners. After a failed write the
+    // listeners get whatever the backend now holds for that id, or, when
+    // that cannot be told, `resyncs` moves.
+    using WriteListener = std::function<void(ChangeOp op, int id, const T* record)>;
+    std::mutex listeners_mutex_;
+    std::vector<WriteListener> write_listeners;
+    std::atomic<uint64_t> resyncs{0};
+
+    void notifyWrite(ChangeOp op, int id, const T* record) {
+        std::vector<WriteListener> listeners;
+        {
+            std::lock_guard<std::mutex> lock(listeners_mutex_);
+            listeners = write_listeners;
+        }
+        for (const auto& listener : listeners) listener(op, id, record);
+    }
+
+    void noteFailedWrite(int id) {
+        if (id <= 0) {
+            ++resyncs;
+            return;
+        }
+        auto current = backend->findById(id);
+        notifyWrite(current ? ChangeOp::Update : ChangeOp::Remove, id, current.get());
+    }
+
+    // After storing `stored`, which replaced a record when `existed`; its
+    // id is only known after a failure if the caller chose it
+    void noteSave(bool ok, bool existed, const T& stored) {
+        if (!ok) {
+            noteFailedWrite(stored.getId());
+        } else {
+            notifyWrite(existed ? ChangeOp::Update : ChangeOp::Insert, stored.getId(), &stored);
+        }
+    }
+
+public:
+    explicit BackedRepository(const std::string& storage_name)
+        : BackedRepository(storage_name, makeBackend<T>(storage_name)) {}
+
+    BackedRepository(const std::string& storage_name, std::unique_ptr<Repository<T>> store)
+        : name(storage_name), backend(std::move(store)),
+          feed(storageConfig().change_feed_capacity > 0 ? &changeFeed() : nullptr) {
+        Repository<T>* target = backend.get();
+        persistenceRegistry().add(name, [target]() { return target->persistenceStats(); });
+        replicationRegistry().add(name, replicationTarget());
+    }
+
+    ~BackedRepository() override {
+        persistenceRegistry().remove(name);
+        replicationRegistry().remove(name);
+    }
+
+    const std::string& storageName() const { return name; }
+
+    // Called on the writing thread after each write the backend applied, in
+    // order for any one record: Insert with the record stored under a new
+    // id, Update with the record that replaced one, Remove with nullptr
+    // (once per id for removeMany). A replicated batch is not reported
+    // record by record; it moves resyncCount(). Structures derived from
+    // the records follow these and reload only when resyncCount() moves.
+    void addWriteListener(WriteListener listener) {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        write_listeners.push_back(std::move(listener));
+    }
+
+    // Moves when the records may have changed in ways the listeners did not
+    // hear of
+    uint64_t resyncCount() const { return resyncs.load(); }
+
+    // Memory held for structures derived from these records, such as
+    // report columns. A backend with a memory budget counts it too.
+    void adjustDerivedBytes(int64_t delta) override { backend->adjustDerivedBytes(delta); }
+
+    // Replication reads and writes straight through this repository
+    ReplicationTarget replicationTarget() {
+        ReplicationTarget target;
+        target.read = [this](int id, std::string& json) {
+            auto record = findById(id);
+            if (!record) return false;
+            json = nlohmann::json(*record).dump();
+            return true;
+        };
+        target.dump = [this](const std::function<void(const std::string&)>& out) {
+            for (const auto& record : findAll()) out(nlohmann::json(*record).dump());
+        };
+        target.ids = [this]() {
+            std::vector<int> ids;
+            for (const auto& record : findAll()) ids.push_back(record->getId());
+            return ids;
+        };
+        target.upsert = [this](const std::string& json) {
+            int id;
+            return saveReplicated(nlohmann::json::parse(json).get<T>(), id) ? id : -1;
+        };
+        target.remove = [this](int id) { return remove(id); };
+        target.upsertMany = [this](const std::vector<std::string>& json) {
+            std::vector<T> items;
+            items.reserve(json.size());
+            for (const auto& record : json) items.push_back(nlohmann::json::parse(record).get<T>());
+            std::vector<int> ids;
+            saveReplicatedMany(items, &ids);
+            return ids;
+        };
+        target.removeMany = [this](const std::vector<int>& ids) { return removeMany(ids); };
+        return target;
+    }
+
+    std::shared_ptr<T> findById(int id) override { return backend->findById(id); }
+    std::vector<std::shared_ptr<T>> findAll() override { return backend->findAll(); }
+    bool save(const T& item) override {
+        int id;
+        return saveWithId(item, id);
+    }
+
+    bool saveWithId(const T& item, int& id) override {
+        T stored(item);
+        if (item.getId() <= 0) {
+            // A new id cannot collide with a concurrent write to the same record
+            stored.setRevision(1);
+            if (!backend->saveWithId(stored, id)) {
+                noteFailedWrite(0);
+                return false;
+            }
+            stored.setId(id);
+            publish(ChangeOp::Insert, id, stored);
+            noteSave(true, false, stored);
             return true;
         }
-        return false;
+        std::lock_guard<std::mutex> lock(stripeFor(item.getId()));
+        auto current = backend->findById(item.getId());
+        stored.setRevision(current ? current->getRevision() + 1 : 1);
+        bool ok = backend->saveWithId(stored, id);
+        if (ok) publish(ChangeOp::Insert, id, stored);
+        noteSave(ok, current != nullptr, stored);
+        return ok;
+    }
+
+    // Stores a record as another node wrote it, revision included, so a
+    // replica hands out the same revisions as its primary
+    bool saveReplicated(const T& item, int& id) {
+        std::lock_guard<std::mutex> lock(stripeFor(item.getId()));
+        bool existed = item.getId() > 0 && backend->findById(item.getId()) != nullptr;
+        bool ok = backend->saveWithId(item, id);
+        if (ok) publish(ChangeOp::Insert, id, item);
+        T stored(item);
+        if (ok) stored.setId(id);
+        noteSave(ok, existed, stored);
+        return ok;
+    }
+
+    // saveReplicated() for a batch, stored by the backend as one write.
+    // The write listeners are not told of each record; resyncCount() moves
+    // once instead, so derived structures reload once after a snapshot.
+    size_t saveReplicatedMany(const std::vector<T>& items, std::vector<int>* stored_ids = nullptr) {
+        // Every stripe, so no single-record write interleaves with the batch
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (auto& stripe : publish_stripes) locks.emplace_back(stripe);
+        std::vector<int> stored;
+        size_t count = backend->saveMany(items, &stored);
+        if (feed && count > 0) {
+            std::map<int, const T*> by_id;
+            for (const auto& item : items) by_id[item.getId()] = &item;
+            for (int id : stored) publish(ChangeOp::Insert, id, *by_id[id]);
+        }
+        if (!items.empty()) ++resyncs;
+        if (stored_ids) stored_ids->insert(stored_ids->end(), stored.begin(), stored.end());
+        return count;
+    }
+
+    bool update(const T& item) override {
+        std::lock_guard<std::mutex> lock(stripeFor(item.getId()));
+        auto current = backend->findById(item.getId());
+        T stored(item);
+        stored.setRevision(current ? current->getRevision() + 1 : 1);
+        bool ok = backend->update(stored);
+        if (!ok) {
+            noteFailedWrite(item.getId());
+            return false;
+        }
+        publish(ChangeOp::Update, item.getId(), stored);
+        notifyWrite(ChangeOp::Update, item.getId(), &stored);
+        return true;
+    }
+
+    // update() that only applies while the stored record is still at
+    // `expected`. `revision` gets the stored revision afterwards (the new
+    // one on success, the current one on a conflict).
+    UpdateResult compareAndUpdate(const T& item, uint64_t expected, uint64_t& revision) {
+        std::lock_guard<std::mutex> lock(stripeFor(item.getId()));
+        auto current = backend->findById(item.getId());
+        if (!current) return UpdateResult::NotFound;
+        revision = current->getRevision();
+        if (revision != expected) return UpdateResult::Conflict;
+        T stored(item);
+        stored.setRevision(expected + 1);
+        bool ok = backend->update(stored);
+        if (!ok) {
+            noteFailedWrite(item.getId());
+            return UpdateResult::Failed;
+        }
+        revision = stored.getRevision();
+        publish(ChangeOp::Update, item.getId(), stored);
+        notifyWrite(ChangeOp::Update, item.getId(), &stored);
+        return UpdateResult::Updated;
+    }
+
+    bool remove(int id) override {
+        std::lock_guard<std::mutex> lock(stripeFor(id));
+        if (!backend->remove(id)) {
+            noteFailedWrite(id);
+            return false;
+        }
+        if (feed) feed->publish(name, ChangeOp::Remove, id, std::string());
+        notifyWrite(ChangeOp::Remove, id, nullptr);
+        return true;
+    }
+
+    // One purge event instead of an event per record, so a retention pass
+    // does not flush the feed. It lists the ids the backend removed, for
+    // replicas.
+    size_t removeMany(const std::vector<int>& ids, std::vector<int>* removed_ids = nullptr) override {
+        std::vector<int> erased;
+        size_t removed = backend->removeMany(ids, &erased);
+        for (int id : erased) notifyWrite(ChangeOp::Remove, id, nullptr);
+        // Fewer than asked: missing ids, or a failed batch the backend may
+        // have dropped from memory anyway
+        if (erased.size() < ids.size()) ++resyncs;
+        if (removed > 0 && feed) {
+            std::string data = "{\"count\":" + std::to_string(erased.size()) + ",\"ids\":[";
+            for (size_t i = 0; i < erased.size(); ++i) data += (i ? "," : "") + std::to_string(erased[i]);
+            feed->publish(name, ChangeOp::Purge, 0, data + "]}");
+        }
+        if (removed_ids) removed_ids->insert(removed_ids->end(), erased.begin(), erased.end());
+        return removed;
+    }
+    uint64_t getVersion() const override { return backend->getVersion(); }
+    PersistenceStats persistenceStats() const override { return backend->persistenceStats(); }
+    ResidencyStats residencyStats() const override { return backend->residencyStats(); }
+
+    bool findByIndex(const std::string& column, const std::string& value,
+                     std::vector<std::shared_ptr<T>>& out) override {
+        return backend->findByIndex(column, value, out);
+    }
+
+    bool findByRange(const std::string& column, time_t start, time_t end,
+                     std::vector<std::shared_ptr<T>>& out) override {
+        return backend->findByRange(column, start, end, out);
     }
 
     template<typename Predicate>
     std::vector<std::shared_ptr<T>> filter(Predicate predicate) {
-        std::lock_guard<std::mutex> lock(mutex_);
         std::vector<std::shared_ptr<T>> result;
-        for (const auto& pair : cache) {
-            if (predicate(pair.second)) {
-                result.push_back(pair.second);
+        for (const auto& record : backend->findAll()) {
+            if (predicate(record)) {
+                result.push_back(record);
             }
         }
         return result;
@@ -149,23 +868,41 @@ public:
 };
 
 // Item Repository
-class ItemRepository : public JsonRepository<Item> {
+class ItemRepository : public BackedRepository<Item> {
 public:
-    ItemRepository() : JsonRepository<Item>("data/items.json") {}
+    explicit ItemRepository(const std::string& store = std::string())
+        : BackedRepository<Item>(storeStorageName(store, "items")) {}
 
     std::vector<std::shared_ptr<Item>> findByDepartment(const std::string& dept) {
+        std::vector<std::shared_ptr<Item>> result;
+        if (findByIndex("department", dept, result)) return result;
         return filter([&dept](const std::shared_ptr<Item>& item) {
             return item && item->getDepartment() == dept;
         });
     }
 };
 
+inline std::unique_ptr<Repository<Sale>> makeSaleBackend(const std::string& store) {
+    const StorageConfig& config = storageConfig();
+    std::string name = storeStorageName(store, "sales");
+    if (config.partition_sales && config.backend == StorageBackend::Json) {
+        return std::make_unique<PartitionedSaleStore>(config.data_dir + "/" + name, config.sale_granularity,
+                                                      config.sale_freeze_after_days,
+                                                      config.data_dir + "/" + name + ".json",
+                                                      config.sale_memory_budget);
+    }
+    return makeBackend<Sale>(name);
+}
+
 // Sale Repository
-class SaleRepository : public JsonRepository<Sale> {
+class SaleRepository : public BackedRepository<Sale> {
 public:
-    SaleRepository() : JsonRepository<Sale>("data/sales.json") {}
+    explicit SaleRepository(const std::string& store = std::string())
+        : BackedRepository<Sale>(storeStorageName(store, "sales"), makeSaleBackend(store)) {}
 
     std::vector<std::shared_ptr<Sale>> findByDateRange(time_t start, time_t end) {
+        std::vector<std::shared_ptr<Sale>> result;
+        if (findByRange("timestamp", start, end, result)) return result;
         return filter([start, end](const std::shared_ptr<Sale>& sale) {
             return sale->getTimestamp() >= start && sale->getTimestamp() <= end;
         });
@@ -173,11 +910,14 @@ public:
 };
 
 // Financial Record Repository
-class FinancialRecordRepository : public JsonRepository<FinancialRecord> {
+class FinancialRecordRepository : public BackedRepository<FinancialRecord> {
 public:
-    FinancialRecordRepository() : JsonRepository<FinancialRecord>("data/financial_records.json") {}
+    explicit FinancialRecordRepository(const std::string& store = std::string())
+        : BackedRepository<FinancialRecord>(storeStorageName(store, "financial_records")) {}
 
     std::vector<std::shared_ptr<FinancialRecord>> findByCategory(const std::string& category) {
+        std::vector<std::shared_ptr<FinancialRecord>> result;
+        if (findByIndex("category", category, result)) return result;
         return filter([&category](const std::shared_ptr<FinancialRecord>& record) {
             return record->getCategory() == category;
         });
@@ -185,9 +925,10 @@ public:
 };
 
 // Promotion Repository
-class PromotionRepository : public JsonRepository<Promotion> {
+class PromotionRepository : public BackedRepository<Promotion> {
 public:
-    PromotionRepository() : JsonRepository<Promotion>("data/promotions.json") {}
+    explicit PromotionRepository(const std::string& store = std::string())
+        : BackedRepository<Promotion>(storeStorageName(store, "promotions")) {}
 
     std::vector<std::shared_ptr<Promotion>> findActivePromotions() {
         return filter([](const std::shared_ptr<Promotion>& promo) {
@@ -196,53 +937,4 @@ public:
     }
 };
 
-// Serialization Functions for Sale, FinancialRecord, Promotion (Similar to Item)
-void to_json(nlohmann::json& j, const Sale& sale) {
-    j = nlohmann::json{
-        {"id", sale.getId()},
-        {"item_id", sale.getItemId()},
-        {"quantity", sale.getQuantity()},
-        {"total", sale.getTotal()},
-        {"timestamp", sale.getTimestamp()}
-    };
-}
-
-void from_json(const nlohmann::json& j, Sale& sale) {
-    sale.setId(j.at("id").get<int>());
-    sale.setItemId(j.at("item_id").get<int>());
-    sale.setQuantity(j.at("quantity").get<int>());
-    sale.setTotal(j.at("total").get<double>());
-    sale.setTimestamp(j.at("timestamp").get<time_t>());
-}
-
-void to_json(nlohmann::json& j, const FinancialRecord& record) {
-    j = nlohmann::json{
-        {"id", record.getId()},
-        {"category", record.getCategory()},
-        {"amount", record.getAmount()},
-        {"date", record.getDate()}
-    };
-}
-
-void from_json(const nlohmann::json& j, FinancialRecord& record) {
-    record.setId(j.at("id").get<int>());
-    record.setCategory(j.at("category").get<std::string>());
-    record.setAmount(j.at("amount").get<double>());
-    record.setDate(j.at("date").get<std::string>());
-}
-
-void to_json(nlohmann::json& j, const Promotion& promo) {
-    j = nlohmann::json{
-        {"id", promo.getId()},
-        {"description", promo.getDescription()},
-        {"active", promo.isActive()}
-    };
-}
-
-void from_json(const nlohmann::json& j, Promotion& promo) {
-    promo.setId(j.at("id").get<int>());
-    promo.setDescription(j.at("description").get<std::string>());
-    promo.setActive(j.at("active").get<bool>());
-}
-
 } // namespace dsms
@@ -0,0 +1,272 @@
+// repository_base.h - Storage-agnostic repository interface
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace dsms {
+
+// When a mutation reaches disk relative to the call that made it:
+//   Sync  - written by the calling thread before save() returns
+//   Group - written by the repository's flusher thread, batched with any
+//           other pending mutations; save() still waits for it
+//   Async - save() returns once the change is in memory; the flusher
+//           writes it shortly after, so a crash can lose recent changes
+enum class DurabilityMode { Sync, Group, Async };
+
+inline const char* durabilityName(DurabilityMode mode) {
+    switch (mode) {
+        case DurabilityMode::Group: return "group";
+        case DurabilityMode::Async: return "async";
+        default: return "sync";
+    }
+}
+
+inline bool parseDurabilityMode(const std::string& name, DurabilityMode& mode) {
+    if (name == "sync") mode = DurabilityMode::Sync;
+    else if (name == "group") mode = DurabilityMode::Group;
+    else if (name == "async") mode = DurabilityMode::Async;
+    else return false;
+    return true;
+}
+
+// Write-path counters reported by /api/metrics
+struct PersistenceStats {
+    uint64_t flushes = 0;           // completed writes to disk
+    uint64_t failures = 0;
+    uint64_t coalesced = 0;         // writes skipped because a newer image was already on disk
+    uint64_t last_flush_us = 0;
+    uint64_t max_flush_us = 0;
+    uint64_t total_flush_us = 0;
+    uint64_t pending = 0;           // mutations not yet on disk
+    std::string durability = "sync";
+};
+
+class PersistenceCounters {
+private:
+    std::atomic<uint64_t> flushes{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> last_flush_us{0};
+    std::atomic<uint64_t> max_flush_us{0};
+    std::atomic<uint64_t> total_flush_us{0};
+
+public:
+    void recordFlush(std::chrono::steady_clock::time_point started, bool ok) {
+        uint64_t us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count());
+        if (ok) ++flushes;
+        else ++failures;
+        last_flush_us = us;
+        total_flush_us += us;
+        uint64_t seen = max_flush_us.load();
+        while (us > seen && !max_flush_us.compare_exchange_weak(seen, us)) {}
+    }
+
+    void recordCoalesced() { ++coalesced; }
+
+    PersistenceStats stats() const {
+        PersistenceStats s;
+        s.flushes = flushes.load();
+        s.failures = failures.load();
+        s.coalesced = coalesced.load();
+        s.last_flush_us = last_flush_us.load();
+        s.max_flush_us = max_flush_us.load();
+        s.total_flush_us = total_flush_us.load();
+        return s;
+    }
+};
+
+// Memory residency of repositories that page records in and out
+struct ResidencyStats {
+    bool bounded = false;           // false: everything stays resident
+    size_t budget_bytes = 0;
+    size_t resident_bytes = 0;
+    size_t resident_records = 0;
+    size_t derived_bytes = 0;       // report columns, counted against the budget
+    size_t resident_partitions = 0;
+    size_t partitions = 0;
+    uint64_t hits = 0;              // accesses served from memory
+    uint64_t misses = 0;            // accesses that had to read from disk
+    uint64_t evictions = 0;
+};
+
+// Outcome of a conditional update
+enum class UpdateResult {
+    Updated,
+    NotFound,
+    Conflict,       // the record moved past the expected revision
+    Duplicate,      // a field that must be unique belongs to another record
+    Failed          // the backend refused the write
+};
+
+template<typename T>
+class Repository {
+public:
+    virtual ~Repository() = default;
+    virtual std::shared_ptr<T> findById(int id) = 0;
+    virtual std::vector<std::shared_ptr<T>> findAll() = 0;
+    virtual bool save(const T& item) = 0;
+
+    // save() that also reports the id the record was stored under, which
+    // differs from item.getId() when the backend assigned a new one
+    virtual bool saveWithId(const T& item, int& id) {
+        id = item.getId();
+        return save(item);
+    }
+
+    virtual bool update(const T& item) = 0;
+    virtual bool remove(int id) = 0;
+
+    // Remove several records as one write where the backend allows it.
+    // Returns how many were removed; `removed_ids`, if given, receives
+    // their ids.
+    virtual size_t removeMany(const std::vector<int>& ids, std::vector<int>* removed_ids = nullptr) {
+        size_t removed = 0;
+        for (int id : ids) {
+            if (!remove(id)) continue;
+            ++removed;
+            if (removed_ids) removed_ids->push_back(id);
+        }
+        return removed;
+    }
+
+    // Insert or replace records under their own ids (all > 0) as one write
+    // where the backend allows it. Returns how many were stored;
+    // `stored_ids`, if given, receives their ids.
+    virtual size_t saveMany(const std::vector<T>& items, std::vector<int>* stored_ids = nullptr) {
+        size_t stored = 0;
+        for (const auto& item : items) {
+            int id;
+            if (item.getId() <= 0 || !saveWithId(item, id)) continue;
+            ++stored;
+            if (stored_ids) stored_ids->push_back(id);
+        }
+        return stored;
+    }
+
+    // Monotonically increasing counter bumped by every successful mutation
+    virtual uint64_t getVersion() const = 0;
+
+    // Secondary-index lookups. Backends without an index on `column` return
+    // false and the caller falls back to scanning findAll().
+    virtual bool findByIndex(const std::string& column, const std::string& value,
+                             std::vector<std::shared_ptr<T>>& out) {
+        return false;
+    }
+
+    virtual bool findByRange(const std::string& column, time_t start, time_t end,
+                             std::vector<std::shared_ptr<T>>& out) {
+        return false;
+    }
+
+    virtual PersistenceStats persistenceStats() const {
+        return PersistenceStats();
+    }
+
+    virtual ResidencyStats residencyStats() const {
+        return ResidencyStats();
+    }
+
+    // Memory held outside the backend for structures derived from its
+    // records (report columns); a backend with a memory budget counts it
+    virtual void adjustDerivedBytes(int64_t delta) {}
+};
+
+// Named repositories register their counters here under their storage name
+// ("items", "sales", ...), so metrics can be reported without reaching into
+// the services that own the repositories
+class PersistenceRegistry {
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::function<PersistenceStats()>> sources;
+
+public:
+    void add(const std::string& name, std::function<PersistenceStats()> source) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sources[name] = std::move(source);
+    }
+
+    void remove(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sources.erase(name);
+    }
+
+    std::map<std::string, PersistenceStats> collect() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, PersistenceStats> result;
+        for (const auto& source : sources) {
+            result[source.first] = source.second();
+        }
+        return result;
+    }
+};
+
+inline PersistenceRegistry& persistenceRegistry() {
+    static PersistenceRegistry registry;
+    return registry;
+}
+
+// How replication reads and writes one named repository. Records travel as
+// model_serialization JSON, which round-trips exactly.
+struct ReplicationTarget {
+    std::function<bool(int id, std::string& json)> read;            // false: no such record
+    std::function<void(const std::function<void(const std::string&)>&)> dump;
+    std::function<std::vector<int>()> ids;
+    std::function<int(const std::string& json)> upsert;             // the record's id, or -1
+    std::function<bool(int id)> remove;
+    // Many records as one write, for snapshots: the ids stored, and the
+    // number removed
+    std::function<std::vector<int>(const std::vector<std::string>& json)> upsertMany;
+    std::function<size_t(const std::vector<int>& ids)> removeMany;
+};
+
+// Replication targets by storage name. Repositories register themselves;
+// services that index a repository replace its target so that replicated
+// writes reach their indexes too.
+class ReplicationRegistry {
+private:
+    std::mutex mutex_;
+    std::map<std::string, ReplicationTarget> targets;
+
+public:
+    void add(const std::string& name, ReplicationTarget target) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        targets[name] = std::move(target);
+    }
+
+    void remove(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        targets.erase(name);
+    }
+
+    bool find(const std::string& name, ReplicationTarget& target) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = targets.find(name);
+        if (found == targets.end()) return false;
+        target = found->second;
+        return true;
+    }
+
+    std::vector<std::string> names() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::string> result;
+        for (const auto& target : targets) result.push_back(target.first);
+        return result;
+    }
+};
+
+inline ReplicationRegistry& replicationRegistry() {
+    static ReplicationRegistry registry;
+    return registry;
+}
+
+} // namespace dsms
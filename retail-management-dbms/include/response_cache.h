@@ -0,0 +1,89 @@
+// response_cache.h - Serialized GET responses keyed by (endpoint, query, version)
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+namespace dsms {
+
+struct SerializedBody {
+    std::vector<unsigned char> bytes;
+    std::string content_type;
+};
+
+// Bounded LRU of rendered bodies. An entry is only returned while its
+// recorded repository version is still current, so writers never have to
+// invalidate anything: a version bump simply turns old entries into misses
+// that are overwritten on the next render.
+class ResponseCache {
+private:
+    struct Entry {
+        uint64_t version;
+        std::shared_ptr<const SerializedBody> body;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru;     // most recently used at the front
+    size_t max_entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    mutable std::mutex mutex_;
+
+public:
+    explicit ResponseCache(size_t capacity = 256) : max_entries(capacity) {}
+
+    static std::string makeKey(const std::string& endpoint, const std::string& query, const std::string& variant) {
+        return endpoint + '?' + query + '#' + variant;
+    }
+
+    std::shared_ptr<const SerializedBody> find(const std::string& key, uint64_t version) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.version != version) {
+            ++misses;
+            return nullptr;
+        }
+        lru.splice(lru.begin(), lru, it->second.lru_pos);
+        ++hits;
+        return it->second.body;
+    }
+
+    void store(const std::string& key, uint64_t version, std::shared_ptr<const SerializedBody> body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            // Never replace a newer rendering with an older one
+            if (it->second.version > version) return;
+            it->second.version = version;
+            it->second.body = std::move(body);
+            lru.splice(lru.begin(), lru, it->second.lru_pos);
+            return;
+        }
+
+        if (max_entries == 0) return;
+        while (entries.size() >= max_entries && !lru.empty()) {
+            entries.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(key);
+        entries[key] = Entry{version, std::move(body), lru.begin()};
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.clear();
+        lru.clear();
+    }
+
+    uint64_t getHits() const { std::lock_guard<std::mutex> lock(mutex_); return hits; }
+    uint64_t getMisses() const { std::lock_guard<std::mutex> lock(mutex_); return misses; }
+    size_t size() const { std::lock_guard<std::mutex> lock(mutex_); return entries.size(); }
+};
+
+} // namespace dsms
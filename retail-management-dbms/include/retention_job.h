@@ -0,0 +1,294 @@
+// retention_job.h - Rolls old sales and financial records into daily aggregates
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <condition_variable>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include "repository.h"
+#include "durable_file.h"
+
+namespace dsms {
+
+struct RetentionConfig {
+    int sale_retention_days = 0;            // detail records kept live; 0 disables
+    int financial_retention_days = 0;
+    std::string archive_dir = "data/archive";
+    std::chrono::seconds interval{3600};
+
+    // Removal is throttled: batch_size records per write, then a pause
+    size_t batch_size = 200;
+    std::chrono::milliseconds batch_pause{100};
+};
+
+struct RetentionStats {
+    uint64_t runs = 0;
+    time_t last_run = 0;
+    uint64_t sales_archived = 0;
+    uint64_t sales_removed = 0;
+    uint64_t financial_archived = 0;
+    uint64_t financial_removed = 0;
+    uint64_t failures = 0;
+};
+
+// Background job that moves history out of the live repositories. Each run
+// aggregates whole UTC days older than the retention window into an archive
+// file (per item for sales, per category for financial records), then
+// deletes the detail records in throttled batches.
+//
+// Each archive records a watermark: every detail record before it has
+// already been aggregated. The archive is written before anything is
+// deleted, and records found below the watermark on a later run are only
+// deleted, never counted again, so a crash mid-run cannot double count.
+class RetentionJob {
+private:
+    SaleRepository& saleRepo;
+    FinancialRecordRepository& financeRepo;
+    RetentionConfig config;
+
+    std::thread worker;
+    std::mutex mutex_;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    mutable std::mutex stats_mutex_;
+    RetentionStats stats;
+
+    struct Archive {
+        time_t watermark = std::numeric_limits<time_t>::min();
+        std::map<std::string, nlohmann::json> aggregates;    // "<day>/<key>" -> aggregate
+    };
+
+    std::string archivePath(const std::string& name) const {
+        return config.archive_dir + "/" + name;
+    }
+
+    // False when an archive exists but neither it nor its backup is valid;
+    // the run must then stop rather than overwrite it
+    static bool loadArchive(const std::string& path, const std::string& format, Archive& archive) {
+        archive = Archive();
+        bool present = false;
+        for (const std::string& candidate : {path, backupPathFor(path)}) {
+            std::string text;
+            if (!readWholeFile(candidate, text)) continue;
+            present = true;
+            nlohmann::json document = nlohmann::json::parse(text, nullptr, false);
+            if (document.is_discarded() || document.value("format", std::string()) != format) continue;
+            const nlohmann::json& list = document["aggregates"];
+            if (dataChecksum(list.dump()) != document.value("checksum", std::string())) continue;
+
+            archive.watermark = document.value("watermark", archive.watermark);
+            for (const auto& aggregate : list) {
+                archive.aggregates[aggregate.value("day", std::string()) + "/" +
+                                   aggregate.value("key", std::string())] = aggregate;
+            }
+            return true;
+        }
+        if (present) std::cerr << "Archive " << path << " is unreadable, retention paused" << std::endl;
+        return !present;
+    }
+
+    static bool saveArchive(const std::string& path, const std::string& format, const Archive& archive) {
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& entry : archive.aggregates) list.push_back(entry.second);
+        nlohmann::json document = {
+            {"format", format},
+            {"watermark", archive.watermark},
+            {"checksum", dataChecksum(list.dump())},
+            {"aggregates", list}
+        };
+        std::string error;
+        if (!writeFileAtomically(path, document.dump(), error)) {
+            std::cerr << "Error saving archive: " << error << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Sleep unless stop() is called meanwhile; returns false when stopping
+    bool pause(std::chrono::milliseconds duration) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return !wake.wait_for(lock, duration, [this]() { return stopping; });
+    }
+
+    template<typename Repo>
+    size_t removeThrottled(Repo& repo, const std::vector<int>& ids) {
+        size_t removed = 0;
+        for (size_t offset = 0; offset < ids.size(); offset += config.batch_size) {
+            size_t end = std::min(ids.size(), offset + std::max<size_t>(config.batch_size, 1));
+            removed += repo.removeMany(std::vector<int>(ids.begin() + offset, ids.begin() + end));
+            if (end < ids.size() && !pause(config.batch_pause)) break;
+        }
+        return removed;
+    }
+
+    void rollUpSales(time_t now) {
+        if (config.sale_retention_days <= 0) return;
+        std::string path = archivePath("sales-daily.json");
+        const char* format = "dsms-sales-archive-1";
+        Archive archive;
+        if (!loadArchive(path, format, archive)) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            ++stats.failures;
+            return;
+        }
+
+        time_t cutoff = utcDayStart(now - static_cast<time_t>(config.sale_retention_days) * 86400);
+        if (cutoff < archive.watermark) cutoff = archive.watermark;
+        auto sales = saleRepo.findByDateRange(std::numeric_limits<time_t>::min(), cutoff - 1);
+        if (sales.empty()) return;
+
+        uint64_t archived = 0;
+        for (const auto& sale : sales) {
+            if (sale->getTimestamp() < archive.watermark) continue;   // counted by an earlier run
+            std::string day = utcDayKey(sale->getTimestamp());
+            nlohmann::json& aggregate = archive.aggregates[day + "/" + std::to_string(sale->getItemId())];
+            if (aggregate.is_null()) {
+                aggregate = {{"day", day}, {"key", std::to_string(sale->getItemId())},
+                             {"item_id", sale->getItemId()}, {"sales", 0}, {"quantity", 0}, {"total", 0.0}};
+            }
+            aggregate["sales"] = aggregate["sales"].get<int64_t>() + 1;
+            aggregate["quantity"] = aggregate["quantity"].get<int64_t>() + sale->getQuantity();
+            aggregate["total"] = aggregate["total"].get<double>() + sale->getTotal();
+            ++archived;
+        }
+
+        if (archived > 0 || cutoff > archive.watermark) {
+            archive.watermark = cutoff;
+            std::filesystem::create_directories(config.archive_dir);
+            if (!saveArchive(path, format, archive)) {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                ++stats.failures;
+                return;
+            }
+        }
+
+        std::vector<int> ids;
+        ids.reserve(sales.size());
+        for (const auto& sale : sales) ids.push_back(sale->getId());
+        size_t removed = removeThrottled(saleRepo, ids);
+
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats.sales_archived += archived;
+        stats.sales_removed += removed;
+    }
+
+    void rollUpFinancials(time_t now) {
+        if (config.financial_retention_days <= 0) return;
+        std::string path = archivePath("financial-daily.json");
+        const char* format = "dsms-financial-archive-1";
+        Archive archive;
+        if (!loadArchive(path, format, archive)) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            ++stats.failures;
+            return;
+        }
+
+        time_t cutoff = utcDayStart(now - static_cast<time_t>(config.financial_retention_days) * 86400);
+        if (cutoff < archive.watermark) cutoff = archive.watermark;
+        auto records = financeRepo.filter([cutoff](const std::shared_ptr<FinancialRecord>& record) {
+            return record && record->getDate() < cutoff;
+        });
+        if (records.empty()) return;
+
+        uint64_t archived = 0;
+        for (const auto& record : records) {
+            if (record->getDate() < archive.watermark) continue;
+            std::string day = utcDayKey(record->getDate());
+            nlohmann::json& aggregate = archive.aggregates[day + "/" + record->getCategory()];
+            if (aggregate.is_null()) {
+                aggregate = {{"day", day}, {"key", record->getCategory()}, {"category", record->getCategory()},
+                             {"records", 0}, {"amount", 0.0}};
+            }
+            aggregate["records"] = aggregate["records"].get<int64_t>() + 1;
+            aggregate["amount"] = aggregate["amount"].get<double>() + record->getAmount();
+            ++archived;
+        }
+
+        if (archived > 0 || cutoff > archive.watermark) {
+            archive.watermark = cutoff;
+            std::filesystem::create_directories(config.archive_dir);
+            if (!saveArchive(path, format, archive)) {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                ++stats.failures;
+                return;
+            }
+        }
+
+        std::vector<int> ids;
+        ids.reserve(records.size());
+        for (const auto& record : records) ids.push_back(record->getId());
+        size_t removed = removeThrottled(financeRepo, ids);
+
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats.financial_archived += archived;
+        stats.financial_removed += removed;
+    }
+
+    void run() {
+        do {
+            runOnce(std::time(nullptr));
+        } while (pause(std::chrono::duration_cast<std::chrono::milliseconds>(config.interval)));
+    }
+
+public:
+    RetentionJob(SaleRepository& sales, FinancialRecordRepository& finance)
+        : saleRepo(sales), financeRepo(finance) {}
+
+    RetentionJob(const RetentionJob&) = delete;
+    RetentionJob& operator=(const RetentionJob&) = delete;
+
+    ~RetentionJob() {
+        stop();
+    }
+
+    // Runs immediately, then every config.interval. Does nothing when both
+    // retention windows are disabled.
+    void start(const RetentionConfig& job_config) {
+        if (worker.joinable()) return;
+        config = job_config;
+        if (config.sale_retention_days <= 0 && config.financial_retention_days <= 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = false;
+        }
+        worker = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // One pass over both repositories; also usable without start()
+    void runOnce(time_t now) {
+        rollUpSales(now);
+        rollUpFinancials(now);
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++stats.runs;
+        stats.last_run = now;
+    }
+
+    void configure(const RetentionConfig& job_config) {
+        config = job_config;
+    }
+
+    RetentionStats getStats() const {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        return stats;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,236 @@
+// router.h - Allocation-free request routing over string_view path segments
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <charconv>
+#include <system_error>
+#include <cstddef>
+
+namespace dsms {
+
+constexpr size_t kMaxPathSegments = 8;
+constexpr size_t kMaxQueryParams = 16;
+constexpr size_t kMaxRouteParams = 4;
+
+// "%20" and "+" aware decoding; the only routing helper that allocates, and
+// callers only reach for it when a value is actually needed as a string.
+// '+' only means a space in a query string, so path segments keep it.
+inline std::string percentDecode(std::string_view in, bool plus_is_space = true) {
+    auto hex = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        char c = in[i];
+        if (c == '+' && plus_is_space) {
+            out += ' ';
+        } else if (c == '%' && i + 2 < in.size() && hex(in[i + 1]) >= 0 && hex(in[i + 2]) >= 0) {
+            out += static_cast<char>(hex(in[i + 1]) * 16 + hex(in[i + 2]));
+            i += 2;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+inline std::string pathDecode(std::string_view segment) {
+    return percentDecode(segment, false);
+}
+
+// Non-owning view of a path split on '/'. Leading and trailing slashes are
+// ignored; paths deeper than kMaxPathSegments are flagged as truncated.
+class PathSegments {
+private:
+    std::array<std::string_view, kMaxPathSegments> segments{};
+    size_t count = 0;
+    bool truncated = false;
+
+public:
+    PathSegments() = default;
+
+    explicit PathSegments(std::string_view path) {
+        size_t pos = (!path.empty() && path[0] == '/') ? 1 : 0;
+        while (pos < path.size()) {
+            size_t next = path.find('/', pos);
+            if (next == std::string_view::npos) next = path.size();
+            if (count == kMaxPathSegments) {
+                truncated = true;
+                return;
+            }
+            segments[count++] = path.substr(pos, next - pos);
+            pos = next + 1;
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isTruncated() const { return truncated; }
+    std::string_view operator[](size_t i) const { return i < count ? segments[i] : std::string_view(); }
+};
+
+// Non-owning view of "a=1&b=two". Keys and values stay percent-encoded;
+// use get() for a decoded copy or getInt() to parse in place.
+class QueryParams {
+private:
+    std::array<std::pair<std::string_view, std::string_view>, kMaxQueryParams> entries{};
+    size_t count = 0;
+
+public:
+    QueryParams() = default;
+
+    explicit QueryParams(std::string_view query) {
+        size_t pos = 0;
+        while (pos < query.size() && count < kMaxQueryParams) {
+            size_t amp = query.find('&', pos);
+            if (amp == std::string_view::npos) amp = query.size();
+            std::string_view pair = query.substr(pos, amp - pos);
+            pos = amp + 1;
+
+            size_t eq = pair.find('=');
+            if (eq == 0 || pair.empty()) continue;
+            if (eq == std::string_view::npos) {
+                entries[count++] = {pair, std::string_view()};
+            } else {
+                entries[count++] = {pair.substr(0, eq), pair.substr(eq + 1)};
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+
+    bool has(std::string_view key) const {
+        for (size_t i = 0; i < count; ++i) {
+            if (entries[i].first == key) return true;
+        }
+        return false;
+    }
+
+    // Last occurrence wins, matching the old map-based parser
+    std::string_view raw(std::string_view key) const {
+        for (size_t i = count; i-- > 0;) {
+            if (entries[i].first == key) return entries[i].second;
+        }
+        return std::string_view();
+    }
+
+    std::string get(std::string_view key, const std::string& fallback = std::string()) const {
+        return has(key) ? percentDecode(raw(key)) : fallback;
+    }
+
+    // `fallback` unless the whole value is a decimal that fits a long long
+    long long getInt(std::string_view key, long long fallback) const {
+        std::string_view value = raw(key);
+        if (value.size() > 1 && value[0] == '+' && value[1] != '-') value.remove_prefix(1);
+        long long result = 0;
+        auto parsed = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (value.empty() || parsed.ec != std::errc() || parsed.ptr != value.data() + value.size()) return fallback;
+        return result;
+    }
+};
+
+enum class HttpMethod { Get = 0, Post, Put, Delete, Count };
+
+struct RouteMatch {
+    PathSegments path;
+    QueryParams query;
+    std::array<std::string_view, kMaxRouteParams> params{};
+    size_t param_count = 0;
+
+    std::string_view param(size_t i) const { return i < param_count ? params[i] : std::string_view(); }
+};
+
+enum class RouteResult { Matched, NotFound, MethodNotAllowed };
+
+// Trie of literal and "{param}" segments, built once at startup. Matching
+// compares string_views against the stored literals and never allocates.
+template<typename Handler>
+class RouteTrie {
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t kMethods = static_cast<size_t>(HttpMethod::Count);
+
+    struct Node {
+        std::vector<std::pair<std::string, size_t>> literals;
+        size_t param_child = npos;
+        std::array<Handler, kMethods> handlers{};
+        std::array<bool, kMethods> has_handler{};
+    };
+
+    std::vector<Node> nodes;
+
+public:
+    RouteTrie() : nodes(1) {}
+
+    // Patterns look like "/api/items/{id}"
+    void add(HttpMethod method, std::string_view pattern, Handler handler) {
+        PathSegments segments(pattern);
+        size_t node = 0;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            std::string_view seg = segments[i];
+            bool is_param = seg.size() >= 2 && seg.front() == '{' && seg.back() == '}';
+            size_t next = npos;
+            if (is_param) {
+                next = nodes[node].param_child;
+            } else {
+                for (const auto& child : nodes[node].literals) {
+                    if (child.first == seg) next = child.second;
+                }
+            }
+            if (next == npos) {
+                next = nodes.size();
+                nodes.emplace_back();
+                if (is_param) nodes[node].param_child = next;
+                else nodes[node].literals.emplace_back(std::string(seg), next);
+            }
+            node = next;
+        }
+        nodes[node].handlers[static_cast<size_t>(method)] = std::move(handler);
+        nodes[node].has_handler[static_cast<size_t>(method)] = true;
+    }
+
+    // Literal segments take precedence over parameters at the same depth
+    RouteResult match(HttpMethod method, RouteMatch& match, const Handler*& handler) const {
+        handler = nullptr;
+        if (match.path.isTruncated()) return RouteResult::NotFound;
+
+        size_t node = 0;
+        match.param_count = 0;
+        for (size_t i = 0; i < match.path.size(); ++i) {
+            std::string_view seg = match.path[i];
+            size_t next = npos;
+            for (const auto& child : nodes[node].literals) {
+                if (child.first == seg) {
+                    next = child.second;
+                    break;
+                }
+            }
+            if (next == npos && nodes[node].param_child != npos && match.param_count < kMaxRouteParams) {
+                next = nodes[node].param_child;
+                match.params[match.param_count++] = seg;
+            }
+            if (next == npos) return RouteResult::NotFound;
+            node = next;
+        }
+
+        const Node& target = nodes[node];
+        if (method == HttpMethod::Count || !target.has_handler[static_cast<size_t>(method)]) {
+            for (bool has : target.has_handler) {
+                if (has) return RouteResult::MethodNotAllowed;
+            }
+            return RouteResult::NotFound;
+        }
+        handler = &target.handlers[static_cast<size_t>(method)];
+        return RouteResult::Matched;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,264 @@
+// sales_sketches.h - Mergeable distinct-count and quantile sketches for sales analytics
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include "models.h"
+
+namespace dsms {
+
+inline uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer: small integer ids become well-spread hashes
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// HyperLogLog with 2^kPrecision one-byte registers (1 KiB, about 3%
+// standard error). Merging takes the register-wise maximum, so the sketch
+// of several days is the merge of the daily ones.
+class HyperLogLog {
+public:
+    static constexpr int kPrecision = 10;
+    static constexpr size_t kRegisters = size_t(1) << kPrecision;
+
+private:
+    std::array<uint8_t, kRegisters> registers{};
+
+public:
+    void add(uint64_t hash) {
+        size_t index = static_cast<size_t>(hash >> (64 - kPrecision));
+        uint64_t rest = (hash << kPrecision) | (uint64_t(1) << (kPrecision - 1));
+        uint8_t rank = 1;
+        while (!(rest & (uint64_t(1) << 63))) {
+            rest <<= 1;
+            ++rank;
+        }
+        registers[index] = std::max(registers[index], rank);
+    }
+
+    void merge(const HyperLogLog& other) {
+        for (size_t i = 0; i < kRegisters; ++i) registers[i] = std::max(registers[i], other.registers[i]);
+    }
+
+    double estimate() const {
+        const double m = static_cast<double>(kRegisters);
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r : registers) {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) ++zeros;
+        }
+        double raw = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+        // Linear counting is more accurate while many registers are empty
+        if (raw <= 2.5 * m && zeros > 0) return m * std::log(m / static_cast<double>(zeros));
+        return raw;
+    }
+};
+
+// KLL quantile sketch (Karnin, Lang, Liberty). Level h holds items of
+// weight 2^h; when the sketch is over capacity the lowest full level is
+// sorted and every other item, from a random offset, is promoted. Rank
+// error is about 1.7% with k = 200, independent of how many values were
+// added, and two sketches merge by concatenating levels and compacting.
+class KllSketch {
+private:
+    size_t k;
+    std::vector<std::vector<double>> levels;
+    uint64_t count = 0;
+    double min_value = std::numeric_limits<double>::infinity();
+    double max_value = -std::numeric_limits<double>::infinity();
+    std::minstd_rand coin{0x5eed};
+
+    size_t levelCapacity(size_t level) const {
+        size_t depth = levels.size() - level - 1;
+        return std::max<size_t>(2, static_cast<size_t>(std::ceil(k * std::pow(2.0 / 3.0, static_cast<double>(depth)))));
+    }
+
+    size_t retained() const {
+        size_t n = 0;
+        for (const auto& level : levels) n += level.size();
+        return n;
+    }
+
+    size_t capacity() const {
+        size_t n = 0;
+        for (size_t h = 0; h < levels.size(); ++h) n += levelCapacity(h);
+        return n;
+    }
+
+    void compress() {
+        while (retained() > capacity()) {
+            for (size_t h = 0; h < levels.size(); ++h) {
+                if (levels[h].size() < levelCapacity(h)) continue;
+                if (h + 1 == levels.size()) levels.emplace_back();
+                std::vector<double>& level = levels[h];
+                std::sort(level.begin(), level.end());
+                // An odd item stays behind so the total weight is preserved
+                double leftover = 0.0;
+                bool odd = level.size() % 2 == 1;
+                if (odd) {
+                    leftover = level.back();
+                    level.pop_back();
+                }
+                size_t offset = coin() & 1;
+                std::vector<double>& above = levels[h + 1];
+                for (size_t i = offset; i < level.size(); i += 2) above.push_back(level[i]);
+                level.clear();
+                if (odd) level.push_back(leftover);
+                break;
+            }
+        }
+    }
+
+public:
+    explicit KllSketch(size_t accuracy = 200) : k(std::max<size_t>(accuracy, 8)), levels(1) {}
+
+    void add(double value) {
+        ++count;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+        levels[0].push_back(value);
+        if (levels[0].size() >= levelCapacity(0)) compress();
+    }
+
+    void merge(const KllSketch& other) {
+        if (other.count == 0) return;
+        if (levels.size() < other.levels.size()) levels.resize(other.levels.size());
+        for (size_t h = 0; h < other.levels.size(); ++h) {
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        }
+        count += other.count;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+        compress();
+    }
+
+    // Value at rank q in [0, 1]; 0 when empty
+    double quantile(double q) const {
+        if (count == 0) return 0.0;
+        if (q <= 0.0) return min_value;
+        if (q >= 1.0) return max_value;
+        std::vector<std::pair<double, uint64_t>> weighted;
+        weighted.reserve(retained());
+        for (size_t h = 0; h < levels.size(); ++h) {
+            for (double value : levels[h]) weighted.emplace_back(value, uint64_t(1) << h);
+        }
+        std::sort(weighted.begin(), weighted.end());
+        uint64_t total = 0;
+        for (const auto& entry : weighted) total += entry.second;
+        double target = q * static_cast<double>(total);
+        uint64_t seen = 0;
+        for (const auto& entry : weighted) {
+            seen += entry.second;
+            if (static_cast<double>(seen) >= target) return entry.first;
+        }
+        return max_value;
+    }
+
+    uint64_t size() const { return count; }
+};
+
+// Sketches of one department's sales on one UTC day
+struct SalesSketch {
+    uint64_t sales = 0;
+    double revenue = 0.0;
+    HyperLogLog items;     // distinct item ids
+    KllSketch baskets;     // sale totals
+
+    void add(const Sale& sale) {
+        ++sales;
+        revenue += sale.getTotal();
+        items.add(mix64(static_cast<uint64_t>(static_cast<uint32_t>(sale.getItemId()))));
+        baskets.add(sale.getTotal());
+    }
+
+    void merge(const SalesSketch& other) {
+        sales += other.sales;
+        revenue += other.revenue;
+        items.merge(other.items);
+        baskets.merge(other.baskets);
+    }
+};
+
+struct SalesAnalytics {
+    std::string department;    // empty for all departments combined
+    uint64_t sales = 0;
+    double revenue = 0.0;
+    double distinct_items = 0.0;
+    double median_basket = 0.0;
+    double p90_basket = 0.0;
+    double p99_basket = 0.0;
+};
+
+// Day x department grid of sketches. A query merges the cells in range,
+// so its cost depends on days x departments, never on the number of sales.
+// Days older than retention_days before the newest are dropped.
+class SalesSketchStore {
+private:
+    mutable std::mutex mutex_;
+    std::map<int64_t, std::map<std::string, SalesSketch>> days;
+    int64_t retention_days;
+
+    static int64_t dayOf(time_t ts) {
+        int64_t t = static_cast<int64_t>(ts);
+        return t >= 0 ? t / 86400 : (t - 86399) / 86400;
+    }
+
+    static SalesAnalytics summarize(const std::string& department, const SalesSketch& sketch) {
+        SalesAnalytics result;
+        result.department = department;
+        result.sales = sketch.sales;
+        result.revenue = sketch.revenue;
+        result.distinct_items = sketch.sales > 0 ? std::round(sketch.items.estimate()) : 0.0;
+        result.median_basket = sketch.baskets.quantile(0.5);
+        result.p90_basket = sketch.baskets.quantile(0.9);
+        result.p99_basket = sketch.baskets.quantile(0.99);
+        return result;
+    }
+
+public:
+    explicit SalesSketchStore(int64_t retain_days = 400) : retention_days(retain_days) {}
+
+    void record(const Sale& sale, const std::string& department) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t day = dayOf(sale.getTimestamp());
+        if (!days.empty() && day <= days.rbegin()->first - retention_days) return;
+        days[day][department].add(sale);
+        while (days.begin()->first <= days.rbegin()->first - retention_days) days.erase(days.begin());
+    }
+
+    // One entry per department with sales in [start, end] (whole UTC days),
+    // followed by the combined entry with an empty department name
+    std::vector<SalesAnalytics> query(time_t start, time_t end, const std::string& department_filter) const {
+        std::map<std::string, SalesSketch> merged;
+        SalesSketch combined;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto day = days.lower_bound(dayOf(start)); day != days.end() && day->first <= dayOf(end); ++day) {
+                for (const auto& cell : day->second) {
+                    if (!department_filter.empty() && cell.first != department_filter) continue;
+                    merged[cell.first].merge(cell.second);
+                    combined.merge(cell.second);
+                }
+            }
+        }
+        std::vector<SalesAnalytics> result;
+        result.reserve(merged.size() + 1);
+        for (const auto& entry : merged) result.push_back(summarize(entry.first, entry.second));
+        result.push_back(summarize("", combined));
+        return result;
+    }
+};
+
+} // namespace dsms
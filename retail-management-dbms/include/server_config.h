@@ -0,0 +1,148 @@
+// server_config.h - Startup configuration for the DSMS server
+#pragma once
+
+#include <string>
+#include <map>
+#include <thread>
+#include <cstdlib>
+#include <iostream>
+
+namespace dsms {
+
+struct ServerConfig {
+    std::string base_uri = "http://localhost:8080";
+    std::string web_root = "web";
+
+    // cpprest I/O threads; 0 keeps the library default
+    size_t io_threads = 0;
+
+    // Lookups and CRUD run on the fast pool, /api/financials/* on the report
+    // pool, so a burst of heavy reports cannot starve item lookups
+    size_t fast_workers = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 4;
+    size_t report_workers = 2;
+
+    // Threads a single report fans out to, counting its report worker;
+    // 1 keeps reports single-threaded
+    size_t report_threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 4;
+
+    // Admission control: requests beyond max_queue_depth waiting per pool,
+    // or queued longer than max_queue_wait_ms, get 503 + Retry-After
+    size_t max_queue_depth = 256;
+    long max_queue_wait_ms = 2000;
+    int retry_after_seconds = 1;
+
+    size_t compression_threshold = 1024;
+
+    // Repository storage: "json" (one file per repository) or "sqlite"
+    // (<data_dir>/dsms.db)
+    std::string storage = "json";
+    std::string data_dir = "data";
+
+    // Stores served under /api/stores/{id}/ besides the default one, comma
+    // separated; stores with a directory under <data_dir>/stores open too
+    std::string stores;
+
+    // JSON backend: keep a memory-mapped binary snapshot beside each file
+    // so restarts skip re-parsing
+    bool snapshots = false;
+
+    // Durability mode (sync, group, async) for every repository, plus
+    // per-repository overrides from --durability-<name>=<mode>, e.g.
+    // --durability-promotions=async
+    std::string durability = "sync";
+    std::map<std::string, std::string> durability_overrides;
+    long async_flush_ms = 200;
+
+    // Sales segments: "off", "day" or "month"; segments older than
+    // sale_freeze_days are compacted into frozen month segments
+    std::string sale_partitions = "off";
+    int sale_freeze_days = 30;
+
+    // Cap on memory held by resident sales partitions, 0 = unbounded.
+    // Requires sale_partitions.
+    size_t sale_memory_mb = 0;
+
+    // Retention: sales and financial records older than this many days are
+    // rolled into daily aggregates under <data_dir>/archive and deleted;
+    // 0 keeps everything. Deletes run in batches with a pause in between.
+    int sale_retention_days = 0;
+    int financial_retention_days = 0;
+    long retention_interval_s = 3600;
+    size_t retention_batch = 200;
+    long retention_pause_ms = 100;
+
+    // GET /api/events: open streams allowed at once, and how many recent
+    // changes are kept for reconnecting clients to resume from (0 disables
+    // the change feed)
+    size_t max_event_streams = 256;
+    size_t change_feed_size = 4096;
+
+    // POST /api/sales: Idempotency-Key values remembered per store, and for
+    // how long; the oldest are forgotten early once there are more
+    size_t idempotency_keys = 65536;
+    long idempotency_ttl_s = 86400;
+
+    // Replication, as "unix:/path" or "host:port". A primary serves its
+    // change feed at replication_listen; a replica follows replicate_from,
+    // applies what it receives and refuses writes of its own.
+    std::string replication_listen;
+    std::string replicate_from;
+
+    // Parses --key=value arguments; unknown keys are reported and ignored
+    static ServerConfig fromArgs(int argc, char* argv[]) {
+        ServerConfig config;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+                std::cerr << "Ignoring argument: " << arg << std::endl;
+                continue;
+            }
+            std::string key = arg.substr(2, eq - 2);
+            std::string value = arg.substr(eq + 1);
+            if (!config.set(key, value)) {
+                std::cerr << "Unknown option: --" << key << std::endl;
+            }
+        }
+        return config;
+    }
+
+    bool set(const std::string& key, const std::string& value) {
+        auto as_size = [&value]() { return static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10)); };
+        if (key == "uri") base_uri = value;
+        else if (key == "web-root") web_root = value;
+        else if (key == "io-threads") io_threads = as_size();
+        else if (key == "fast-workers") fast_workers = as_size();
+        else if (key == "report-workers") report_workers = as_size();
+        else if (key == "report-threads") report_threads = as_size();
+        else if (key == "max-queue") max_queue_depth = as_size();
+        else if (key == "max-queue-wait-ms") max_queue_wait_ms = std::strtol(value.c_str(), nullptr, 10);
+        else if (key == "retry-after") retry_after_seconds = std::atoi(value.c_str());
+        else if (key == "compression-threshold") compression_threshold = as_size();
+        else if (key == "storage") storage = value;
+        else if (key == "data-dir") data_dir = value;
+        else if (key == "stores") stores = value;
+        else if (key == "snapshots") snapshots = (value == "on" || value == "true" || value == "1");
+        else if (key == "durability") durability = value;
+        else if (key.compare(0, 11, "durability-") == 0) durability_overrides[key.substr(11)] = value;
+        else if (key == "async-flush-ms") async_flush_ms = std::strtol(value.c_str(), nullptr, 10);
+        else if (key == "sale-partitions") sale_partitions = value;
+        else if (key == "sale-freeze-days") sale_freeze_days = std::atoi(value.c_str());
+        else if (key == "sale-memory-mb") sale_memory_mb = as_size();
+        else if (key == "sale-retention-days") sale_retention_days = std::atoi(value.c_str());
+        else if (key == "financial-retention-days") financial_retention_days = std::atoi(value.c_str());
+        else if (key == "retention-interval-s") retention_interval_s = std::strtol(value.c_str(), nullptr, 10);
+        else if (key == "retention-batch") retention_batch = as_size();
+        else if (key == "max-event-streams") max_event_streams = as_size();
+        else if (key == "change-feed-size") change_feed_size = as_size();
+        else if (key == "idempotency-keys") idempotency_keys = as_size();
+        else if (key == "idempotency-ttl-s") idempotency_ttl_s = std::strtol(value.c_str(), nullptr, 10);
+        else if (key == "replication-listen") replication_listen = value;
+        else if (key == "replicate-from") replicate_from = value;
+        else if (key == "retention-pause-ms") retention_pause_ms = std::strtol(value.c_str(), nullptr, 10);
+        else return false;
+        return true;
+    }
+};
+
+} // namespace dsms
@@ -1,5 +1,16 @@
 #pragma once
 #include "repository.h"  // Ensure this file exists and contains the repository class declarations
+#include "retention_job.h"
+#include "report_kernels.h"
+#include "pnl_report.h"
+#include "live_columns.h"
+#include "top_sellers.h"
+#include "sales_sketches.h"
+#include "low_stock_index.h"
+#include "item_search.h"
+#include "barcode_index.h"
+#include <functional>
+#include <sstream>
 
 namespace dsms {
 
@@ -8,11 +19,201 @@ private:
     ItemRepository& itemRepo;
     PromotionRepository& promoRepo;
 
+    // Item writes go through this service and are serialized, so the
+    // low-stock, search and barcode indexes always match the repository
+    std::mutex stock_mutex_;
+    LowStockIndex low_stock;
+    LowStockAlertLog alerts;
+    ItemSearchIndex search_index;
+    BarcodeIndex barcodes;
+
+    // Raises an alert when the item crosses its reorder point either way
+    void indexItemLocked(const Item& item) {
+        search_index.put(item);
+        barcodes.put(item.getId(), item.getBarcode());
+        bool was_low = false;
+        bool low = low_stock.update(item.getId(), item.getQuantity(), item.getReorderPoint(), was_low);
+        if (low != was_low) {
+            alerts.raise(LowStockEntry{item.getId(), item.getQuantity(), item.getReorderPoint()}, low);
+        }
+    }
+
+    // Checked and written under stock_mutex_, so two writers cannot both
+    // claim one barcode
+    bool barcodeTakenLocked(const Item& item, int id) {
+        if (item.getBarcode().empty()) return false;
+        int holder = barcodes.find(item.getBarcode());
+        return holder != 0 && holder != id;
+    }
+
+    // An item as a primary sent it, inserted or replaced under its own id
+    int applyReplicated(const Item& item) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        int id;
+        if (!itemRepo.saveReplicated(item, id)) return -1;
+        indexItemLocked(item);
+        return id;
+    }
+
+    // A snapshot's items, stored as one write
+    std::vector<int> applyReplicated(const std::vector<Item>& items) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        std::vector<int> ids;
+        itemRepo.saveReplicatedMany(items, &ids);
+        std::map<int, const Item*> by_id;
+        for (const auto& item : items) by_id[item.getId()] = &item;
+        for (int id : ids) indexItemLocked(*by_id[id]);
+        return ids;
+    }
+
+    size_t removeReplicated(const std::vector<int>& ids) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        std::vector<int> removed;
+        itemRepo.removeMany(ids, &removed);
+        for (int id : removed) {
+            low_stock.remove(id);
+            search_index.remove(id);
+            barcodes.remove(id);
+        }
+        return removed.size();
+    }
+
 public:
-    InventoryService(ItemRepository& repo, PromotionRepository& promoRepo)
-        : itemRepo(repo), promoRepo(promoRepo) {}
+    // `store` scopes the change feed resource of the alerts, as for the
+    // repositories; empty for the default store
+    InventoryService(ItemRepository& repo, PromotionRepository& promoRepo, const std::string& store = std::string())
+        : itemRepo(repo), promoRepo(promoRepo) {
+        auto items = itemRepo.findAll();
+        for (const auto& item : items) {
+            bool was_low;
+            low_stock.update(item->getId(), item->getQuantity(), item->getReorderPoint(), was_low);
+        }
+        search_index.build(items);
+        barcodes.build(items);
+        // Alerts go out on the change feed beside the item updates that caused them
+        if (storageConfig().change_feed_capacity > 0) {
+            std::string resource = storeStorageName(store, "low-stock");
+            alerts.addListener([resource](const LowStockAlert& alert) {
+                std::ostringstream data;
+                data << "{\"item_id\":" << alert.entry.item_id
+                     << ",\"quantity\":" << alert.entry.quantity
+                     << ",\"reorder_point\":" << alert.entry.reorder_point
+                     << ",\"low\":" << (alert.low ? "true" : "false")
+                     << ",\"alert_sequence\":" << alert.sequence << "}";
+                changeFeed().publish(resource, ChangeOp::Alert, alert.entry.item_id, data.str());
+            });
+        }
+        // Replicated item writes come through here so the indexes follow them
+        ReplicationTarget target = itemRepo.replicationTarget();
+        target.upsert = [this](const std::string& json) { return applyReplicated(nlohmann::json::parse(json).get<Item>()); };
+        target.remove = [this](int id) { return removeItem(id); };
+        target.upsertMany = [this](const std::vector<std::string>& json) {
+            std::vector<Item> items;
+            items.reserve(json.size());
+            for (const auto& record : json) items.push_back(nlohmann::json::parse(record).get<Item>());
+            return applyReplicated(items);
+        };
+        target.removeMany = [this](const std::vector<int>& ids) { return removeReplicated(ids); };
+        replicationRegistry().add(itemRepo.storageName(), target);
+    }
+
+    ~InventoryService() {
+        replicationRegistry().add(itemRepo.storageName(), itemRepo.replicationTarget());
+    }
     
     InventoryService() = delete;
+
+    static constexpr int kBarcodeTaken = -2;
+
+    // Stores a new item and returns its id, kBarcodeTaken when another item
+    // has its barcode, or -1
+    int addItem(const Item& item) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        if (barcodeTakenLocked(item, 0)) return kBarcodeTaken;
+        int id;
+        if (!itemRepo.saveWithId(item, id)) return -1;
+        Item stored(item);
+        stored.setId(id);
+        indexItemLocked(stored);
+        return id;
+    }
+
+    // Replaces the item only while it is still at revision `expected`, for
+    // clients that read it earlier; `revision` gets the stored revision.
+    // Duplicate when another item has its barcode.
+    UpdateResult updateItemIf(const Item& item, uint64_t expected, uint64_t& revision) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        if (barcodeTakenLocked(item, item.getId())) return UpdateResult::Duplicate;
+        UpdateResult result = itemRepo.compareAndUpdate(item, expected, revision);
+        if (result == UpdateResult::Updated) indexItemLocked(item);
+        return result;
+    }
+
+    bool removeItem(int id) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        if (!itemRepo.remove(id)) return false;
+        low_stock.remove(id);
+        search_index.remove(id);
+        barcodes.remove(id);
+        return true;
+    }
+
+    // Adds `delta` (negative to take stock out) and returns the updated
+    // item, or nullptr when it does not exist or would go below zero
+    std::shared_ptr<Item> adjustStock(int id, int delta) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        auto current = itemRepo.findById(id);
+        if (!current || static_cast<int64_t>(current->getQuantity()) + delta < 0) return nullptr;
+        auto item = std::make_shared<Item>(*current);
+        item->setQuantity(current->getQuantity() + delta);
+        uint64_t revision;
+        if (itemRepo.compareAndUpdate(*item, current->getRevision(), revision) != UpdateResult::Updated) return nullptr;
+        item->setRevision(revision);
+        indexItemLocked(*item);
+        return item;
+    }
+
+    // Takes sold units out of stock, stopping at zero rather than refusing
+    // the sale: the shelf count is the one that is out of date
+    void consumeStock(int id, int quantity) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        auto current = itemRepo.findById(id);
+        if (!current || quantity <= 0) return;
+        Item item(*current);
+        item.setQuantity(std::max(current->getQuantity() - quantity, 0));
+        if (itemRepo.update(item)) indexItemLocked(item);
+    }
+
+    std::shared_ptr<Item> setReorderPoint(int id, int reorder_point) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        auto current = itemRepo.findById(id);
+        if (!current) return nullptr;
+        auto item = std::make_shared<Item>(*current);
+        item->setReorderPoint(std::max(reorder_point, 0));
+        uint64_t revision;
+        if (itemRepo.compareAndUpdate(*item, current->getRevision(), revision) != UpdateResult::Updated) return nullptr;
+        item->setRevision(revision);
+        indexItemLocked(*item);
+        return item;
+    }
+
+    // Items at or below their reorder point, largest shortfall first
+    std::vector<LowStockEntry> getLowStock(size_t limit) {
+        std::lock_guard<std::mutex> lock(stock_mutex_);
+        return low_stock.low(limit);
+    }
+
+    std::vector<LowStockAlert> getLowStockAlerts(uint64_t after) const {
+        return alerts.since(after);
+    }
+
+    uint64_t getLastAlertSequence() const {
+        return alerts.lastSequence();
+    }
+
+    void addLowStockListener(std::function<void(const LowStockAlert&)> listener) {
+        alerts.addListener(std::move(listener));
+    }
     
     std::shared_ptr<Item> getItem(int id) {
         return itemRepo.findById(id);
@@ -21,6 +222,30 @@ public:
     std::vector<std::shared_ptr<Item>> getItemsByDepartment(const std::string& dept) {
         return itemRepo.findByDepartment(dept);
     }
+
+    // Items whose name or company words start with the query words, best
+    // match first
+    std::vector<std::shared_ptr<Item>> searchItems(const std::string& query, size_t limit) {
+        std::vector<std::shared_ptr<Item>> result;
+        for (const SearchHit& hit : search_index.search(query, limit)) {
+            if (auto item = itemRepo.findById(hit.item_id)) result.push_back(item);
+        }
+        return result;
+    }
+
+    // The item a scanner read, or nullptr
+    std::shared_ptr<Item> findByBarcode(const std::string& barcode) {
+        int id = barcodes.find(barcode);
+        return id != 0 ? itemRepo.findById(id) : nullptr;
+    }
+
+    std::vector<std::shared_ptr<Item>> getAllItems() {
+        return itemRepo.findAll();
+    }
+
+    uint64_t getItemsVersion() const {
+        return itemRepo.getVersion();
+    }
 };
 
 class SalesService {
@@ -30,16 +255,84 @@ private:
     FinancialRecordRepository& financeRepo;
     InventoryService& inventoryService;
 
+    // Called after each recorded sale, on the recording thread
+    std::mutex listeners_mutex_;
+    std::vector<std::function<void(const Sale&)>> sale_listeners;
+
+    TopSellerTracker top_sellers;
+
+    void notifySale(const Sale& sale) {
+        std::vector<std::function<void(const Sale&)>> listeners;
+        {
+            std::lock_guard<std::mutex> lock(listeners_mutex_);
+            listeners = sale_listeners;
+        }
+        for (const auto& listener : listeners) listener(sale);
+    }
+
+    // A sale as a primary sent it. Stock is not consumed: the primary's
+    // item update arrives separately.
+    int applyReplicated(const Sale& sale) {
+        bool is_new = !saleRepo.findById(sale.getId());
+        int id;
+        if (!saleRepo.saveReplicated(sale, id)) return -1;
+        if (is_new) notifySale(sale);
+        return id;
+    }
+
+    // A snapshot's sales, stored as one write
+    std::vector<int> applyReplicated(const std::vector<Sale>& sales) {
+        std::set<int> known;
+        for (const auto& sale : saleRepo.findAll()) known.insert(sale->getId());
+        std::vector<int> ids;
+        saleRepo.saveReplicatedMany(sales, &ids);
+        std::set<int> stored(ids.begin(), ids.end());
+        for (const auto& sale : sales) {
+            if (stored.count(sale.getId()) && known.insert(sale.getId()).second) notifySale(sale);
+        }
+        return ids;
+    }
+
 public:
     SalesService(SaleRepository& sRepo, ItemRepository& iRepo,
                 FinancialRecordRepository& fRepo, InventoryService& invService)
-        : saleRepo(sRepo), itemRepo(iRepo), financeRepo(fRepo), inventoryService(invService) {}
+        : saleRepo(sRepo), itemRepo(iRepo), financeRepo(fRepo), inventoryService(invService) {
+        // Start today's best-seller windows from the stored sales
+        time_t now = time(nullptr);
+        time_t today = static_cast<time_t>(topWindowStart(now, TopWindow::Day));
+        for (const auto& sale : saleRepo.findByDateRange(today, now)) top_sellers.record(*sale);
+        addSaleListener([this](const Sale& sale) { top_sellers.record(sale); });
+
+        // Replicated sales feed the best-seller windows like local ones
+        ReplicationTarget target = saleRepo.replicationTarget();
+        target.upsert = [this](const std::string& json) { return applyReplicated(nlohmann::json::parse(json).get<Sale>()); };
+        target.upsertMany = [this](const std::vector<std::string>& json) {
+            std::vector<Sale> sales;
+            sales.reserve(json.size());
+            for (const auto& record : json) sales.push_back(nlohmann::json::parse(record).get<Sale>());
+            return applyReplicated(sales);
+        };
+        replicationRegistry().add(saleRepo.storageName(), target);
+    }
+
+    ~SalesService() {
+        replicationRegistry().add(saleRepo.storageName(), saleRepo.replicationTarget());
+    }
     
     SalesService() = delete;
+
+    void addSaleListener(std::function<void(const Sale&)> listener) {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        sale_listeners.push_back(std::move(listener));
+    }
     
-    bool recordSale(int item_id, int quantity) {
+    // Records a sale at the item's current price and takes it out of
+    // stock; returns the stored sale, or nullptr when the item does not
+    // exist (`item_found` false) or the sale could not be saved
+    std::shared_ptr<Sale> recordSale(int item_id, int quantity, bool& item_found) {
         auto item = itemRepo.findById(item_id);
-        if (!item) return false;
+        item_found = item != nullptr;
+        if (!item) return nullptr;
         
         Sale sale;
         sale.setItemId(item_id);
@@ -47,18 +340,118 @@ public:
         sale.setTotal(item->getPrice() * quantity);
         sale.setTimestamp(time(nullptr));
         
-        return saleRepo.save(sale);
+        int id;
+        if (!saleRepo.saveWithId(sale, id)) return nullptr;
+        sale.setId(id);
+        inventoryService.consumeStock(item_id, quantity);
+        notifySale(sale);
+        return std::make_shared<Sale>(sale);
+    }
+
+    // Best sellers in the current hour or day from the in-memory sketches
+    std::vector<TopSeller> getTopSellers(TopWindow window, bool by_revenue, size_t n) const {
+        return top_sellers.top(window, by_revenue, n, time(nullptr));
+    }
+
+    // The same answer computed from the stored sales, for auditing the
+    // sketches; costs a scan of the window
+    std::vector<TopSeller> getTopSellersExact(TopWindow window, bool by_revenue, size_t n) {
+        time_t start = static_cast<time_t>(topWindowStart(time(nullptr), window));
+        std::unordered_map<int, double> totals;
+        for (const auto& sale : saleRepo.findByDateRange(start, start + topWindowLength(window) - 1)) {
+            totals[sale->getItemId()] += by_revenue ? sale->getTotal() : sale->getQuantity();
+        }
+        std::vector<TopSeller> result;
+        result.reserve(totals.size());
+        for (const auto& entry : totals) {
+            TopSeller seller;
+            seller.item_id = entry.first;
+            seller.value = entry.second;
+            seller.guaranteed = true;
+            result.push_back(seller);
+        }
+        n = std::min(n, result.size());
+        std::partial_sort(result.begin(), result.begin() + n, result.end(), [](const TopSeller& a, const TopSeller& b) {
+            return a.value > b.value || (a.value == b.value && a.item_id < b.item_id);
+        });
+        result.resize(n);
+        return result;
+    }
+
+    uint64_t getSalesInWindow(TopWindow window) const {
+        return top_sellers.salesInWindow(window, time(nullptr));
+    }
+
+    std::shared_ptr<Sale> getSale(int id) {
+        return saleRepo.findById(id);
+    }
+
+    std::vector<std::shared_ptr<Sale>> getAllSales() {
+        return saleRepo.findAll();
+    }
+
+    std::vector<std::shared_ptr<Sale>> getSalesByDateRange(time_t start, time_t end) {
+        return saleRepo.findByDateRange(start, end);
+    }
+
+    uint64_t getSalesVersion() const {
+        return saleRepo.getVersion();
+    }
+
+    ResidencyStats getSalesResidency() const {
+        return saleRepo.residencyStats();
     }
 };
 
+struct RevenueSummary {
+    double revenue = 0.0;
+    size_t sale_count = 0;
+};
+
 class FinancialService {
 private:
     FinancialRecordRepository& financeRepo;
     SaleRepository& saleRepo;
+    ItemRepository& itemRepo;
+
+    // Columnar copy of all sales for reports, following every sale write
+    LiveColumns<Sale, SaleColumns> sale_columns{saleRepo, [](SaleColumns& columns, const Sale& sale) {
+        columns.append(sale.getId(), sale.getTimestamp(), sale.getTotal(), sale.getQuantity(), sale.getItemId());
+    }};
+
+    // The same for financial records, for the P&L
+    LiveColumns<FinancialRecord, FinancialColumns> record_columns{
+        financeRepo, [](FinancialColumns& columns, const FinancialRecord& record) {
+            columns.append(record.getId(), record.getDate(), record.getAmount(), record.getCategory());
+        }};
+
+    static constexpr int64_t kSketchRetentionDays = 400;
+    SalesSketchStore sketches{kSketchRetentionDays};
+
+    // Slices of one report run here while the request thread takes the
+    // first; shared by concurrent reports, and by the stores of a
+    // multi-store deployment
+    std::shared_ptr<WorkerPool> report_pool;
+    size_t report_threads = 1;
 
 public:
-    FinancialService(FinancialRecordRepository& fRepo, SaleRepository& sRepo)
-        : financeRepo(fRepo), saleRepo(sRepo) {}
+    FinancialService(FinancialRecordRepository& fRepo, SaleRepository& sRepo, ItemRepository& iRepo,
+                     SalesService& salesService)
+        : financeRepo(fRepo), saleRepo(sRepo), itemRepo(iRepo) {
+        // Build the analytics sketches once from the retained history, then
+        // keep them current from the sale stream
+        std::map<int, std::string> departments;
+        for (const auto& item : itemRepo.findAll()) departments[item->getId()] = item->getDepartment();
+        time_t now = time(nullptr);
+        for (const auto& sale : saleRepo.findByDateRange(now - kSketchRetentionDays * 86400, now)) {
+            auto found = departments.find(sale->getItemId());
+            sketches.record(*sale, found != departments.end() ? found->second : std::string());
+        }
+        salesService.addSaleListener([this](const Sale& sale) {
+            auto item = itemRepo.findById(sale.getItemId());
+            sketches.record(sale, item ? item->getDepartment() : std::string());
+        });
+    }
     
     FinancialService() = delete;
     
@@ -70,6 +463,83 @@ public:
         }
         return total;
     }
+
+    RevenueSummary getRevenueSummary(time_t start, time_t end) {
+        RevenueSummary summary;
+        for (const auto& sale : saleRepo.findByDateRange(start, end)) {
+            summary.revenue += sale->getTotal();
+            ++summary.sale_count;
+        }
+        return summary;
+    }
+
+    SaleReport getSaleReport(time_t start, time_t end, ReportGrouping grouping) {
+        auto columns = sale_columns.snapshot();
+        DepartmentMap departments;
+        if (grouping == ReportGrouping::Department) {
+            std::map<std::string, int32_t> department_index;
+            int max_item_id = std::max(columns.base->max_item_id, columns.tail->max_item_id);
+            departments.department_of_item.assign(static_cast<size_t>(max_item_id) + 1, -1);
+            for (const auto& item : itemRepo.findAll()) {
+                if (item->getId() < 0 || item->getId() > max_item_id) continue;
+                auto inserted = department_index.emplace(item->getDepartment(),
+                                                         static_cast<int32_t>(departments.names.size()));
+                if (inserted.second) departments.names.push_back(item->getDepartment());
+                departments.department_of_item[item->getId()] = inserted.first->second;
+            }
+        }
+        return runSaleReport(*columns.base, *columns.tail, start, end, grouping, departments,
+                             report_pool.get(), report_threads);
+    }
+
+    // Sales count, revenue, distinct items and basket-value quantiles per
+    // department (plus all departments combined, with an empty name) for
+    // whole UTC days in [start, end], answered from the sketches
+    std::vector<SalesAnalytics> getSalesAnalytics(time_t start, time_t end, const std::string& department) const {
+        return sketches.query(start, end, department);
+    }
+
+    // Sales revenue plus income and expenses per category, for the whole
+    // range and optionally per UTC day
+    PnlReport getProfitAndLoss(time_t start, time_t end, bool by_day) {
+        auto sales = sale_columns.snapshot();
+        auto records = record_columns.snapshot();
+        PnlReport report = runProfitAndLoss(*sales.base, *records.base, start, end, by_day,
+                                            report_pool.get(), report_threads);
+        mergeProfitAndLoss(report, runProfitAndLoss(*sales.tail, *records.tail, start, end, by_day,
+                                                    report_pool.get(), report_threads));
+        return report;
+    }
+
+    // Threads one report may use, including the request thread; 1 runs
+    // reports serially. Call before serving requests.
+    void setReportThreads(size_t threads) {
+        report_threads = std::max<size_t>(threads, 1);
+        report_pool.reset();
+        if (report_threads > 1) {
+            report_pool = std::make_shared<WorkerPool>("report-slices", report_threads - 1, report_threads * 16);
+        }
+    }
+
+    // Split reports like `other` does, on its threads
+    void shareReportThreads(const FinancialService& other) {
+        report_threads = other.report_threads;
+        report_pool = other.report_pool;
+    }
+
+    bool getReportPoolStats(WorkerPoolStats& stats) const {
+        if (!report_pool) return false;
+        stats = report_pool->stats();
+        return true;
+    }
+
+    LiveColumnsStats getSaleColumnStats() const { return sale_columns.stats(); }
+    LiveColumnsStats getRecordColumnStats() const { return record_columns.stats(); }
+
+    // Changes whenever any input to a report changes
+    uint64_t getReportVersion() const {
+        return saleRepo.getVersion() + financeRepo.getVersion() + itemRepo.getVersion();
+    }
 };
 
 class PromotionService {
@@ -86,6 +556,25 @@ public:
     std::vector<std::shared_ptr<Promotion>> getActivePromotions() {
         return promoRepo.findActivePromotions();
     }
+
+    std::vector<std::shared_ptr<Promotion>> getAllPromotions() {
+        return promoRepo.findAll();
+    }
+
+    std::shared_ptr<Promotion> getPromotion(int id) {
+        return promoRepo.findById(id);
+    }
+
+    uint64_t getPromotionsVersion() const {
+        return promoRepo.getVersion();
+    }
 };
 
+// Process-wide service instances (services_impl.cpp)
+InventoryService& getInventoryService();
+SalesService& getSalesService();
+FinancialService& getFinancialService();
+PromotionService& getPromotionService();
+RetentionJob& getRetentionJob();
+
 } // namespace dsms
@@ -0,0 +1,474 @@
+// snapshot.h - Memory-mapped binary snapshots of repository contents
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include "models.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dsms {
+
+// Read-only view of a whole file
+class MappedFile {
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!base) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(file_size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);    // the mapping keeps the file alive
+        if (addr == MAP_FAILED) return false;
+        base = static_cast<const char*>(addr);
+        length = static_cast<size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(const_cast<char*>(base), length);
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// On-disk layout, native endianness (the snapshot is a local cache, never
+// exchanged between machines):
+//
+//   SnapshotHeader | Record[record_count] sorted by id | string heap
+//
+// The source_* fields identify the JSON file the snapshot was taken from; a
+// snapshot whose source no longer matches is ignored.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t record_size;
+    uint64_t record_count;
+    uint64_t heap_offset;
+    uint64_t heap_size;
+    uint64_t source_size;
+    int64_t source_mtime;
+};
+
+constexpr char kSnapshotMagic[8] = {'D', 'S', 'M', 'S', 'S', 'N', 'P', '1'};
+constexpr uint32_t kSnapshotFormatVersion = 4;
+
+// Byte range in the string heap
+struct SnapshotString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+class SnapshotHeapWriter {
+private:
+    std::string bytes;
+
+public:
+    SnapshotString add(const std::string& value) {
+        SnapshotString ref{static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(value.size())};
+        bytes += value;
+        return ref;
+    }
+
+    SnapshotString addInts(const std::vector<int>& values) {
+        SnapshotString ref{static_cast<uint32_t>(bytes.size()),
+                           static_cast<uint32_t>(values.size() * sizeof(int32_t))};
+        for (int value : values) {
+            int32_t v = value;
+            bytes.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+        return ref;
+    }
+
+    const std::string& data() const { return bytes; }
+};
+
+class SnapshotHeapReader {
+private:
+    const char* heap;
+    uint64_t size;
+
+    bool valid(SnapshotString ref) const {
+        return static_cast<uint64_t>(ref.offset) + ref.length <= size;
+    }
+
+public:
+    SnapshotHeapReader(const char* data, uint64_t heap_size) : heap(data), size(heap_size) {}
+
+    std::string string(SnapshotString ref) const {
+        return valid(ref) ? std::string(heap + ref.offset, ref.length) : std::string();
+    }
+
+    std::vector<int> ints(SnapshotString ref) const {
+        std::vector<int> values;
+        if (!valid(ref)) return values;
+        values.resize(ref.length / sizeof(int32_t));
+        for (size_t i = 0; i < values.size(); ++i) {
+            int32_t v;
+            std::memcpy(&v, heap + ref.offset + i * sizeof(v), sizeof(v));
+            values[i] = v;
+        }
+        return values;
+    }
+};
+
+// Fixed-size record layout per model. Every Record starts with `id`.
+template<typename T> struct SnapshotLayout;
+
+template<> struct SnapshotLayout<Item> {
+    struct Record {
+        int32_t id;
+        int32_t quantity;
+        double price;
+        int64_t created_at;
+        int64_t updated_at;
+        SnapshotString name;
+        SnapshotString company;
+        SnapshotString department;
+        int32_t reorder_point;
+        int32_t reserved;
+        SnapshotString barcode;
+        uint64_t revision;
+    };
+
+    static Record encode(const Item& item, SnapshotHeapWriter& heap) {
+        Record r{};
+        r.id = item.getId();
+        r.quantity = item.getQuantity();
+        r.price = item.getPrice();
+        r.created_at = item.getCreatedAt();
+        r.updated_at = item.getUpdatedAt();
+        r.revision = item.getRevision();
+        r.name = heap.add(item.getName());
+        r.company = heap.add(item.getCompany());
+        r.department = heap.add(item.getDepartment());
+        r.reorder_point = item.getReorderPoint();
+        r.barcode = heap.add(item.getBarcode());
+        return r;
+    }
+
+    static Item decode(const Record& r, const SnapshotHeapReader& heap) {
+        Item item;
+        item.setId(r.id);
+        item.setName(heap.string(r.name));
+        item.setCompany(heap.string(r.company));
+        item.setQuantity(r.quantity);
+        item.setPrice(r.price);
+        item.setDepartment(heap.string(r.department));
+        item.setReorderPoint(r.reorder_point);
+        item.setBarcode(heap.string(r.barcode));
+        item.setTimestamps(static_cast<time_t>(r.created_at), static_cast<time_t>(r.updated_at));
+        item.setRevision(r.revision);
+        return item;
+    }
+};
+
+template<> struct SnapshotLayout<Sale> {
+    struct Record {
+        int32_t id;
+        int32_t item_id;
+        int32_t quantity;
+        int32_t reserved;
+        double total;
+        int64_t timestamp;
+        int64_t created_at;
+        int64_t updated_at;
+        uint64_t revision;
+    };
+
+    static Record encode(const Sale& sale, SnapshotHeapWriter&) {
+        Record r{};
+        r.id = sale.getId();
+        r.item_id = sale.getItemId();
+        r.quantity = sale.getQuantity();
+        r.total = sale.getTotal();
+        r.timestamp = sale.getTimestamp();
+        r.created_at = sale.getCreatedAt();
+        r.updated_at = sale.getUpdatedAt();
+        r.revision = sale.getRevision();
+        return r;
+    }
+
+    static Sale decode(const Record& r, const SnapshotHeapReader&) {
+        Sale sale;
+        sale.setId(r.id);
+        sale.setItemId(r.item_id);
+        sale.setQuantity(r.quantity);
+        sale.setTotal(r.total);
+        sale.setTimestamp(static_cast<time_t>(r.timestamp));
+        sale.setTimestamps(static_cast<time_t>(r.created_at), static_cast<time_t>(r.updated_at));
+        sale.setRevision(r.revision);
+        return sale;
+    }
+};
+
+template<> struct SnapshotLayout<FinancialRecord> {
+    struct Record {
+        int32_t id;
+        int32_t reserved;
+        double amount;
+        int64_t created_at;
+        int64_t updated_at;
+        SnapshotString category;
+        SnapshotString description;
+        uint64_t revision;
+    };
+
+    static Record encode(const FinancialRecord& record, SnapshotHeapWriter& heap) {
+        Record r{};
+        r.id = record.getId();
+        r.amount = record.getAmount();
+        r.created_at = record.getCreatedAt();
+        r.updated_at = record.getUpdatedAt();
+        r.revision = record.getRevision();
+        r.category = heap.add(record.getCategory());
+        r.description = heap.add(record.getDescription());
+        return r;
+    }
+
+    static FinancialRecord decode(const Record& r, const SnapshotHeapReader& heap) {
+        FinancialRecord record;
+        record.setId(r.id);
+        record.setCategory(heap.string(r.category));
+        record.setAmount(r.amount);
+        record.setDescription(heap.string(r.description));
+        record.setTimestamps(static_cast<time_t>(r.created_at), static_cast<time_t>(r.updated_at));
+        record.setRevision(r.revision);
+        return record;
+    }
+};
+
+template<> struct SnapshotLayout<Promotion> {
+    struct Record {
+        int32_t id;
+        int32_t reserved;
+        double discount;
+        int64_t start_date;
+        int64_t end_date;
+        int64_t created_at;
+        int64_t updated_at;
+        SnapshotString department;
+        SnapshotString item_ids;
+        uint64_t revision;
+    };
+
+    static Record encode(const Promotion& promo, SnapshotHeapWriter& heap) {
+        Record r{};
+        r.id = promo.getId();
+        r.discount = promo.getDiscount();
+        r.start_date = promo.getStartDate();
+        r.end_date = promo.getEndDate();
+        r.created_at = promo.getCreatedAt();
+        r.updated_at = promo.getUpdatedAt();
+        r.revision = promo.getRevision();
+        r.department = heap.add(promo.getDepartment());
+        r.item_ids = heap.addInts(promo.getItemIds());
+        return r;
+    }
+
+    static Promotion decode(const Record& r, const SnapshotHeapReader& heap) {
+        Promotion promo;
+        promo.setId(r.id);
+        promo.setDepartment(heap.string(r.department));
+        promo.setDiscount(r.discount);
+        promo.setStartDate(static_cast<time_t>(r.start_date));
+        promo.setEndDate(static_cast<time_t>(r.end_date));
+        promo.setItemIds(heap.ints(r.item_ids));
+        promo.setTimestamps(static_cast<time_t>(r.created_at), static_cast<time_t>(r.updated_at));
+        promo.setRevision(r.revision);
+        return promo;
+    }
+};
+
+// Identifies the JSON file a snapshot was taken from
+struct SnapshotSource {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    static SnapshotSource of(const std::string& path) {
+        SnapshotSource source;
+        std::error_code ec;
+        source.size = std::filesystem::file_size(path, ec);
+        if (ec) return SnapshotSource();
+        auto written = std::filesystem::last_write_time(path, ec);
+        if (ec) return SnapshotSource();
+        source.mtime = static_cast<int64_t>(written.time_since_epoch().count());
+        return source;
+    }
+
+    bool operator==(const SnapshotSource& other) const {
+        return size == other.size && mtime == other.mtime;
+    }
+};
+
+// A mapped snapshot. Opening it costs one mmap plus header validation;
+// records are decoded on demand, so startup time does not depend on how
+// much data the snapshot holds.
+template<typename T>
+class Snapshot {
+public:
+    using Layout = SnapshotLayout<T>;
+    using Record = typename Layout::Record;
+
+private:
+    MappedFile file;
+    const Record* records = nullptr;
+    size_t count = 0;
+    SnapshotHeapReader heap{nullptr, 0};
+
+public:
+    // Returns nullptr when the file is missing, malformed, or was taken
+    // from a different version of the source
+    static std::unique_ptr<Snapshot> open(const std::string& path, const SnapshotSource& source) {
+        auto snapshot = std::make_unique<Snapshot>();
+        if (!snapshot->file.open(path)) return nullptr;
+
+        const char* data = snapshot->file.data();
+        size_t size = snapshot->file.size();
+        if (size < sizeof(SnapshotHeader)) return nullptr;
+
+        SnapshotHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+            header.format_version != kSnapshotFormatVersion ||
+            header.record_size != sizeof(Record) ||
+            header.source_size != source.size || header.source_mtime != source.mtime) {
+            return nullptr;
+        }
+
+        uint64_t records_end = sizeof(SnapshotHeader) + header.record_count * sizeof(Record);
+        if (header.record_count > size / sizeof(Record) || records_end > header.heap_offset ||
+            header.heap_offset > size || header.heap_size > size - header.heap_offset) {
+            return nullptr;
+        }
+
+        snapshot->records = reinterpret_cast<const Record*>(data + sizeof(SnapshotHeader));
+        snapshot->count = static_cast<size_t>(header.record_count);
+        snapshot->heap = SnapshotHeapReader(data + header.heap_offset, header.heap_size);
+        return snapshot;
+    }
+
+    // `sorted` must be ordered by id. Written to a temporary file and renamed
+    // into place so a reader never maps a half-written snapshot.
+    static bool write(const std::string& path, const std::vector<std::shared_ptr<T>>& sorted,
+                      const SnapshotSource& source) {
+        SnapshotHeapWriter heap;
+        std::vector<Record> out;
+        out.reserve(sorted.size());
+        for (const auto& model : sorted) {
+            if (model) out.push_back(Layout::encode(*model, heap));
+        }
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+        header.format_version = kSnapshotFormatVersion;
+        header.record_size = sizeof(Record);
+        header.record_count = out.size();
+        header.heap_offset = sizeof(SnapshotHeader) + out.size() * sizeof(Record);
+        header.heap_size = heap.data().size();
+        header.source_size = source.size;
+        header.source_mtime = source.mtime;
+
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file) return false;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(Record));
+            file.write(heap.data().data(), heap.data().size());
+            if (!file) return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        return !ec;
+    }
+
+    size_t size() const { return count; }
+    int idAt(size_t index) const { return records[index].id; }
+    T at(size_t index) const { return Layout::decode(records[index], heap); }
+
+    // Index of the record with `id`, or size() when absent
+    size_t indexOf(int id) const {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (records[mid].id < id) lo = mid + 1;
+            else hi = mid;
+        }
+        return (lo < count && records[lo].id == id) ? lo : count;
+    }
+
+    int maxId() const { return count > 0 ? records[count - 1].id : 0; }
+};
+
+} // namespace dsms
@@ -0,0 +1,515 @@
+// sqlite_repository.h - Embedded SQLite storage backend for Repository<T>
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <sqlite3.h>
+#include "repository_base.h"
+#include "models.h"
+
+namespace dsms {
+
+// Per-model table layout. Columns are listed once in `columns()`; bind()
+// and read() use the same order, with id always first.
+template<typename T> struct SqliteSchema;
+
+template<> struct SqliteSchema<Item> {
+    static const char* table() { return "items"; }
+    static const char* columns() {
+        return "id, name, company, quantity, price, department, created_at, updated_at, reorder_point, barcode, revision";
+    }
+    static const char* create() {
+        return "CREATE TABLE IF NOT EXISTS items ("
+               "id INTEGER PRIMARY KEY, name TEXT NOT NULL, company TEXT NOT NULL, "
+               "quantity INTEGER NOT NULL, price REAL NOT NULL, department TEXT NOT NULL, "
+               "created_at INTEGER NOT NULL, updated_at INTEGER NOT NULL, "
+               "reorder_point INTEGER NOT NULL DEFAULT 0, barcode TEXT NOT NULL DEFAULT '', "
+               "revision INTEGER NOT NULL DEFAULT 0);"
+               "CREATE INDEX IF NOT EXISTS idx_items_department ON items(department);";
+    }
+    // Columns added after the table was first released, for older databases
+    static std::vector<std::pair<const char*, const char*>> addedColumns() {
+        return {{"reorder_point", "INTEGER NOT NULL DEFAULT 0"}, {"barcode", "TEXT NOT NULL DEFAULT ''"},
+                {"revision", "INTEGER NOT NULL DEFAULT 0"}};
+    }
+    static bool hasIndex(const std::string& column) { return column == "department"; }
+    static bool hasRangeIndex(const std::string&) { return false; }
+
+    static void bind(sqlite3_stmt* stmt, const Item& item) {
+        sqlite3_bind_text(stmt, 2, item.getName().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, item.getCompany().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 4, item.getQuantity());
+        sqlite3_bind_double(stmt, 5, item.getPrice());
+        sqlite3_bind_text(stmt, 6, item.getDepartment().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 7, item.getCreatedAt());
+        sqlite3_bind_int64(stmt, 8, item.getUpdatedAt());
+        sqlite3_bind_int(stmt, 9, item.getReorderPoint());
+        sqlite3_bind_text(stmt, 10, item.getBarcode().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 11, static_cast<sqlite3_int64>(item.getRevision()));
+    }
+
+    static Item read(sqlite3_stmt* stmt) {
+        Item item;
+        item.setId(sqlite3_column_int(stmt, 0));
+        item.setName(text(stmt, 1));
+        item.setCompany(text(stmt, 2));
+        item.setQuantity(sqlite3_column_int(stmt, 3));
+        item.setPrice(sqlite3_column_double(stmt, 4));
+        item.setDepartment(text(stmt, 5));
+        item.setReorderPoint(sqlite3_column_int(stmt, 8));
+        item.setBarcode(text(stmt, 9));
+        item.setTimestamps(sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
+        item.setRevision(static_cast<uint64_t>(sqlite3_column_int64(stmt, 10)));
+        return item;
+    }
+
+    static std::string text(sqlite3_stmt* stmt, int col) {
+        const unsigned char* value = sqlite3_column_text(stmt, col);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+};
+
+template<> struct SqliteSchema<Sale> {
+    static const char* table() { return "sales"; }
+    static const char* columns() { return "id, item_id, quantity, total, timestamp, created_at, updated_at, revision"; }
+    static const char* create() {
+        return "CREATE TABLE IF NOT EXISTS sales ("
+               "id INTEGER PRIMARY KEY, item_id INTEGER NOT NULL, quantity INTEGER NOT NULL, "
+               "total REAL NOT NULL, timestamp INTEGER NOT NULL, "
+               "created_at INTEGER NOT NULL, updated_at INTEGER NOT NULL, revision INTEGER NOT NULL DEFAULT 0);"
+               "CREATE INDEX IF NOT EXISTS idx_sales_timestamp ON sales(timestamp);";
+    }
+    static bool hasIndex(const std::string&) { return false; }
+    static bool hasRangeIndex(const std::string& column) { return column == "timestamp"; }
+    static std::vector<std::pair<const char*, const char*>> addedColumns() {
+        return {{"revision", "INTEGER NOT NULL DEFAULT 0"}};
+    }
+
+    static void bind(sqlite3_stmt* stmt, const Sale& sale) {
+        sqlite3_bind_int(stmt, 2, sale.getItemId());
+        sqlite3_bind_int(stmt, 3, sale.getQuantity());
+        sqlite3_bind_double(stmt, 4, sale.getTotal());
+        sqlite3_bind_int64(stmt, 5, sale.getTimestamp());
+        sqlite3_bind_int64(stmt, 6, sale.getCreatedAt());
+        sqlite3_bind_int64(stmt, 7, sale.getUpdatedAt());
+        sqlite3_bind_int64(stmt, 8, static_cast<sqlite3_int64>(sale.getRevision()));
+    }
+
+    static Sale read(sqlite3_stmt* stmt) {
+        Sale sale;
+        sale.setId(sqlite3_column_int(stmt, 0));
+        sale.setItemId(sqlite3_column_int(stmt, 1));
+        sale.setQuantity(sqlite3_column_int(stmt, 2));
+        sale.setTotal(sqlite3_column_double(stmt, 3));
+        sale.setTimestamp(sqlite3_column_int64(stmt, 4));
+        sale.setTimestamps(sqlite3_column_int64(stmt, 5), sqlite3_column_int64(stmt, 6));
+        sale.setRevision(static_cast<uint64_t>(sqlite3_column_int64(stmt, 7)));
+        return sale;
+    }
+};
+
+template<> struct SqliteSchema<FinancialRecord> {
+    static const char* table() { return "financial_records"; }
+    static const char* columns() { return "id, category, amount, description, created_at, updated_at, revision"; }
+    static const char* create() {
+        return "CREATE TABLE IF NOT EXISTS financial_records ("
+               "id INTEGER PRIMARY KEY, category TEXT NOT NULL, amount REAL NOT NULL, "
+               "description TEXT NOT NULL, created_at INTEGER NOT NULL, updated_at INTEGER NOT NULL, "
+               "revision INTEGER NOT NULL DEFAULT 0);"
+               "CREATE INDEX IF NOT EXISTS idx_financial_records_category ON financial_records(category);";
+    }
+    static bool hasIndex(const std::string& column) { return column == "category"; }
+    static bool hasRangeIndex(const std::string&) { return false; }
+    static std::vector<std::pair<const char*, const char*>> addedColumns() {
+        return {{"revision", "INTEGER NOT NULL DEFAULT 0"}};
+    }
+
+    static void bind(sqlite3_stmt* stmt, const FinancialRecord& record) {
+        sqlite3_bind_text(stmt, 2, record.getCategory().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 3, record.getAmount());
+        sqlite3_bind_text(stmt, 4, record.getDescription().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 5, record.getCreatedAt());
+        sqlite3_bind_int64(stmt, 6, record.getUpdatedAt());
+        sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(record.getRevision()));
+    }
+
+    static FinancialRecord read(sqlite3_stmt* stmt) {
+        FinancialRecord record;
+        record.setId(sqlite3_column_int(stmt, 0));
+        record.setCategory(SqliteSchema<Item>::text(stmt, 1));
+        record.setAmount(sqlite3_column_double(stmt, 2));
+        record.setDescription(SqliteSchema<Item>::text(stmt, 3));
+        record.setTimestamps(sqlite3_column_int64(stmt, 4), sqlite3_column_int64(stmt, 5));
+        record.setRevision(static_cast<uint64_t>(sqlite3_column_int64(stmt, 6)));
+        return record;
+    }
+};
+
+template<> struct SqliteSchema<Promotion> {
+    static const char* table() { return "promotions"; }
+    static const char* columns() {
+        return "id, department, discount, start_date, end_date, item_ids, created_at, updated_at, revision";
+    }
+    static const char* create() {
+        return "CREATE TABLE IF NOT EXISTS promotions ("
+               "id INTEGER PRIMARY KEY, department TEXT NOT NULL, discount REAL NOT NULL, "
+               "start_date INTEGER NOT NULL, end_date INTEGER NOT NULL, item_ids TEXT NOT NULL, "
+               "created_at INTEGER NOT NULL, updated_at INTEGER NOT NULL, revision INTEGER NOT NULL DEFAULT 0);";
+    }
+    static bool hasIndex(const std::string&) { return false; }
+    static bool hasRangeIndex(const std::string&) { return false; }
+    static std::vector<std::pair<const char*, const char*>> addedColumns() {
+        return {{"revision", "INTEGER NOT NULL DEFAULT 0"}};
+    }
+
+    static void bind(sqlite3_stmt* stmt, const Promotion& promo) {
+        std::ostringstream ids;
+        for (size_t i = 0; i < promo.getItemIds().size(); ++i) {
+            if (i != 0) ids << ',';
+            ids << promo.getItemIds()[i];
+        }
+        sqlite3_bind_text(stmt, 2, promo.getDepartment().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 3, promo.getDiscount());
+        sqlite3_bind_int64(stmt, 4, promo.getStartDate());
+        sqlite3_bind_int64(stmt, 5, promo.getEndDate());
+        sqlite3_bind_text(stmt, 6, ids.str().c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 7, promo.getCreatedAt());
+        sqlite3_bind_int64(stmt, 8, promo.getUpdatedAt());
+        sqlite3_bind_int64(stmt, 9, static_cast<sqlite3_int64>(promo.getRevision()));
+    }
+
+    static Promotion read(sqlite3_stmt* stmt) {
+        Promotion promo;
+        promo.setId(sqlite3_column_int(stmt, 0));
+        promo.setDepartment(SqliteSchema<Item>::text(stmt, 1));
+        promo.setDiscount(sqlite3_column_double(stmt, 2));
+        promo.setStartDate(sqlite3_column_int64(stmt, 3));
+        promo.setEndDate(sqlite3_column_int64(stmt, 4));
+
+        std::vector<int> ids;
+        std::istringstream list(SqliteSchema<Item>::text(stmt, 5));
+        std::string token;
+        while (std::getline(list, token, ',')) {
+            if (!token.empty()) ids.push_back(std::stoi(token));
+        }
+        promo.setItemIds(ids);
+        promo.setTimestamps(sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
+        promo.setRevision(static_cast<uint64_t>(sqlite3_column_int64(stmt, 8)));
+        return promo;
+    }
+};
+
+// Repository over one table of an SQLite database in WAL mode. Every
+// statement is prepared once; writes are single-row and indexed by the
+// primary key, so they cost O(log n) instead of rewriting the whole store.
+template<typename T>
+class SqliteRepository : public Repository<T> {
+private:
+    using Schema = SqliteSchema<T>;
+
+    sqlite3* db = nullptr;
+    sqlite3_stmt* select_one = nullptr;
+    sqlite3_stmt* select_all = nullptr;
+    sqlite3_stmt* insert_new = nullptr;     // id assigned by SQLite
+    sqlite3_stmt* upsert = nullptr;         // caller-provided id
+    sqlite3_stmt* update_one = nullptr;
+    sqlite3_stmt* delete_one = nullptr;
+    std::map<std::string, sqlite3_stmt*> index_lookups;
+    std::atomic<uint64_t> version{0};
+    std::mutex mutex_;
+    PersistenceCounters counters;     // each write is its own transaction
+    DurabilityMode durability;
+
+    void reportError(const char* what) const {
+        std::cerr << "SQLite error (" << Schema::table() << ", " << what << "): "
+                  << (db ? sqlite3_errmsg(db) : "no connection") << std::endl;
+    }
+
+    sqlite3_stmt* prepare(const std::string& sql) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            reportError(sql.c_str());
+            return nullptr;
+        }
+        return stmt;
+    }
+
+    // "?, ?, ..." for every column, optionally skipping the id
+    static std::string placeholders(bool with_id) {
+        std::string cols = Schema::columns();
+        size_t count = 1 + static_cast<size_t>(std::count(cols.begin(), cols.end(), ','));
+        std::string result;
+        for (size_t i = with_id ? 0 : 1; i < count; ++i) {
+            if (!result.empty()) result += ", ";
+            result += "?" + std::to_string(i + 1);
+        }
+        return result;
+    }
+
+    // CREATE TABLE IF NOT EXISTS leaves tables from older releases alone,
+    // so columns added since are appended with ALTER TABLE
+    void addMissingColumns() {
+        std::set<std::string> present;
+        sqlite3_stmt* info = prepare("PRAGMA table_info(" + std::string(Schema::table()) + ")");
+        if (!info) return;
+        while (sqlite3_step(info) == SQLITE_ROW) {
+            const unsigned char* name = sqlite3_column_text(info, 1);
+            if (name) present.insert(reinterpret_cast<const char*>(name));
+        }
+        sqlite3_finalize(info);
+
+        for (const auto& column : Schema::addedColumns()) {
+            if (present.count(column.first)) continue;
+            std::string sql = "ALTER TABLE " + std::string(Schema::table()) + " ADD COLUMN " +
+                              column.first + " " + column.second;
+            if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) reportError("migrate");
+        }
+    }
+
+    static std::string columnsWithoutId() {
+        std::string cols = Schema::columns();
+        return cols.substr(cols.find(',') + 2);
+    }
+
+    std::string assignments() const {
+        std::string result;
+        std::istringstream list(columnsWithoutId());
+        std::string column;
+        int index = 2;
+        while (std::getline(list, column, ',')) {
+            size_t start = column.find_first_not_of(' ');
+            if (!result.empty()) result += ", ";
+            result += column.substr(start) + " = ?" + std::to_string(index++);
+        }
+        return result;
+    }
+
+    std::vector<std::shared_ptr<T>> collect(sqlite3_stmt* stmt) {
+        std::vector<std::shared_ptr<T>> result;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            result.push_back(std::make_shared<T>(Schema::read(stmt)));
+        }
+        if (rc != SQLITE_DONE) reportError("query");
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return result;
+    }
+
+    bool execute(sqlite3_stmt* stmt, const char* what) {
+        auto started = std::chrono::steady_clock::now();
+        int rc = sqlite3_step(stmt);
+        counters.recordFlush(started, rc == SQLITE_DONE);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (rc != SQLITE_DONE) {
+            reportError(what);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // Sync and Group commit each write with synchronous=FULL (SQLite's WAL
+    // already batches concurrent commits); Async uses synchronous=NORMAL,
+    // which may drop the last transactions on power loss but never corrupts
+    explicit SqliteRepository(const std::string& path, DurabilityMode mode = DurabilityMode::Sync)
+        : durability(mode) {
+        std::filesystem::path dir = std::filesystem::path(path).parent_path();
+        if (!dir.empty() && !std::filesystem::exists(dir)) {
+            std::filesystem::create_directories(dir);
+        }
+
+        if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                            SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
+            reportError("open");
+            return;
+        }
+
+        // Several repositories share one database file, each on its own
+        // connection; WAL lets readers proceed while another table commits
+        sqlite3_busy_timeout(db, 5000);
+        const char* setup = durability == DurabilityMode::Async
+            ? "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL; PRAGMA foreign_keys=ON;"
+            : "PRAGMA journal_mode=WAL; PRAGMA synchronous=FULL; PRAGMA foreign_keys=ON;";
+        if (sqlite3_exec(db, setup, nullptr, nullptr, nullptr) != SQLITE_OK) reportError("pragma");
+        if (sqlite3_exec(db, Schema::create(), nullptr, nullptr, nullptr) != SQLITE_OK) reportError("schema");
+        addMissingColumns();
+
+        std::string table = Schema::table();
+        select_one = prepare("SELECT " + std::string(Schema::columns()) + " FROM " + table + " WHERE id = ?1");
+        select_all = prepare("SELECT " + std::string(Schema::columns()) + " FROM " + table + " ORDER BY id");
+        insert_new = prepare("INSERT INTO " + table + " (" + columnsWithoutId() + ") VALUES (" +
+                             placeholders(false) + ")");
+        upsert = prepare("INSERT OR REPLACE INTO " + table + " (" + Schema::columns() + ") VALUES (" +
+                         placeholders(true) + ")");
+        update_one = prepare("UPDATE " + table + " SET " + assignments() + " WHERE id = ?1");
+        delete_one = prepare("DELETE FROM " + table + " WHERE id = ?1");
+    }
+
+    SqliteRepository(const SqliteRepository&) = delete;
+    SqliteRepository& operator=(const SqliteRepository&) = delete;
+
+    ~SqliteRepository() override {
+        for (sqlite3_stmt* stmt : {select_one, select_all, insert_new, upsert, update_one, delete_one}) {
+            sqlite3_finalize(stmt);
+        }
+        for (auto& entry : index_lookups) sqlite3_finalize(entry.second);
+        sqlite3_close(db);
+    }
+
+    std::shared_ptr<T> findById(int id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!select_one) return nullptr;
+        sqlite3_bind_int(select_one, 1, id);
+        auto rows = collect(select_one);
+        return rows.empty() ? nullptr : rows.front();
+    }
+
+    std::vector<std::shared_ptr<T>> findAll() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!select_all) return {};
+        return collect(select_all);
+    }
+
+    bool save(const T& item) override {
+        int id;
+        return saveWithId(item, id);
+    }
+
+    bool saveWithId(const T& item, int& id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_stmt* stmt = item.getId() > 0 ? upsert : insert_new;
+        if (!stmt) return false;
+        if (item.getId() > 0) sqlite3_bind_int(stmt, 1, item.getId());
+        Schema::bind(stmt, item);
+        if (!execute(stmt, "save")) return false;
+        id = item.getId() > 0 ? item.getId() : static_cast<int>(sqlite3_last_insert_rowid(db));
+        ++version;
+        return true;
+    }
+
+    bool update(const T& item) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!update_one) return false;
+        sqlite3_bind_int(update_one, 1, item.getId());
+        Schema::bind(update_one, item);
+        if (!execute(update_one, "update") || sqlite3_changes(db) == 0) return false;
+        ++version;
+        return true;
+    }
+
+    bool remove(int id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!delete_one) return false;
+        sqlite3_bind_int(delete_one, 1, id);
+        if (!execute(delete_one, "remove") || sqlite3_changes(db) == 0) return false;
+        ++version;
+        return true;
+    }
+
+    // Upserts in a single transaction, so one commit covers the batch
+    size_t saveMany(const std::vector<T>& items, std::vector<int>* stored_ids = nullptr) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!upsert || sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) return 0;
+        std::vector<int> stored;
+        for (const auto& item : items) {
+            if (item.getId() <= 0) continue;
+            sqlite3_bind_int(upsert, 1, item.getId());
+            Schema::bind(upsert, item);
+            int rc = sqlite3_step(upsert);
+            sqlite3_reset(upsert);
+            sqlite3_clear_bindings(upsert);
+            if (rc == SQLITE_DONE) stored.push_back(item.getId());
+        }
+        auto started = std::chrono::steady_clock::now();
+        bool ok = sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+        counters.recordFlush(started, ok);
+        if (!ok) {
+            reportError("saveMany");
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return 0;
+        }
+        if (!stored.empty()) ++version;
+        if (stored_ids) stored_ids->insert(stored_ids->end(), stored.begin(), stored.end());
+        return stored.size();
+    }
+
+    // Deletes in a single transaction, so one commit covers the batch
+    size_t removeMany(const std::vector<int>& ids, std::vector<int>* removed_ids = nullptr) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!delete_one || sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) return 0;
+        std::vector<int> deleted;
+        for (int id : ids) {
+            sqlite3_bind_int(delete_one, 1, id);
+            int rc = sqlite3_step(delete_one);
+            sqlite3_reset(delete_one);
+            sqlite3_clear_bindings(delete_one);
+            if (rc == SQLITE_DONE && sqlite3_changes(db) > 0) deleted.push_back(id);
+        }
+        auto started = std::chrono::steady_clock::now();
+        bool ok = sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK;
+        counters.recordFlush(started, ok);
+        if (!ok) {
+            reportError("removeMany");
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return 0;
+        }
+        if (!deleted.empty()) ++version;
+        if (removed_ids) removed_ids->insert(removed_ids->end(), deleted.begin(), deleted.end());
+        return deleted.size();
+    }
+
+    uint64_t getVersion() const override {
+        return version.load();
+    }
+
+    PersistenceStats persistenceStats() const override {
+        PersistenceStats stats = counters.stats();
+        stats.durability = durabilityName(durability);
+        return stats;
+    }
+
+    bool findByIndex(const std::string& column, const std::string& value,
+                     std::vector<std::shared_ptr<T>>& out) override {
+        if (!Schema::hasIndex(column)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_stmt*& stmt = index_lookups["eq:" + column];
+        if (!stmt) {
+            stmt = prepare("SELECT " + std::string(Schema::columns()) + " FROM " + Schema::table() +
+                           " WHERE " + column + " = ?1 ORDER BY id");
+            if (!stmt) return false;
+        }
+        sqlite3_bind_text(stmt, 1, value.c_str(), -1, SQLITE_TRANSIENT);
+        out = collect(stmt);
+        return true;
+    }
+
+    bool findByRange(const std::string& column, time_t start, time_t end,
+                     std::vector<std::shared_ptr<T>>& out) override {
+        if (!Schema::hasRangeIndex(column)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        sqlite3_stmt*& stmt = index_lookups["range:" + column];
+        if (!stmt) {
+            stmt = prepare("SELECT " + std::string(Schema::columns()) + " FROM " + Schema::table() +
+                           " WHERE " + column + " BETWEEN ?1 AND ?2 ORDER BY " + column);
+            if (!stmt) return false;
+        }
+        sqlite3_bind_int64(stmt, 1, start);
+        sqlite3_bind_int64(stmt, 2, end);
+        out = collect(stmt);
+        return true;
+    }
+};
+
+} // namespace dsms
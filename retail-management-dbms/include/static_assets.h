@@ -0,0 +1,119 @@
+// static_assets.h - In-memory, precompressed web assets
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include "compression.h"
+
+namespace dsms {
+
+struct StaticAsset {
+    std::string content_type;
+    std::string etag;                      // strong ETag of the identity bytes
+    std::vector<unsigned char> identity;
+    std::vector<unsigned char> gzip;       // empty when compression does not pay off
+    std::vector<unsigned char> deflate;
+};
+
+// FNV-1a, used for content-derived ETags
+inline uint64_t fnv1a64(const unsigned char* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+class StaticAssetCache {
+private:
+    std::map<std::string, StaticAsset> assets;
+
+    static std::string contentTypeForPath(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        if (ext == ".html" || ext == ".htm") return "text/html; charset=utf-8";
+        if (ext == ".css") return "text/css; charset=utf-8";
+        if (ext == ".js") return "application/javascript; charset=utf-8";
+        if (ext == ".json") return "application/json";
+        if (ext == ".svg") return "image/svg+xml";
+        if (ext == ".png") return "image/png";
+        if (ext == ".ico") return "image/x-icon";
+        return "application/octet-stream";
+    }
+
+    static bool isCompressible(const std::string& content_type) {
+        return content_type.compare(0, 5, "text/") == 0 ||
+               content_type.find("javascript") != std::string::npos ||
+               content_type.find("json") != std::string::npos ||
+               content_type.find("svg") != std::string::npos;
+    }
+
+public:
+    // Load every file under `root`, keyed by its URL path ("/app.js").
+    // Returns the number of assets loaded.
+    size_t load(const std::string& root) {
+        assets.clear();
+        namespace fs = std::filesystem;
+        if (!fs::exists(root)) return 0;
+
+        for (const auto& entry : fs::recursive_directory_iterator(root)) {
+            if (!entry.is_regular_file()) continue;
+
+            std::ifstream file(entry.path(), std::ios::binary);
+            if (!file) continue;
+
+            StaticAsset asset;
+            asset.identity.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            asset.content_type = contentTypeForPath(entry.path());
+
+            char etag[24];
+            std::snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(
+                fnv1a64(asset.identity.data(), asset.identity.size())));
+            asset.etag = etag;
+
+            if (isCompressible(asset.content_type)) {
+                compressBuffer(asset.identity.data(), asset.identity.size(),
+                               ContentEncoding::Gzip, asset.gzip, Z_BEST_COMPRESSION);
+                compressBuffer(asset.identity.data(), asset.identity.size(),
+                               ContentEncoding::Deflate, asset.deflate, Z_BEST_COMPRESSION);
+                if (asset.gzip.size() >= asset.identity.size()) asset.gzip.clear();
+                if (asset.deflate.size() >= asset.identity.size()) asset.deflate.clear();
+            }
+
+            std::string url = "/" + fs::relative(entry.path(), root).generic_string();
+            assets[url] = std::move(asset);
+        }
+        return assets.size();
+    }
+
+    // "/" resolves to "/index.html"
+    const StaticAsset* find(const std::string& path) const {
+        auto it = assets.find(path.empty() || path == "/" ? "/index.html" : path);
+        return it != assets.end() ? &it->second : nullptr;
+    }
+
+    // Body bytes for the negotiated encoding; falls back to identity when
+    // no smaller precompressed variant exists.
+    static const std::vector<unsigned char>& body(const StaticAsset& asset, ContentEncoding& encoding) {
+        if (encoding == ContentEncoding::Gzip && !asset.gzip.empty()) return asset.gzip;
+        if (encoding == ContentEncoding::Deflate && !asset.deflate.empty()) return asset.deflate;
+        encoding = ContentEncoding::Identity;
+        return asset.identity;
+    }
+
+    // Each encoded representation gets its own strong validator
+    static std::string etagFor(const StaticAsset& asset, ContentEncoding encoding) {
+        if (encoding == ContentEncoding::Identity) return asset.etag;
+        return asset.etag.substr(0, asset.etag.size() - 1) + "-" + encodingName(encoding) + "\"";
+    }
+
+    size_t size() const { return assets.size(); }
+};
+
+} // namespace dsms
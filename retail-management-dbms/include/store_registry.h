@@ -0,0 +1,155 @@
+// store_registry.h - Per-store repositories and services for multi-store deployments
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include "services.h"
+#include "worker_pool.h"
+
+namespace dsms {
+
+// The services one store is reached through
+struct StoreServices {
+    std::string id;
+    InventoryService& inventory;
+    SalesService& sales;
+    FinancialService& financial;
+    PromotionService& promotions;
+};
+
+// A store other than the default one. It owns everything its services
+// touch: files under <data_dir>/stores/<id>/ (or its own dsms.db),
+// repository locks, indexes and report columns, so a busy store never
+// holds up another.
+struct StoreShard {
+    std::string id;
+    ItemRepository items;
+    SaleRepository sales;
+    FinancialRecordRepository financial_records;
+    PromotionRepository promotions;
+    InventoryService inventory_service;
+    SalesService sales_service;
+    FinancialService financial_service;
+    PromotionService promotion_service;
+    RetentionJob retention;
+
+    explicit StoreShard(const std::string& store_id)
+        : id(store_id), items(store_id), sales(store_id), financial_records(store_id), promotions(store_id),
+          inventory_service(items, promotions, store_id),
+          sales_service(sales, items, financial_records, inventory_service),
+          financial_service(financial_records, sales, items, sales_service),
+          promotion_service(promotions, items),
+          retention(sales, financial_records) {}
+
+    StoreServices services() {
+        return StoreServices{id, inventory_service, sales_service, financial_service, promotion_service};
+    }
+};
+
+struct StoreProfitAndLoss {
+    std::string store;
+    PnlPeriod total;
+};
+
+// The default store (the top-level data files, served under /api/...) plus
+// the stores opened at startup (served under /api/stores/{id}/...). The set
+// is fixed once open() returns, so lookups take no lock.
+class StoreRegistry {
+public:
+    static constexpr const char* kDefaultStore = "default";
+
+private:
+    std::vector<StoreServices> stores;
+    std::unordered_map<std::string, size_t> index_of;
+    std::vector<std::unique_ptr<StoreShard>> shards;
+    std::unique_ptr<WorkerPool> pool;
+
+public:
+    explicit StoreRegistry(const StoreServices& default_store) {
+        stores.push_back(default_store);
+        stores.back().id = kDefaultStore;
+        index_of[kDefaultStore] = 0;
+    }
+
+    StoreRegistry(const StoreRegistry&) = delete;
+    StoreRegistry& operator=(const StoreRegistry&) = delete;
+
+    // Opens `ids` and every store that already has a directory under
+    // <data_dir>/stores. Call once, before serving requests.
+    void open(const std::vector<std::string>& ids) {
+        std::set<std::string> wanted;
+        for (const auto& id : ids) {
+            if (id == kDefaultStore || !isValidStoreId(id)) {
+                std::cerr << "Ignoring store id '" << id << "'" << std::endl;
+                continue;
+            }
+            wanted.insert(id);
+        }
+        std::error_code ec;
+        std::filesystem::path root = storageConfig().data_dir + "/stores";
+        if (std::filesystem::is_directory(root, ec)) {
+            for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+                std::string id = entry.path().filename().string();
+                if (entry.is_directory() && isValidStoreId(id) && id != kDefaultStore) wanted.insert(id);
+            }
+        }
+
+        for (const auto& id : wanted) {
+            if (find(id)) continue;
+            shards.push_back(std::make_unique<StoreShard>(id));
+            index_of[id] = stores.size();
+            stores.push_back(shards.back()->services());
+        }
+
+        // Cross-store reports run one store per task
+        pool.reset();
+        size_t threads = std::min<size_t>(stores.size() - 1, std::max(1u, std::thread::hardware_concurrency()));
+        if (threads > 0) pool = std::make_unique<WorkerPool>("stores", threads, stores.size() * 4);
+    }
+
+    // nullptr for a store that was not opened
+    const StoreServices* find(const std::string& id) const {
+        auto found = index_of.find(id);
+        return found != index_of.end() ? &stores[found->second] : nullptr;
+    }
+
+    // The default store first, then the others by id
+    const std::vector<StoreServices>& all() const { return stores; }
+
+    // Profit and loss for [start, end] per store, the stores computed in
+    // parallel
+    std::vector<StoreProfitAndLoss> profitAndLoss(time_t start, time_t end) {
+        std::vector<StoreProfitAndLoss> result(stores.size());
+        parallelFor(pool.get(), stores.size(), [&](size_t i) {
+            result[i].store = stores[i].id;
+            result[i].total = stores[i].financial.getProfitAndLoss(start, end, false).total;
+        });
+        return result;
+    }
+
+    // Retention for the opened stores, archiving to each store's own
+    // directory; the default store keeps getRetentionJob()
+    void startRetention(const RetentionConfig& config) {
+        for (auto& shard : shards) {
+            RetentionConfig store_config = config;
+            store_config.archive_dir = storageConfig().data_dir + "/" + storeStorageName(shard->id, "archive");
+            shard->retention.start(store_config);
+        }
+    }
+
+    void stopRetention() {
+        for (auto& shard : shards) shard->retention.stop();
+    }
+};
+
+// Process-wide registry over the global services (services_impl.cpp)
+StoreRegistry& getStoreRegistry();
+
+} // namespace dsms
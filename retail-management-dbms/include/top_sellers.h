@@ -0,0 +1,217 @@
+// top_sellers.h - Space-Saving heavy-hitter sketches for best-seller queries
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+#include <ctime>
+#include "models.h"
+
+namespace dsms {
+
+// Space-Saving (Metwally, Agrawal, El Abbadi): tracks at most `capacity`
+// keys. An untracked key takes over the smallest counter and inherits its
+// count as `error`, so every estimate overcounts by at most `error` and any
+// key whose true weight exceeds total/capacity is always tracked. Counters
+// sit in a min-heap, making each offer O(log capacity).
+template<typename Key>
+class SpaceSaving {
+public:
+    struct Entry {
+        Key key;
+        double count = 0.0;
+        double error = 0.0;
+    };
+
+private:
+    size_t capacity;
+    std::vector<Entry> heap;
+    std::unordered_map<Key, size_t> position;
+    double total = 0.0;
+
+    void place(size_t i) {
+        position[heap[i].key] = i;
+    }
+
+    void siftDown(size_t i) {
+        for (;;) {
+            size_t smallest = i, left = 2 * i + 1, right = left + 1;
+            if (left < heap.size() && heap[left].count < heap[smallest].count) smallest = left;
+            if (right < heap.size() && heap[right].count < heap[smallest].count) smallest = right;
+            if (smallest == i) return;
+            std::swap(heap[i], heap[smallest]);
+            place(i);
+            place(smallest);
+            i = smallest;
+        }
+    }
+
+    void siftUp(size_t i) {
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (heap[parent].count <= heap[i].count) return;
+            std::swap(heap[i], heap[parent]);
+            place(i);
+            place(parent);
+            i = parent;
+        }
+    }
+
+public:
+    explicit SpaceSaving(size_t counters = 256) : capacity(std::max<size_t>(counters, 1)) {
+        heap.reserve(capacity);
+        position.reserve(capacity * 2);
+    }
+
+    // Weights must be non-negative
+    void offer(const Key& key, double weight) {
+        total += weight;
+        auto found = position.find(key);
+        if (found != position.end()) {
+            heap[found->second].count += weight;
+            siftDown(found->second);
+            return;
+        }
+        if (heap.size() < capacity) {
+            heap.push_back(Entry{key, weight, 0.0});
+            place(heap.size() - 1);
+            siftUp(heap.size() - 1);
+            return;
+        }
+        Entry& smallest = heap.front();
+        position.erase(smallest.key);
+        smallest.error = smallest.count;
+        smallest.count += weight;
+        smallest.key = key;
+        place(0);
+        siftDown(0);
+    }
+
+    // Up to n entries, largest estimate first
+    std::vector<Entry> top(size_t n) const {
+        std::vector<Entry> entries(heap);
+        n = std::min(n, entries.size());
+        std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+                          [](const Entry& a, const Entry& b) { return a.count > b.count; });
+        entries.resize(n);
+        return entries;
+    }
+
+    // Estimate of the (n+1)-th largest weight; a top-n entry whose
+    // count - error is at least this is certainly in the true top n
+    double threshold(size_t n) const {
+        if (heap.size() <= n) return heap.size() < capacity ? 0.0 : heap.front().count;
+        std::vector<double> counts;
+        counts.reserve(heap.size());
+        for (const auto& entry : heap) counts.push_back(entry.count);
+        std::nth_element(counts.begin(), counts.begin() + n, counts.end(), std::greater<double>());
+        return counts[n];
+    }
+
+    double totalWeight() const { return total; }
+    size_t size() const { return heap.size(); }
+
+    void clear() {
+        heap.clear();
+        position.clear();
+        total = 0.0;
+    }
+};
+
+enum class TopWindow {
+    Hour,
+    Day
+};
+
+inline int64_t topWindowLength(TopWindow window) {
+    return window == TopWindow::Hour ? 3600 : 86400;
+}
+
+inline int64_t topWindowStart(time_t ts, TopWindow window) {
+    int64_t length = topWindowLength(window);
+    int64_t t = static_cast<int64_t>(ts);
+    return (t >= 0 ? t / length : (t - length + 1) / length) * length;
+}
+
+struct TopSeller {
+    int item_id = 0;
+    double value = 0.0;       // units or revenue
+    double error = 0.0;       // value may overstate the truth by this much
+    bool guaranteed = false;  // certainly in the true top n
+};
+
+// Best sellers by units and by revenue for the current UTC hour and day,
+// fed one sale at a time. A window resets when the first sale of the next
+// one arrives; sales for an earlier window than the current are ignored.
+class TopSellerTracker {
+private:
+    struct Window {
+        int64_t start = -1;
+        uint64_t sales = 0;
+        SpaceSaving<int> units;
+        SpaceSaving<int> revenue;
+
+        explicit Window(size_t counters) : units(counters), revenue(counters) {}
+    };
+
+    mutable std::mutex mutex_;
+    Window hour;
+    Window day;
+
+    Window& window(TopWindow which) { return which == TopWindow::Hour ? hour : day; }
+    const Window& window(TopWindow which) const { return which == TopWindow::Hour ? hour : day; }
+
+    void recordLocked(Window& w, TopWindow which, const Sale& sale) {
+        int64_t start = topWindowStart(sale.getTimestamp(), which);
+        if (start < w.start) return;
+        if (start > w.start) {
+            w.start = start;
+            w.sales = 0;
+            w.units.clear();
+            w.revenue.clear();
+        }
+        ++w.sales;
+        w.units.offer(sale.getItemId(), static_cast<double>(std::max(sale.getQuantity(), 0)));
+        w.revenue.offer(sale.getItemId(), std::max(sale.getTotal(), 0.0));
+    }
+
+public:
+    explicit TopSellerTracker(size_t counters = 256) : hour(counters), day(counters) {}
+
+    void record(const Sale& sale) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recordLocked(hour, TopWindow::Hour, sale);
+        recordLocked(day, TopWindow::Day, sale);
+    }
+
+    // Top n for the window containing `now`; empty when no sale has been
+    // seen in it yet
+    std::vector<TopSeller> top(TopWindow which, bool by_revenue, size_t n, time_t now) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Window& w = window(which);
+        std::vector<TopSeller> result;
+        if (w.start != topWindowStart(now, which)) return result;
+
+        const SpaceSaving<int>& sketch = by_revenue ? w.revenue : w.units;
+        double threshold = sketch.threshold(n);
+        for (const auto& entry : sketch.top(n)) {
+            TopSeller seller;
+            seller.item_id = entry.key;
+            seller.value = entry.count;
+            seller.error = entry.error;
+            seller.guaranteed = entry.count - entry.error >= threshold;
+            result.push_back(seller);
+        }
+        return result;
+    }
+
+    uint64_t salesInWindow(TopWindow which, time_t now) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Window& w = window(which);
+        return w.start == topWindowStart(now, which) ? w.sales : 0;
+    }
+};
+
+} // namespace dsms
@@ -0,0 +1,272 @@
+// wire_format.h - Binary wire encodings (MessagePack / CBOR) for API responses
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include "models.h"
+
+namespace dsms {
+
+enum class WireFormat { Json, MsgPack, Cbor };
+
+inline const char* contentTypeFor(WireFormat format) {
+    switch (format) {
+        case WireFormat::MsgPack: return "application/msgpack";
+        case WireFormat::Cbor: return "application/cbor";
+        default: return "application/json";
+    }
+}
+
+// Pick the response format from an HTTP Accept header. Media types are
+// compared case-insensitively and ranked by their q-value; anything we do
+// not understand (including */*) falls back to JSON.
+inline WireFormat negotiateWireFormat(const std::string& accept) {
+    WireFormat best = WireFormat::Json;
+    double best_q = 0.0;
+    double json_q = -1.0;
+
+    size_t pos = 0;
+    while (pos <= accept.size()) {
+        size_t end = accept.find(',', pos);
+        if (end == std::string::npos) end = accept.size();
+        std::string entry = accept.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::string type;
+        double q = 1.0;
+        size_t semi = entry.find(';');
+        type = entry.substr(0, semi);
+        if (semi != std::string::npos) {
+            size_t qpos = entry.find("q=", semi);
+            if (qpos != std::string::npos) {
+                q = std::strtod(entry.c_str() + qpos + 2, nullptr);
+            }
+        }
+
+        std::string media;
+        for (char c : type) {
+            if (!std::isspace(static_cast<unsigned char>(c))) {
+                media += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+
+        WireFormat candidate;
+        if (media == "application/msgpack" || media == "application/x-msgpack" ||
+            media == "application/vnd.msgpack") {
+            candidate = WireFormat::MsgPack;
+        } else if (media == "application/cbor") {
+            candidate = WireFormat::Cbor;
+        } else {
+            if (media == "application/json") json_q = q;
+            continue;
+        }
+
+        if (q > best_q) {
+            best = candidate;
+            best_q = q;
+        }
+    }
+
+    // An explicit JSON preference wins ties.
+    if (best != WireFormat::Json && json_q >= best_q) return WireFormat::Json;
+    return best;
+}
+
+// Streaming encoder for MessagePack and CBOR. Both formats share the same
+// shape (typed heads followed by big-endian payloads) so one writer covers
+// them; containers must be sized up front.
+class BinaryEncoder {
+private:
+    WireFormat format;
+    std::vector<unsigned char> out;
+
+    void put(unsigned char b) { out.push_back(b); }
+
+    void putBigEndian(uint64_t v, int bytes) {
+        for (int i = bytes - 1; i >= 0; --i) {
+            out.push_back(static_cast<unsigned char>((v >> (i * 8)) & 0xff));
+        }
+    }
+
+    // CBOR head: 3-bit major type plus the shortest length encoding
+    void cborHead(unsigned char major, uint64_t n) {
+        unsigned char m = static_cast<unsigned char>(major << 5);
+        if (n < 24) {
+            put(static_cast<unsigned char>(m | n));
+        } else if (n <= 0xff) {
+            put(m | 24); putBigEndian(n, 1);
+        } else if (n <= 0xffff) {
+            put(m | 25); putBigEndian(n, 2);
+        } else if (n <= 0xffffffffULL) {
+            put(m | 26); putBigEndian(n, 4);
+        } else {
+            put(m | 27); putBigEndian(n, 8);
+        }
+    }
+
+    void msgpackContainer(size_t n, unsigned char fix, unsigned char fix_limit,
+                          unsigned char tag16, unsigned char tag32) {
+        if (n < fix_limit) {
+            put(static_cast<unsigned char>(fix | n));
+        } else if (n <= 0xffff) {
+            put(tag16); putBigEndian(n, 2);
+        } else {
+            put(tag32); putBigEndian(n, 4);
+        }
+    }
+
+public:
+    explicit BinaryEncoder(WireFormat fmt) : format(fmt) {}
+
+    void reserve(size_t bytes) { out.reserve(bytes); }
+
+    void beginMap(size_t n) {
+        if (format == WireFormat::Cbor) cborHead(5, n);
+        else msgpackContainer(n, 0x80, 16, 0xde, 0xdf);
+    }
+
+    void beginArray(size_t n) {
+        if (format == WireFormat::Cbor) cborHead(4, n);
+        else msgpackContainer(n, 0x90, 16, 0xdc, 0xdd);
+    }
+
+    void writeString(const std::string& s) {
+        size_t n = s.size();
+        if (format == WireFormat::Cbor) {
+            cborHead(3, n);
+        } else if (n < 32) {
+            put(static_cast<unsigned char>(0xa0 | n));
+        } else if (n <= 0xff) {
+            put(0xd9); putBigEndian(n, 1);
+        } else if (n <= 0xffff) {
+            put(0xda); putBigEndian(n, 2);
+        } else {
+            put(0xdb); putBigEndian(n, 4);
+        }
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    void writeInt(int64_t v) {
+        if (format == WireFormat::Cbor) {
+            if (v >= 0) cborHead(0, static_cast<uint64_t>(v));
+            else cborHead(1, static_cast<uint64_t>(-1 - v));
+            return;
+        }
+        if (v >= 0) {
+            if (v < 128) put(static_cast<unsigned char>(v));
+            else if (v <= 0xff) { put(0xcc); putBigEndian(v, 1); }
+            else if (v <= 0xffff) { put(0xcd); putBigEndian(v, 2); }
+            else if (v <= 0xffffffffLL) { put(0xce); putBigEndian(v, 4); }
+            else { put(0xcf); putBigEndian(v, 8); }
+        } else {
+            if (v >= -32) put(static_cast<unsigned char>(v));
+            else if (v >= -128) { put(0xd0); putBigEndian(static_cast<uint64_t>(v), 1); }
+            else if (v >= -32768) { put(0xd1); putBigEndian(static_cast<uint64_t>(v), 2); }
+            else if (v >= -2147483648LL) { put(0xd2); putBigEndian(static_cast<uint64_t>(v), 4); }
+            else { put(0xd3); putBigEndian(static_cast<uint64_t>(v), 8); }
+        }
+    }
+
+    // Doubles that survive a round trip through float are sent as 32-bit
+    void writeDouble(double d) {
+        float f = static_cast<float>(d);
+        if (static_cast<double>(f) == d) {
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            put(format == WireFormat::Cbor ? 0xfa : 0xca);
+            putBigEndian(bits, 4);
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            put(format == WireFormat::Cbor ? 0xfb : 0xcb);
+            putBigEndian(bits, 8);
+        }
+    }
+
+    void writeBool(bool b) {
+        if (format == WireFormat::Cbor) put(b ? 0xf5 : 0xf4);
+        else put(b ? 0xc3 : 0xc2);
+    }
+
+    void writeNull() { put(format == WireFormat::Cbor ? 0xf6 : 0xc0); }
+
+    size_t size() const { return out.size(); }
+    std::vector<unsigned char> release() { return std::move(out); }
+};
+
+// Model encoders. Field names match toJsonString(); timestamps are sent as
+// integer epoch seconds rather than ISO strings.
+inline void encodeModel(BinaryEncoder& enc, const Item& item) {
+    enc.beginMap(11);
+    enc.writeString("id"); enc.writeInt(item.getId());
+    enc.writeString("name"); enc.writeString(item.getName());
+    enc.writeString("company"); enc.writeString(item.getCompany());
+    enc.writeString("quantity"); enc.writeInt(item.getQuantity());
+    enc.writeString("price"); enc.writeDouble(item.getPrice());
+    enc.writeString("department"); enc.writeString(item.getDepartment());
+    enc.writeString("reorder_point"); enc.writeInt(item.getReorderPoint());
+    enc.writeString("barcode"); enc.writeString(item.getBarcode());
+    enc.writeString("created_at"); enc.writeInt(item.getCreatedAt());
+    enc.writeString("updated_at"); enc.writeInt(item.getUpdatedAt());
+    enc.writeString("revision"); enc.writeInt(static_cast<int64_t>(item.getRevision()));
+}
+
+inline void encodeModel(BinaryEncoder& enc, const Sale& sale) {
+    enc.beginMap(8);
+    enc.writeString("id"); enc.writeInt(sale.getId());
+    enc.writeString("item_id"); enc.writeInt(sale.getItemId());
+    enc.writeString("quantity"); enc.writeInt(sale.getQuantity());
+    enc.writeString("total"); enc.writeDouble(sale.getTotal());
+    enc.writeString("timestamp"); enc.writeInt(sale.getTimestamp());
+    enc.writeString("created_at"); enc.writeInt(sale.getCreatedAt());
+    enc.writeString("updated_at"); enc.writeInt(sale.getUpdatedAt());
+    enc.writeString("revision"); enc.writeInt(static_cast<int64_t>(sale.getRevision()));
+}
+
+inline void encodeModel(BinaryEncoder& enc, const FinancialRecord& record) {
+    enc.beginMap(7);
+    enc.writeString("id"); enc.writeInt(record.getId());
+    enc.writeString("type"); enc.writeString(record.getType());
+    enc.writeString("amount"); enc.writeDouble(record.getAmount());
+    enc.writeString("description"); enc.writeString(record.getDescription());
+    enc.writeString("created_at"); enc.writeInt(record.getCreatedAt());
+    enc.writeString("updated_at"); enc.writeInt(record.getUpdatedAt());
+    enc.writeString("revision"); enc.writeInt(static_cast<int64_t>(record.getRevision()));
+}
+
+inline void encodeModel(BinaryEncoder& enc, const Promotion& promo) {
+    enc.beginMap(9);
+    enc.writeString("id"); enc.writeInt(promo.getId());
+    enc.writeString("department"); enc.writeString(promo.getDepartment());
+    enc.writeString("discount"); enc.writeDouble(promo.getDiscount());
+    enc.writeString("start_date"); enc.writeInt(promo.getStartDate());
+    enc.writeString("end_date"); enc.writeInt(promo.getEndDate());
+    enc.writeString("item_ids");
+    enc.beginArray(promo.getItemIds().size());
+    for (int id : promo.getItemIds()) enc.writeInt(id);
+    enc.writeString("created_at"); enc.writeInt(promo.getCreatedAt());
+    enc.writeString("updated_at"); enc.writeInt(promo.getUpdatedAt());
+    enc.writeString("revision"); enc.writeInt(static_cast<int64_t>(promo.getRevision()));
+}
+
+template<typename T>
+std::vector<unsigned char> encodeModels(WireFormat format, const std::vector<std::shared_ptr<T>>& models) {
+    BinaryEncoder enc(format);
+    enc.reserve(models.size() * 96);
+    size_t count = 0;
+    for (const auto& model : models) {
+        if (model) ++count;
+    }
+    enc.beginArray(count);
+    for (const auto& model : models) {
+        if (model) encodeModel(enc, *model);
+    }
+    return enc.release();
+}
+
+} // namespace dsms
@@ -0,0 +1,172 @@
+// worker_pool.h - Fixed-size worker pool with a bounded admission queue
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+
+namespace dsms {
+
+struct WorkerPoolStats {
+    size_t threads = 0;
+    size_t queue_depth = 0;
+    size_t peak_queue_depth = 0;
+    size_t max_queue_depth = 0;
+    size_t active = 0;
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    uint64_t completed = 0;
+};
+
+// Tasks are admitted only while fewer than max_queue_depth are waiting, so
+// overload shows up as an immediate tryPost() failure the caller can turn
+// into a 503 instead of an ever-growing backlog.
+class WorkerPool {
+private:
+    std::string name;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    size_t max_queue_depth;
+    size_t peak_queue_depth = 0;
+    bool stopping = false;
+    mutable std::mutex mutex_;
+    std::condition_variable available;
+
+    std::atomic<size_t> active{0};
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> completed{0};
+
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                available.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;   // stopping and drained
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            ++active;
+            try {
+                task();
+            } catch (...) {
+                // Tasks report their own errors; never let one kill a worker
+            }
+            --active;
+            ++completed;
+        }
+    }
+
+public:
+    WorkerPool(const std::string& pool_name, size_t threads, size_t max_depth)
+        : name(pool_name), max_queue_depth(max_depth) {
+        if (threads == 0) threads = 1;
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        shutdown();
+    }
+
+    // Returns false, without running the task, when the queue is full or the
+    // pool is shutting down
+    bool tryPost(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping || queue.size() >= max_queue_depth) {
+                ++rejected;
+                return false;
+            }
+            queue.push_back(std::move(task));
+            if (queue.size() > peak_queue_depth) peak_queue_depth = queue.size();
+        }
+        ++accepted;
+        available.notify_one();
+        return true;
+    }
+
+    // Finishes queued work, then joins the workers
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping) return;
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    const std::string& getName() const { return name; }
+
+    WorkerPoolStats stats() const {
+        WorkerPoolStats s;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            s.queue_depth = queue.size();
+            s.peak_queue_depth = peak_queue_depth;
+        }
+        s.threads = workers.size();
+        s.max_queue_depth = max_queue_depth;
+        s.active = active.load();
+        s.accepted = accepted.load();
+        s.rejected = rejected.load();
+        s.completed = completed.load();
+        return s;
+    }
+};
+
+// Runs task(0) .. task(count - 1) and returns when all have finished.
+// task(0) runs on the calling thread, the rest are posted to `pool`; any
+// the pool refuses run on the caller too, so this never waits on a full
+// queue. The first exception thrown by a task is rethrown here.
+template<typename Task>
+void parallelFor(WorkerPool* pool, size_t count, Task task) {
+    if (!pool || count <= 1) {
+        for (size_t i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t remaining = count - 1;
+    std::exception_ptr failure;
+    auto runOne = [&](size_t i) {
+        std::exception_ptr error;
+        try {
+            task(i);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error && !failure) failure = error;
+        if (i > 0 && --remaining == 0) finished.notify_one();
+    };
+
+    for (size_t i = 1; i < count; ++i) {
+        if (!pool->tryPost([&runOne, i] { runOne(i); })) runOne(i);
+    }
+    runOne(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return remaining == 0; });
+    if (failure) std::rethrow_exception(failure);
+}
+
+} // namespace dsms
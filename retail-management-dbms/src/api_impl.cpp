@@ -1,57 +1,1416 @@
-// Helper functions for path and query parameter parsing
+// api_impl.cpp - REST API controllers, routing and listener
 #include "api.h"
+#include "replication.h"
 #include <cpprest/uri.h>
-#include <regex>
+#include <cpprest/producerconsumerstream.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <iterator>
+#include <iostream>
 
 namespace dsms {
 
-std::vector<std::string> split_path(const web::http::http_request& request) {
-    // Convert from utility::string_t to std::string
-    auto relative_path = utility::conversions::to_utf8string(
-        web::uri::decode(request.relative_uri().path())
-    );
-    
-    std::vector<std::string> path_segments;
-    
-    // Skip the first character if it's a '/'
-    size_t start = (relative_path.size() > 0 && relative_path[0] == '/') ? 1 : 0;
-    
-    size_t pos = start;
-    while (pos < relative_path.size()) {
-        size_t next_pos = relative_path.find('/', pos);
-        if (next_pos == std::string::npos) {
-            path_segments.push_back(relative_path.substr(pos));
+// UTF-8 view of a URI component. On UTF-16 platforms the converted copy is
+// kept in `storage`; elsewhere the view aliases `value` directly.
+static std::string_view utf8_view(const utility::string_t& value, std::string& storage) {
+#ifdef _UTF16_STRINGS
+    storage = utility::conversions::to_utf8string(value);
+    return storage;
+#else
+    (void)storage;
+    return value;
+#endif
+}
+
+static HttpMethod route_method(const web::http::method& method) {
+    if (method == web::http::methods::GET) return HttpMethod::Get;
+    if (method == web::http::methods::POST) return HttpMethod::Post;
+    if (method == web::http::methods::PUT) return HttpMethod::Put;
+    if (method == web::http::methods::DEL) return HttpMethod::Delete;
+    return HttpMethod::Count;
+}
+
+// True when an If-None-Match header lists `etag` (weak comparison) or "*"
+static bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    auto strip_weak = [](std::string tag) {
+        if (tag.compare(0, 2, "W/") == 0) tag.erase(0, 2);
+        return tag;
+    };
+    std::string wanted = strip_weak(etag);
+
+    size_t pos = 0;
+    while (pos < if_none_match.size()) {
+        size_t end = if_none_match.find(',', pos);
+        if (end == std::string::npos) end = if_none_match.size();
+        size_t first = if_none_match.find_first_not_of(' ', pos);
+        size_t last = if_none_match.find_last_not_of(' ', end - 1);
+        if (first != std::string::npos && first < end) {
+            std::string tag = if_none_match.substr(first, last - first + 1);
+            if (tag == "*" || strip_weak(tag) == wanted) return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+static std::string header_value(const web::http::http_request& request, const utility::string_t& name) {
+    auto it = request.headers().find(name);
+    if (it == request.headers().end()) return "";
+    return utility::conversions::to_utf8string(it->second);
+}
+
+// Non-negative decimal id, or -1
+static int parse_id(std::string_view segment) {
+    if (segment.empty() || segment.size() > 9) return -1;
+    int id = 0;
+    for (char c : segment) {
+        if (c < '0' || c > '9') return -1;
+        id = id * 10 + (c - '0');
+    }
+    return id;
+}
+
+// The revision an If-Match header asks for: an ETag from GET /api/items/{id},
+// whose last number is the revision, or the bare number. False when the
+// header is not a single such tag.
+static bool if_match_revision(const std::string& if_match, uint64_t& revision) {
+    size_t first = if_match.find_first_not_of(' ');
+    size_t last = if_match.find_last_not_of(' ');
+    if (first == std::string::npos) return false;
+    std::string tag = if_match.substr(first, last - first + 1);
+    if (tag.compare(0, 2, "W/") == 0) tag.erase(0, 2);
+    if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"') tag = tag.substr(1, tag.size() - 2);
+    size_t dash = tag.rfind('-');
+    std::string digits = dash == std::string::npos ? tag : tag.substr(dash + 1);
+    if (digits.empty() || digits.size() > 19) return false;
+    revision = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') return false;
+        revision = revision * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+// ApiController
+
+web::json::value ApiController::model_to_json(const std::shared_ptr<Model>& model) {
+    if (!model) return web::json::value::null();
+    return web::json::value::parse(utility::conversions::to_string_t(model->toJsonString()));
+}
+
+web::json::value ApiController::models_to_json(const std::vector<std::shared_ptr<Model>>& models) {
+    web::json::value result = web::json::value::array();
+    size_t index = 0;
+    for (const auto& model : models) {
+        if (model) result[index++] = model_to_json(model);
+    }
+    return result;
+}
+
+WireFormat ApiController::negotiate_format(const web::http::http_request& request) {
+    return negotiateWireFormat(header_value(request, web::http::header_names::accept));
+}
+
+static size_t g_compression_threshold = 1024;
+
+size_t ApiController::compression_threshold() {
+    return g_compression_threshold;
+}
+
+void ApiController::set_compression_threshold(size_t bytes) {
+    g_compression_threshold = bytes;
+}
+
+void ApiController::send_body(const web::http::http_request& request, web::http::status_code status,
+                              const std::string& body, const std::string& content_type) {
+    if (body.size() < g_compression_threshold) {
+        request.reply(status, body, content_type);
+        return;
+    }
+    send_body(request, status, std::vector<unsigned char>(body.begin(), body.end()), content_type);
+}
+
+void ApiController::send_body(const web::http::http_request& request, web::http::status_code status,
+                              std::vector<unsigned char> body, const std::string& content_type,
+                              const std::string& etag) {
+    web::http::http_response response(status);
+    response.headers().add(U("Vary"), U("Accept, Accept-Encoding"));
+    if (!etag.empty()) {
+        response.headers().add(web::http::header_names::etag, utility::conversions::to_string_t(etag));
+        response.headers().add(web::http::header_names::cache_control, U("no-cache"));
+    }
+
+    if (body.size() >= g_compression_threshold) {
+        ContentEncoding encoding = negotiateContentEncoding(
+            header_value(request, web::http::header_names::accept_encoding));
+        std::vector<unsigned char> compressed;
+        if (compressBuffer(body.data(), body.size(), encoding, compressed, Z_BEST_SPEED) &&
+            compressed.size() < body.size()) {
+            body.swap(compressed);
+            response.headers().add(web::http::header_names::content_encoding,
+                                   utility::conversions::to_string_t(encodingName(encoding)));
+        }
+    }
+
+    response.set_body(std::move(body));
+    response.headers().set_content_type(utility::conversions::to_string_t(content_type));
+    request.reply(response);
+}
+
+// Versions restart at zero with the process, so ETags carry the start time
+static const time_t g_etag_epoch = time(nullptr);
+
+std::string ApiController::make_etag(const std::string& resource, WireFormat format, uint64_t version) {
+    // Weak: the same representation may be sent with different Content-Encodings
+    std::string format_tag = format == WireFormat::Json ? "json" : format == WireFormat::MsgPack ? "msgpack" : "cbor";
+    return "W/\"" + resource + "-" + format_tag + "-" + std::to_string(g_etag_epoch) + "-" +
+           std::to_string(version) + "\"";
+}
+
+bool ApiController::is_not_modified(const web::http::http_request& request, const std::string& etag) {
+    return etag_matches(header_value(request, web::http::header_names::if_none_match), etag);
+}
+
+void ApiController::reply_not_modified(const web::http::http_request& request, const std::string& etag) {
+    web::http::http_response response(web::http::status_codes::NotModified);
+    response.headers().add(web::http::header_names::etag, utility::conversions::to_string_t(etag));
+    response.headers().add(web::http::header_names::cache_control, U("no-cache"));
+    response.headers().add(U("Vary"), U("Accept, Accept-Encoding"));
+    request.reply(response);
+}
+
+ResponseCache& ApiController::response_cache() {
+    static ResponseCache cache(512);
+    return cache;
+}
+
+void ApiController::handle_get(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::MethodNotAllowed);
+}
+
+void ApiController::handle_post(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::MethodNotAllowed);
+}
+
+void ApiController::handle_put(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::MethodNotAllowed);
+}
+
+void ApiController::handle_delete(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::MethodNotAllowed);
+}
+
+// ItemsController
+
+void ItemsController::handle_get(web::http::http_request request, const RouteMatch& route) {
+    uint64_t version = inventory_service.getItemsVersion();
+
+    // /api/items/{id}
+    if (route.param_count > 0) {
+        int id = parse_id(route.param(0));
+        if (id < 0) {
+            request.reply(web::http::status_codes::BadRequest, "Invalid item id");
+            return;
+        }
+        auto item = inventory_service.getItem(id);
+        if (!item) {
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        }
+        // Tagged with the item's own revision, which PUT takes as If-Match
+        reply_versioned(request, "items/" + std::to_string(id), item->getRevision(), [&item](WireFormat format) {
+            return serialize_model(format, *item);
+        });
+        return;
+    }
+
+    reply_versioned(request, "items", version, [&](WireFormat format) {
+        if (route.query.has("department")) {
+            return serialize_models(format, inventory_service.getItemsByDepartment(route.query.get("department")));
+        }
+        return serialize_models(format, inventory_service.getAllItems());
+    });
+}
+
+void ItemsController::handle_search(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/search?q=<words>&limit=20
+    std::string query = route.query.get("q");
+    if (query.empty()) {
+        request.reply(web::http::status_codes::BadRequest, "q is required");
+        return;
+    }
+    size_t limit = static_cast<size_t>(std::min<long long>(std::max<long long>(route.query.getInt("limit", 20), 1), 200));
+    reply_models(request, inventory_service.searchItems(query, limit));
+}
+
+void ItemsController::handle_barcode(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/barcode/{code}
+    auto item = inventory_service.findByBarcode(pathDecode(route.param(0)));
+    if (!item) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+    reply_versioned(request, "items", inventory_service.getItemsVersion(), [&item](WireFormat format) {
+        return serialize_model(format, *item);
+    });
+}
+
+void ItemsController::handle_post(web::http::http_request request, const RouteMatch& route) {
+    // /api/items with {"name", "company", "quantity", "price", "department", "reorder_point", "barcode"}
+    Item item;
+    try {
+        web::json::value body = request.extract_json().get();
+        auto text = [&body](const char* field) {
+            return body.has_field(U(field)) && body.at(U(field)).is_string()
+                       ? utility::conversions::to_utf8string(body.at(U(field)).as_string()) : std::string();
+        };
+        auto integer = [&body](const char* field) {
+            return body.has_field(U(field)) && body.at(U(field)).is_integer() ? body.at(U(field)).as_integer() : 0;
+        };
+        item.setName(text("name"));
+        item.setCompany(text("company"));
+        item.setDepartment(text("department"));
+        item.setBarcode(text("barcode"));
+        item.setQuantity(integer("quantity"));
+        item.setReorderPoint(integer("reorder_point"));
+        if (body.has_field(U("price")) && body.at(U("price")).is_number()) {
+            item.setPrice(body.at(U("price")).as_double());
+        }
+    } catch (const std::exception&) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item");
+        return;
+    }
+    if (item.getName().empty() || item.getQuantity() < 0 || item.getPrice() < 0 || item.getReorderPoint() < 0) {
+        request.reply(web::http::status_codes::BadRequest, "name is required; quantity, price and reorder_point must not be negative");
+        return;
+    }
+    int id = inventory_service.addItem(item);
+    if (id == InventoryService::kBarcodeTaken) {
+        request.reply(web::http::status_codes::Conflict, "barcode belongs to another item");
+        return;
+    }
+    if (id < 0) {
+        request.reply(web::http::status_codes::InternalError);
+        return;
+    }
+    item.setId(id);
+    item.setRevision(1);
+    send_body(request, web::http::status_codes::Created, item.toJsonString(), "application/json");
+}
+
+void ItemsController::handle_put(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/{id} with any of the POST fields; the others keep their
+    // values. With If-Match the update only applies while the item is still
+    // at that revision, and 409 answers with the item as it is now.
+    int id = parse_id(route.param(0));
+    if (id < 0) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item id");
+        return;
+    }
+    std::string if_match = header_value(request, web::http::header_names::if_match);
+    bool conditional = !if_match.empty() && if_match != "*";
+    uint64_t expected = 0;
+    if (conditional && !if_match_revision(if_match, expected)) {
+        request.reply(web::http::status_codes::BadRequest, "If-Match must be one ETag from GET /api/items/{id}");
+        return;
+    }
+    web::json::value body;
+    try {
+        body = request.extract_json().get();
+    } catch (const std::exception&) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item");
+        return;
+    }
+    if (!body.is_object()) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item");
+        return;
+    }
+    auto text = [&body](const char* field, std::string current) {
+        return body.has_field(U(field)) && body.at(U(field)).is_string()
+                   ? utility::conversions::to_utf8string(body.at(U(field)).as_string()) : current;
+    };
+    auto integer = [&body](const char* field, int current) {
+        return body.has_field(U(field)) && body.at(U(field)).is_integer() ? body.at(U(field)).as_integer() : current;
+    };
+
+    // Without If-Match the fields are applied to the latest revision,
+    // rereading it when another writer got in between
+    for (int attempt = 0;; ++attempt) {
+        auto current = inventory_service.getItem(id);
+        if (!current) {
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        }
+        Item item(*current);
+        item.setName(text("name", item.getName()));
+        item.setCompany(text("company", item.getCompany()));
+        item.setDepartment(text("department", item.getDepartment()));
+        item.setBarcode(text("barcode", item.getBarcode()));
+        item.setQuantity(integer("quantity", item.getQuantity()));
+        item.setReorderPoint(integer("reorder_point", item.getReorderPoint()));
+        if (body.has_field(U("price")) && body.at(U("price")).is_number()) {
+            item.setPrice(body.at(U("price")).as_double());
+        }
+        if (item.getName().empty() || item.getQuantity() < 0 || item.getPrice() < 0 || item.getReorderPoint() < 0) {
+            request.reply(web::http::status_codes::BadRequest, "name is required; quantity, price and reorder_point must not be negative");
+            return;
+        }
+        item.updateTimestamp();
+
+        uint64_t revision = 0;
+        UpdateResult result = inventory_service.updateItemIf(item, conditional ? expected : current->getRevision(), revision);
+        if (result == UpdateResult::Updated) {
+            item.setRevision(revision);
+            std::string json = item.toJsonString();
+            send_body(request, web::http::status_codes::OK, std::vector<unsigned char>(json.begin(), json.end()),
+                      "application/json", make_etag("items/" + std::to_string(id), WireFormat::Json, revision));
+            return;
+        }
+        if (result == UpdateResult::NotFound) {
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        }
+        if (result == UpdateResult::Duplicate) {
+            request.reply(web::http::status_codes::Conflict, "barcode belongs to another item");
+            return;
+        }
+        if (result == UpdateResult::Failed) {
+            request.reply(web::http::status_codes::InternalError);
+            return;
+        }
+        if (conditional || attempt == 3) {
+            auto latest = inventory_service.getItem(id);
+            if (!latest) {
+                request.reply(web::http::status_codes::NotFound);
+                return;
+            }
+            std::string json = latest->toJsonString();
+            send_body(request, web::http::status_codes::Conflict, std::vector<unsigned char>(json.begin(), json.end()),
+                      "application/json", make_etag("items/" + std::to_string(id), WireFormat::Json, latest->getRevision()));
+            return;
+        }
+    }
+}
+
+void ItemsController::handle_delete(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::NotImplemented);
+}
+
+void ItemsController::handle_sales_post(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/{id}/sales with {"quantity": n}
+    int id = parse_id(route.param(0));
+    if (id < 0) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item id");
+        return;
+    }
+    int quantity = 0;
+    try {
+        web::json::value body = request.extract_json().get();
+        if (body.has_field(U("quantity")) && body.at(U("quantity")).is_integer()) {
+            quantity = body.at(U("quantity")).as_integer();
+        }
+    } catch (const std::exception&) {
+        quantity = 0;
+    }
+    if (quantity <= 0) {
+        request.reply(web::http::status_codes::BadRequest, "quantity must be a positive integer");
+        return;
+    }
+    bool item_found = false;
+    if (!sales_service.recordSale(id, quantity, item_found)) {
+        request.reply(item_found ? web::http::status_codes::InternalError : web::http::status_codes::NotFound);
+        return;
+    }
+    request.reply(web::http::status_codes::Created);
+}
+
+void ItemsController::handle_stock_post(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/{id}/stock with {"delta": n} and/or {"reorder_point": n}
+    int id = parse_id(route.param(0));
+    if (id < 0) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid item id");
+        return;
+    }
+    web::json::value body;
+    try {
+        body = request.extract_json().get();
+    } catch (const std::exception&) {
+        body = web::json::value::null();
+    }
+    bool has_delta = body.has_field(U("delta")) && body.at(U("delta")).is_integer();
+    bool has_point = body.has_field(U("reorder_point")) && body.at(U("reorder_point")).is_integer();
+    if (!has_delta && !has_point) {
+        request.reply(web::http::status_codes::BadRequest, "expected integer delta and/or reorder_point");
+        return;
+    }
+    if (!inventory_service.getItem(id)) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+
+    std::shared_ptr<Item> item;
+    if (has_point) item = inventory_service.setReorderPoint(id, body.at(U("reorder_point")).as_integer());
+    if (has_delta) {
+        item = inventory_service.adjustStock(id, body.at(U("delta")).as_integer());
+        if (!item) {
+            request.reply(web::http::status_codes::Conflict, "not enough stock");
+            return;
+        }
+    }
+    if (!item) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+    send_body(request, web::http::status_codes::OK, item->toJsonString(), "application/json");
+}
+
+static JsonValue low_stock_json(const LowStockEntry& entry, const std::shared_ptr<Item>& item) {
+    JsonValue::Object object;
+    object["item_id"] = JsonValue(static_cast<double>(entry.item_id));
+    object["quantity"] = JsonValue(static_cast<double>(entry.quantity));
+    object["reorder_point"] = JsonValue(static_cast<double>(entry.reorder_point));
+    object["shortfall"] = JsonValue(static_cast<double>(entry.reorder_point - entry.quantity));
+    if (item) {
+        object["name"] = JsonValue(item->getName());
+        object["department"] = JsonValue(item->getDepartment());
+    }
+    return JsonValue(object);
+}
+
+void ItemsController::handle_low_stock(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/low-stock?limit=100, largest shortfall first
+    size_t limit = static_cast<size_t>(std::min<long long>(std::max<long long>(route.query.getInt("limit", 100), 1), 10000));
+    JsonValue::Array items;
+    for (const auto& entry : inventory_service.getLowStock(limit)) {
+        items.push_back(low_stock_json(entry, inventory_service.getItem(entry.item_id)));
+    }
+    send_body(request, web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(items)), "application/json");
+}
+
+void ItemsController::handle_low_stock_alerts(web::http::http_request request, const RouteMatch& route) {
+    // /api/items/low-stock/alerts?after=<sequence>: alerts raised since the
+    // last one the caller saw; resume with the returned last_sequence
+    uint64_t after = static_cast<uint64_t>(std::max<long long>(route.query.getInt("after", 0), 0));
+    JsonValue::Array alerts;
+    for (const auto& alert : inventory_service.getLowStockAlerts(after)) {
+        JsonValue::Object object;
+        object["sequence"] = JsonValue(static_cast<double>(alert.sequence));
+        object["time"] = JsonValue(static_cast<double>(alert.time));
+        object["low"] = JsonValue(alert.low);
+        object["item"] = low_stock_json(alert.entry, nullptr);
+        alerts.push_back(JsonValue(object));
+    }
+    JsonValue::Object object;
+    object["last_sequence"] = JsonValue(static_cast<double>(inventory_service.getLastAlertSequence()));
+    object["alerts"] = JsonValue(alerts);
+    send_body(request, web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(object)), "application/json");
+}
+
+// SalesController
+
+void SalesController::handle_get(web::http::http_request request, const RouteMatch& route) {
+    // /api/sales/{id}
+    if (route.param_count > 0) {
+        int id = parse_id(route.param(0));
+        if (id < 0) {
+            request.reply(web::http::status_codes::BadRequest, "Invalid sale id");
+            return;
+        }
+        reply_model(request, sales_service.getSale(id));
+        return;
+    }
+
+    if (route.query.has("start") || route.query.has("end")) {
+        time_t from = static_cast<time_t>(route.query.getInt("start", 0));
+        time_t to = static_cast<time_t>(route.query.getInt("end", time(nullptr)));
+        reply_models(request, sales_service.getSalesByDateRange(from, to));
+        return;
+    }
+    reply_models(request, sales_service.getAllSales());
+}
+
+void SalesController::handle_top(web::http::http_request request, const RouteMatch& route) {
+    // /api/sales/top?window=hour|day&by=units|revenue&n=10&exact=false
+    std::string window_name = route.query.get("window", "day");
+    std::string by = route.query.get("by", "units");
+    if ((window_name != "hour" && window_name != "day") || (by != "units" && by != "revenue")) {
+        request.reply(web::http::status_codes::BadRequest, "window must be hour or day, by units or revenue");
+        return;
+    }
+    TopWindow window = window_name == "hour" ? TopWindow::Hour : TopWindow::Day;
+    bool by_revenue = by == "revenue";
+    size_t n = static_cast<size_t>(std::min<long long>(std::max<long long>(route.query.getInt("n", 10), 1), 100));
+    bool exact = route.query.get("exact") == "true";
+
+    std::vector<TopSeller> sellers = exact ? sales_service.getTopSellersExact(window, by_revenue, n)
+                                           : sales_service.getTopSellers(window, by_revenue, n);
+    JsonValue::Array items;
+    items.reserve(sellers.size());
+    for (const auto& seller : sellers) {
+        JsonValue::Object entry;
+        entry["item_id"] = JsonValue(static_cast<double>(seller.item_id));
+        entry[by] = JsonValue(seller.value);
+        entry["error"] = JsonValue(seller.error);
+        entry["guaranteed"] = JsonValue(seller.guaranteed);
+        items.push_back(JsonValue(entry));
+    }
+    JsonValue::Object object;
+    object["window"] = JsonValue(window_name);
+    object["by"] = JsonValue(by);
+    object["exact"] = JsonValue(exact);
+    object["sales_in_window"] = JsonValue(static_cast<double>(sales_service.getSalesInWindow(window)));
+    object["items"] = JsonValue(items);
+    send_body(request, web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(object)), "application/json");
+}
+
+IdempotentResponse SalesController::record_sale(const std::string& body) {
+    int item_id = 0, quantity = 0;
+    try {
+        web::json::value json = web::json::value::parse(utility::conversions::to_string_t(body));
+        if (json.has_field(U("item_id")) && json.at(U("item_id")).is_integer()) item_id = json.at(U("item_id")).as_integer();
+        if (json.has_field(U("quantity")) && json.at(U("quantity")).is_integer()) quantity = json.at(U("quantity")).as_integer();
+    } catch (const std::exception&) {
+        return IdempotentResponse{web::http::status_codes::BadRequest, "Invalid sale", "text/plain"};
+    }
+    if (item_id <= 0 || quantity <= 0) {
+        return IdempotentResponse{web::http::status_codes::BadRequest, "item_id and quantity must be positive integers",
+                                  "text/plain"};
+    }
+    bool item_found = false;
+    auto sale = sales_service.recordSale(item_id, quantity, item_found);
+    if (!item_found) return IdempotentResponse{web::http::status_codes::NotFound, "item not found", "text/plain"};
+    if (!sale) {
+        // The repository rolled the failed save back, so 500 releases the
+        // Idempotency-Key and a retry records the sale once
+        return IdempotentResponse{web::http::status_codes::InternalError, "sale could not be saved", "text/plain"};
+    }
+    return IdempotentResponse{web::http::status_codes::Created, sale->toJsonString(), "application/json"};
+}
+
+static void reply_idempotent(const web::http::http_request& request, const IdempotentResponse& response, bool replayed) {
+    web::http::http_response reply(static_cast<web::http::status_code>(response.status));
+    if (replayed) reply.headers().add(U("Idempotent-Replayed"), U("true"));
+    reply.set_body(response.body, response.content_type);
+    request.reply(reply);
+}
+
+void SalesController::handle_post(web::http::http_request request, const RouteMatch& route) {
+    // /api/sales with {"item_id": n, "quantity": n}. Terminals that retry
+    // after a timeout send the same Idempotency-Key and get the first
+    // attempt's response back instead of recording the sale twice.
+    std::string body;
+    try {
+        body = request.extract_utf8string(true).get();
+    } catch (const std::exception&) {
+        request.reply(web::http::status_codes::BadRequest, "Invalid sale");
+        return;
+    }
+    std::string key = header_value(request, U("Idempotency-Key"));
+    if (key.empty()) {
+        reply_idempotent(request, record_sale(body), false);
+        return;
+    }
+    if (key.size() > 255) {
+        request.reply(web::http::status_codes::BadRequest, "Idempotency-Key is longer than 255 characters");
+        return;
+    }
+
+    IdempotentResponse response;
+    switch (idempotency->claim(key, std::hash<std::string>()(body), response)) {
+        case IdempotencyCache::Claim::Replay:
+            reply_idempotent(request, response, true);
+            return;
+        case IdempotencyCache::Claim::InProgress: {
+            web::http::http_response busy(web::http::status_codes::Conflict);
+            busy.headers().add(web::http::header_names::retry_after, U("1"));
+            busy.set_body(utility::conversions::to_string_t("a request with this Idempotency-Key is in progress"));
+            request.reply(busy);
+            return;
+        }
+        case IdempotencyCache::Claim::Mismatch:
+            request.reply(web::http::status_codes::UnprocessableEntity,
+                          "Idempotency-Key was already used for a different sale");
+            return;
+        case IdempotencyCache::Claim::Busy: {
+            web::http::http_response busy(web::http::status_codes::ServiceUnavailable);
+            busy.headers().add(web::http::header_names::retry_after, U("1"));
+            busy.set_body(utility::conversions::to_string_t("too many sales with an Idempotency-Key are in progress"));
+            request.reply(busy);
+            return;
+        }
+        case IdempotencyCache::Claim::Claimed:
             break;
+    }
+    try {
+        response = record_sale(body);
+    } catch (...) {
+        idempotency->release(key);
+        throw;
+    }
+    // A failure on our side is not remembered, so the retry gets another go
+    if (response.status >= 500) {
+        idempotency->release(key);
+    } else {
+        idempotency->complete(key, response);
+    }
+    reply_idempotent(request, response, false);
+}
+
+// FinancialController
+
+static JsonValue::Object aggregate_json(const SaleAggregate& aggregate) {
+    JsonValue::Object object;
+    object["revenue"] = JsonValue(aggregate.revenue);
+    object["sale_count"] = JsonValue(static_cast<double>(aggregate.count));
+    object["quantity"] = JsonValue(aggregate.quantity);
+    if (aggregate.count > 0) {
+        object["min_sale"] = JsonValue(aggregate.min);
+        object["max_sale"] = JsonValue(aggregate.max);
+    }
+    return object;
+}
+
+static std::string sale_report_json(const SaleReport& report, time_t from, time_t to,
+                                    const std::string& group_by) {
+    JsonValue::Object object = aggregate_json(report.total);
+    object["start"] = JsonValue(static_cast<double>(from));
+    object["end"] = JsonValue(static_cast<double>(to));
+    if (!group_by.empty() && group_by != "none") {
+        JsonValue::Array groups;
+        groups.reserve(report.groups.size());
+        for (const auto& group : report.groups) {
+            JsonValue::Object entry = aggregate_json(group.second);
+            entry["key"] = JsonValue(group.first);
+            groups.push_back(JsonValue(entry));
+        }
+        object["group_by"] = JsonValue(group_by);
+        object["groups"] = JsonValue(groups);
+    }
+    return JsonBuilder::toJson(JsonValue(object));
+}
+
+void FinancialController::handle_get(web::http::http_request request, const RouteMatch& route) {
+    // /api/financials/report?start=&end=&group_by=item|department|day
+    time_t from = static_cast<time_t>(route.query.getInt("start", 0));
+    time_t to = static_cast<time_t>(route.query.getInt("end", time(nullptr)));
+    std::string group_by = route.query.get("group_by");
+    ReportGrouping grouping;
+    if (!parseReportGrouping(group_by, grouping)) {
+        request.reply(web::http::status_codes::BadRequest, "group_by must be item, department or day");
+        return;
+    }
+
+    // Reports are always JSON; an open-ended range depends on the clock,
+    // so only ranges with an explicit end are cached
+    uint64_t version = financial_service.getReportVersion();
+    if (!route.query.has("end")) {
+        send_body(request, web::http::status_codes::OK,
+                  sale_report_json(financial_service.getSaleReport(from, to, grouping), from, to, group_by),
+                  "application/json");
+        return;
+    }
+
+    // The ETag covers the query too, otherwise two ranges would share one
+    std::string query = utility::conversions::to_utf8string(request.relative_uri().query());
+    std::string resource = "report-" + std::to_string(std::hash<std::string>{}(query));
+    reply_versioned(request, resource, version, [&](WireFormat) {
+        std::string json = sale_report_json(financial_service.getSaleReport(from, to, grouping), from, to, group_by);
+        return SerializedBody{std::vector<unsigned char>(json.begin(), json.end()), "application/json"};
+    });
+}
+
+static JsonValue::Object pnl_period_json(const PnlPeriod& period) {
+    JsonValue::Object object;
+    object["revenue"] = JsonValue(period.sales.revenue);
+    object["sale_count"] = JsonValue(static_cast<double>(period.sales.count));
+    object["income"] = JsonValue(period.income);
+    object["expenses"] = JsonValue(period.expenses);
+    object["net"] = JsonValue(period.net());
+    JsonValue::Array lines;
+    lines.reserve(period.lines.size());
+    for (const auto& line : period.lines) {
+        JsonValue::Object entry;
+        entry["category"] = JsonValue(line.category);
+        entry["kind"] = JsonValue(line.income ? "income" : "expense");
+        entry["amount"] = JsonValue(line.amount);
+        entry["records"] = JsonValue(static_cast<double>(line.records));
+        lines.push_back(JsonValue(entry));
+    }
+    object["categories"] = JsonValue(lines);
+    return object;
+}
+
+static std::string pnl_report_json(const PnlReport& report, time_t from, time_t to, bool by_day) {
+    JsonValue::Object object = pnl_period_json(report.total);
+    object["start"] = JsonValue(static_cast<double>(from));
+    object["end"] = JsonValue(static_cast<double>(to));
+    if (by_day) {
+        JsonValue::Array days;
+        days.reserve(report.days.size());
+        for (const auto& day : report.days) {
+            JsonValue::Object entry = pnl_period_json(day);
+            entry["day"] = JsonValue(utcDayKey(static_cast<time_t>(day.day_start)));
+            days.push_back(JsonValue(entry));
         }
-        path_segments.push_back(relative_path.substr(pos, next_pos - pos));
-        pos = next_pos + 1;
-    }
-    
-    return path_segments;
-}
-
-std::map<std::string, std::string> parse_query_params(const web::http::http_request& request) {
-    // Convert from utility::string_t to std::string
-    auto query = utility::conversions::to_utf8string(
-        web::uri::decode(request.relative_uri().query())
-    );
-    
-    std::map<std::string, std::string> params;
-    
-    std::regex pattern("([^&=]+)=([^&=]*)");
-    auto words_begin = std::sregex_iterator(query.begin(), query.end(), pattern);
-    auto words_end = std::sregex_iterator();
-    
-    for (std::sregex_iterator i = words_begin; i != words_end; ++i) {
-        std::smatch match = *i;
-        params[match[1].str()] = match[2].str();
-    }
-    
-    return params;
+        object["days"] = JsonValue(days);
+    }
+    return JsonBuilder::toJson(JsonValue(object));
+}
+
+void FinancialController::handle_pnl(web::http::http_request request, const RouteMatch& route) {
+    // /api/financials/pnl?start=&end=&by=day|total
+    time_t from = static_cast<time_t>(route.query.getInt("start", 0));
+    time_t to = static_cast<time_t>(route.query.getInt("end", time(nullptr)));
+    std::string by = route.query.get("by", "day");
+    if (by != "day" && by != "total") {
+        request.reply(web::http::status_codes::BadRequest, "by must be day or total");
+        return;
+    }
+    bool by_day = by == "day";
+
+    if (!route.query.has("end")) {
+        send_body(request, web::http::status_codes::OK,
+                  pnl_report_json(financial_service.getProfitAndLoss(from, to, by_day), from, to, by_day),
+                  "application/json");
+        return;
+    }
+
+    std::string query = utility::conversions::to_utf8string(request.relative_uri().query());
+    std::string resource = "pnl-" + std::to_string(std::hash<std::string>{}(query));
+    reply_versioned(request, resource, financial_service.getReportVersion(), [&](WireFormat) {
+        std::string json = pnl_report_json(financial_service.getProfitAndLoss(from, to, by_day), from, to, by_day);
+        return SerializedBody{std::vector<unsigned char>(json.begin(), json.end()), "application/json"};
+    });
+}
+
+void FinancialController::handle_analytics(web::http::http_request request, const RouteMatch& route) {
+    // /api/financials/analytics?start=&end=&department=
+    time_t from = static_cast<time_t>(route.query.getInt("start", 0));
+    time_t to = static_cast<time_t>(route.query.getInt("end", time(nullptr)));
+    std::vector<SalesAnalytics> rows = financial_service.getSalesAnalytics(from, to, route.query.get("department"));
+
+    auto row_json = [](const SalesAnalytics& row) {
+        JsonValue::Object object;
+        object["sales"] = JsonValue(static_cast<double>(row.sales));
+        object["revenue"] = JsonValue(row.revenue);
+        object["distinct_items"] = JsonValue(row.distinct_items);
+        object["median_basket"] = JsonValue(row.median_basket);
+        object["p90_basket"] = JsonValue(row.p90_basket);
+        object["p99_basket"] = JsonValue(row.p99_basket);
+        return object;
+    };
+    JsonValue::Array departments;
+    for (size_t i = 0; i + 1 < rows.size(); ++i) {
+        JsonValue::Object entry = row_json(rows[i]);
+        entry["department"] = JsonValue(rows[i].department);
+        departments.push_back(JsonValue(entry));
+    }
+    JsonValue::Object object = row_json(rows.back());
+    object["start"] = JsonValue(static_cast<double>(from));
+    object["end"] = JsonValue(static_cast<double>(to));
+    object["approximate"] = JsonValue(true);
+    object["departments"] = JsonValue(departments);
+    send_body(request, web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(object)), "application/json");
+}
+
+void FinancialController::handle_post(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::NotImplemented);
+}
+
+// PromotionsController
+
+void PromotionsController::handle_get(web::http::http_request request, const RouteMatch& route) {
+    uint64_t version = promotion_service.getPromotionsVersion();
+
+    // /api/promotions/{id}
+    if (route.param_count > 0) {
+        int id = parse_id(route.param(0));
+        if (id < 0) {
+            request.reply(web::http::status_codes::BadRequest, "Invalid promotion id");
+            return;
+        }
+        auto promo = promotion_service.getPromotion(id);
+        if (!promo) {
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        }
+        reply_versioned(request, "promotions", version, [&promo](WireFormat format) {
+            return serialize_model(format, *promo);
+        });
+        return;
+    }
+
+    // Whether a promotion is active depends on the clock, not just the data
+    if (route.query.raw("active") == "true") {
+        reply_models(request, promotion_service.getActivePromotions());
+        return;
+    }
+    reply_versioned(request, "promotions", version, [this](WireFormat format) {
+        return serialize_models(format, promotion_service.getAllPromotions());
+    });
+}
+
+void PromotionsController::handle_post(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::NotImplemented);
+}
+
+void PromotionsController::handle_put(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::NotImplemented);
+}
+
+void PromotionsController::handle_delete(web::http::http_request request, const RouteMatch& route) {
+    request.reply(web::http::status_codes::NotImplemented);
+}
+
+// ApiListener
+
+// A request waiting in a worker pool. The RouteMatch views point into
+// `target`, so this is allocated once and never moved.
+struct PendingRequest {
+    web::http::http_request request;
+    web::uri target;
+    std::string path_storage;
+    std::string query_storage;
+    RouteMatch route;
+    std::chrono::steady_clock::time_point queued_at;
+};
+
+static ServerConfig config_for_uri(const std::string& base_uri) {
+    ServerConfig config;
+    config.base_uri = base_uri;
+    return config;
+}
+
+ApiListener::ApiListener(const ServerConfig& server_config)
+    : ApiListener(server_config, getInventoryService(), getSalesService(),
+                  getFinancialService(), getPromotionService(), &getStoreRegistry()) {}
+
+ApiListener::ApiListener(const std::string& base_uri)
+    : ApiListener(config_for_uri(base_uri)) {}
+
+ApiListener::ApiListener(
+    const ServerConfig& server_config,
+    InventoryService& inv_service,
+    SalesService& sales_service,
+    FinancialService& fin_service,
+    PromotionService& promo_service,
+    StoreRegistry* stores)
+    : config(server_config),
+      listener(utility::conversions::to_string_t(server_config.base_uri)),
+      inventory_service(inv_service),
+      sales_service(sales_service),
+      financial_service(fin_service),
+      promotion_service(promo_service),
+      store_registry(stores) {
+    initialize_controllers();
+    initialize_routes();
+    load_static_assets(config.web_root);
+    ApiController::set_compression_threshold(config.compression_threshold);
+
+    fast_pool = std::make_unique<WorkerPool>("fast", config.fast_workers, config.max_queue_depth);
+    report_pool = std::make_unique<WorkerPool>("reports", config.report_workers, config.max_queue_depth);
+    financial_service.setReportThreads(config.report_threads);
+    if (store_registry) {
+        for (const StoreServices& store : store_registry->all()) {
+            if (&store.financial != &financial_service) store.financial.shareReportThreads(financial_service);
+        }
+    }
+
+    EventStreamLimits stream_limits;
+    stream_limits.max_streams = config.max_event_streams;
+    event_hub = std::make_unique<EventStreamHub>(changeFeed(), stream_limits);
+
+    listener.support([this](web::http::http_request request) { handle_request(request); });
+}
+
+static void make_controllers(StoreControllers& controllers, InventoryService& inventory,
+                             SalesService& sales, FinancialService& financial, PromotionService& promotions,
+                             std::shared_ptr<IdempotencyCache> idempotency) {
+    controllers.items = std::make_unique<ItemsController>(inventory, sales);
+    controllers.sales = std::make_unique<SalesController>(sales, std::move(idempotency));
+    controllers.financial = std::make_unique<FinancialController>(financial);
+    controllers.promotions = std::make_unique<PromotionsController>(promotions);
+}
+
+void ApiListener::initialize_controllers() {
+    IdempotencyLimits limits;
+    limits.max_keys = config.idempotency_keys;
+    limits.ttl = std::chrono::seconds(config.idempotency_ttl_s);
+    auto default_keys = std::make_shared<IdempotencyCache>(limits);
+    make_controllers(controllers, inventory_service, sales_service, financial_service, promotion_service, default_keys);
+    if (!store_registry) return;
+    for (const StoreServices& store : store_registry->all()) {
+        auto entry = std::make_unique<StoreControllers>();
+        auto keys = store.id == StoreRegistry::kDefaultStore ? default_keys : std::make_shared<IdempotencyCache>(limits);
+        make_controllers(*entry, store.inventory, store.sales, store.financial, store.promotions, keys);
+        store_controllers.emplace(store.id, std::move(entry));
+    }
+}
+
+void ApiListener::initialize_routes() {
+    // Store resources are routed twice: /api/<path> for the default store
+    // and /api/stores/{store}/<path> for any store, with the store dropped
+    // from the parameters, so the controller sees the same route either way
+    auto scoped = [this](HttpMethod method, const std::string& path, auto controller, auto handler,
+                         WorkClass work = WorkClass::Fast) {
+        RouteEntry entry;
+        entry.handler = [this, controller, handler](web::http::http_request request, const RouteMatch& route) {
+            ((controllers.*controller).get()->*handler)(request, route);
+        };
+        entry.work = work;
+        routes.add(method, "/api/" + path, entry);
+
+        RouteEntry store_entry;
+        store_entry.handler = [this, controller, handler](web::http::http_request request, const RouteMatch& route) {
+            auto found = store_controllers.find(route.param(0));
+            if (found == store_controllers.end()) {
+                request.reply(web::http::status_codes::NotFound, "Unknown store");
+                return;
+            }
+            RouteMatch inner = route;
+            for (size_t i = 1; i < route.param_count; ++i) inner.params[i - 1] = route.params[i];
+            inner.param_count = route.param_count - 1;
+            (((*found->second).*controller).get()->*handler)(request, inner);
+        };
+        store_entry.work = work;
+        routes.add(method, "/api/stores/{store}/" + path, store_entry);
+    };
+
+    using C = StoreControllers;
+    scoped(HttpMethod::Get, "items", &C::items, &ItemsController::handle_get);
+    scoped(HttpMethod::Post, "items", &C::items, &ItemsController::handle_post);
+    scoped(HttpMethod::Get, "items/{id}", &C::items, &ItemsController::handle_get);
+    scoped(HttpMethod::Put, "items/{id}", &C::items, &ItemsController::handle_put);
+    scoped(HttpMethod::Delete, "items/{id}", &C::items, &ItemsController::handle_delete);
+    scoped(HttpMethod::Post, "items/{id}/sales", &C::items, &ItemsController::handle_sales_post);
+    scoped(HttpMethod::Post, "items/{id}/stock", &C::items, &ItemsController::handle_stock_post);
+    scoped(HttpMethod::Get, "items/search", &C::items, &ItemsController::handle_search);
+    scoped(HttpMethod::Get, "items/barcode/{code}", &C::items, &ItemsController::handle_barcode);
+    scoped(HttpMethod::Get, "items/low-stock", &C::items, &ItemsController::handle_low_stock);
+    scoped(HttpMethod::Get, "items/low-stock/alerts", &C::items, &ItemsController::handle_low_stock_alerts);
+
+    scoped(HttpMethod::Get, "sales", &C::sales, &SalesController::handle_get);
+    scoped(HttpMethod::Post, "sales", &C::sales, &SalesController::handle_post);
+    scoped(HttpMethod::Get, "sales/{id}", &C::sales, &SalesController::handle_get);
+    scoped(HttpMethod::Get, "sales/top", &C::sales, &SalesController::handle_top);
+
+    scoped(HttpMethod::Get, "financials/report", &C::financial, &FinancialController::handle_get, WorkClass::Report);
+    scoped(HttpMethod::Post, "financials", &C::financial, &FinancialController::handle_post);
+    scoped(HttpMethod::Get, "financials/pnl", &C::financial, &FinancialController::handle_pnl, WorkClass::Report);
+    scoped(HttpMethod::Get, "financials/analytics", &C::financial, &FinancialController::handle_analytics,
+           WorkClass::Report);
+
+    scoped(HttpMethod::Get, "promotions", &C::promotions, &PromotionsController::handle_get);
+    scoped(HttpMethod::Post, "promotions", &C::promotions, &PromotionsController::handle_post);
+    scoped(HttpMethod::Get, "promotions/{id}", &C::promotions, &PromotionsController::handle_get);
+    scoped(HttpMethod::Put, "promotions/{id}", &C::promotions, &PromotionsController::handle_put);
+    scoped(HttpMethod::Delete, "promotions/{id}", &C::promotions, &PromotionsController::handle_delete);
+
+    RouteEntry stores;
+    stores.handler = [this](web::http::http_request request, const RouteMatch&) { handle_stores(request); };
+    routes.add(HttpMethod::Get, "/api/stores", stores);
+    RouteEntry stores_pnl;
+    stores_pnl.handler = [this](web::http::http_request request, const RouteMatch& route) {
+        handle_stores_pnl(request, route);
+    };
+    stores_pnl.work = WorkClass::Report;
+    routes.add(HttpMethod::Get, "/api/financials/pnl/stores", stores_pnl);
+
+    RouteEntry events;
+    events.handler = [this](web::http::http_request request, const RouteMatch& route) {
+        handle_events(request, route);
+    };
+    routes.add(HttpMethod::Get, "/api/events", events);
+
+    RouteEntry metrics;
+    metrics.handler = [this](web::http::http_request request, const RouteMatch&) { handle_metrics(request); };
+    metrics.work = WorkClass::Inline;
+    routes.add(HttpMethod::Get, "/api/metrics", metrics);
+}
+
+size_t ApiListener::load_static_assets(const std::string& web_root) {
+    size_t count = static_assets.load(web_root);
+    if (count == 0) {
+        std::cerr << "No web assets found under " << web_root << std::endl;
+    }
+    return count;
+}
+
+void ApiListener::serve_static(web::http::http_request request) {
+    auto path = utility::conversions::to_utf8string(web::uri::decode(request.relative_uri().path()));
+    const StaticAsset* asset = static_assets.find(path);
+    if (!asset) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+
+    ContentEncoding encoding = negotiateContentEncoding(
+        header_value(request, web::http::header_names::accept_encoding));
+    const std::vector<unsigned char>& body = StaticAssetCache::body(*asset, encoding);
+    std::string etag = StaticAssetCache::etagFor(*asset, encoding);
+
+    web::http::http_response response(web::http::status_codes::OK);
+    response.headers().add(web::http::header_names::etag, utility::conversions::to_string_t(etag));
+    response.headers().add(web::http::header_names::cache_control, U("no-cache"));
+    response.headers().add(web::http::header_names::vary, U("Accept-Encoding"));
+
+    if (etag_matches(header_value(request, web::http::header_names::if_none_match), etag)) {
+        response.set_status_code(web::http::status_codes::NotModified);
+        request.reply(response);
+        return;
+    }
+
+    if (encoding != ContentEncoding::Identity) {
+        response.headers().add(web::http::header_names::content_encoding,
+                               utility::conversions::to_string_t(encodingName(encoding)));
+    }
+    response.set_body(body);
+    response.headers().set_content_type(utility::conversions::to_string_t(asset->content_type));
+    request.reply(response);
+}
+
+static void invoke_route(const std::function<void(web::http::http_request, const RouteMatch&)>& handler,
+                         const web::http::http_request& request, const RouteMatch& route) {
+    try {
+        handler(request, route);
+    } catch (const std::exception& e) {
+        std::cerr << "Error handling request: " << e.what() << std::endl;
+        request.reply(web::http::status_codes::InternalError);
+    }
+}
+
+void ApiListener::handle_request(web::http::http_request request) {
+    auto pending = std::make_shared<PendingRequest>();
+    pending->request = request;
+    pending->target = request.relative_uri();
+    pending->route.path = PathSegments(utf8_view(pending->target.path(), pending->path_storage));
+    pending->route.query = QueryParams(utf8_view(pending->target.query(), pending->query_storage));
+    const RouteMatch& route = pending->route;
+
+    // Static files come from memory and never queue
+    if (route.path.empty() || route.path[0] != "api") {
+        if (request.method() == web::http::methods::GET) serve_static(request);
+        else request.reply(web::http::status_codes::MethodNotAllowed);
+        return;
+    }
+
+    // A replica's data comes from its primary only
+    if (request.method() != web::http::methods::GET && getReplication().isReplica()) {
+        request.reply(web::http::status_codes::Forbidden, "read-only replica");
+        return;
+    }
+
+    const RouteEntry* entry = nullptr;
+    switch (routes.match(route_method(request.method()), pending->route, entry)) {
+        case RouteResult::NotFound:
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        case RouteResult::MethodNotAllowed:
+            request.reply(web::http::status_codes::MethodNotAllowed);
+            return;
+        case RouteResult::Matched:
+            break;
+    }
+
+    if (entry->work == WorkClass::Inline) {
+        invoke_route(entry->handler, request, route);
+        return;
+    }
+
+    WorkerPool& pool = entry->work == WorkClass::Report ? *report_pool : *fast_pool;
+    pending->queued_at = std::chrono::steady_clock::now();
+    bool admitted = pool.tryPost([this, entry, pending] {
+        // A request that sat in the queue past its budget is likely already
+        // abandoned by the client; shed it rather than add to the backlog
+        auto waited = std::chrono::steady_clock::now() - pending->queued_at;
+        if (config.max_queue_wait_ms > 0 &&
+            waited > std::chrono::milliseconds(config.max_queue_wait_ms)) {
+            ++expired_in_queue;
+            reply_overloaded(pending->request);
+            return;
+        }
+        invoke_route(entry->handler, pending->request, pending->route);
+    });
+    if (!admitted) {
+        reply_overloaded(request);
+    }
+}
+
+void ApiListener::reply_overloaded(const web::http::http_request& request) {
+    web::http::http_response response(web::http::status_codes::ServiceUnavailable);
+    response.headers().add(web::http::header_names::retry_after,
+                           utility::conversions::to_string_t(std::to_string(config.retry_after_seconds)));
+    response.set_body(utility::conversions::to_string_t("Server busy, retry later"));
+    request.reply(response);
+}
+
+static JsonValue pool_stats_json(const WorkerPoolStats& stats) {
+    JsonValue::Object pool;
+    pool["threads"] = JsonValue(static_cast<double>(stats.threads));
+    pool["queue_depth"] = JsonValue(static_cast<double>(stats.queue_depth));
+    pool["peak_queue_depth"] = JsonValue(static_cast<double>(stats.peak_queue_depth));
+    pool["max_queue_depth"] = JsonValue(static_cast<double>(stats.max_queue_depth));
+    pool["active"] = JsonValue(static_cast<double>(stats.active));
+    pool["accepted"] = JsonValue(static_cast<double>(stats.accepted));
+    pool["rejected"] = JsonValue(static_cast<double>(stats.rejected));
+    pool["completed"] = JsonValue(static_cast<double>(stats.completed));
+    return JsonValue(pool);
+}
+
+static JsonValue persistence_stats_json(const PersistenceStats& stats) {
+    JsonValue::Object store;
+    store["flushes"] = JsonValue(static_cast<double>(stats.flushes));
+    store["failures"] = JsonValue(static_cast<double>(stats.failures));
+    store["coalesced"] = JsonValue(static_cast<double>(stats.coalesced));
+    store["last_flush_ms"] = JsonValue(stats.last_flush_us / 1000.0);
+    store["max_flush_ms"] = JsonValue(stats.max_flush_us / 1000.0);
+    store["avg_flush_ms"] = JsonValue(stats.flushes > 0 ? stats.total_flush_us / 1000.0 / stats.flushes : 0.0);
+    store["pending"] = JsonValue(static_cast<double>(stats.pending));
+    store["durability"] = JsonValue(stats.durability);
+    return JsonValue(store);
+}
+
+static JsonValue live_columns_json(const LiveColumnsStats& stats) {
+    JsonValue::Object columns;
+    columns["rows"] = JsonValue(static_cast<double>(stats.rows));
+    columns["tail_rows"] = JsonValue(static_cast<double>(stats.tail_rows));
+    columns["bytes"] = JsonValue(static_cast<double>(stats.bytes));
+    columns["rebuilds"] = JsonValue(static_cast<double>(stats.rebuilds));
+    columns["drop_passes"] = JsonValue(static_cast<double>(stats.drop_passes));
+    return JsonValue(columns);
+}
+
+void ApiListener::handle_metrics(web::http::http_request request) {
+    JsonValue::Object pools;
+    pools["fast"] = pool_stats_json(fast_pool->stats());
+    pools["reports"] = pool_stats_json(report_pool->stats());
+    WorkerPoolStats slice_stats;
+    if (financial_service.getReportPoolStats(slice_stats)) {
+        pools["report_slices"] = pool_stats_json(slice_stats);
+    }
+
+    ResponseCache& cache = ApiController::response_cache();
+    JsonValue::Object response_cache;
+    response_cache["hits"] = JsonValue(static_cast<double>(cache.getHits()));
+    response_cache["misses"] = JsonValue(static_cast<double>(cache.getMisses()));
+    response_cache["entries"] = JsonValue(static_cast<double>(cache.size()));
+
+    JsonObject metrics;
+    metrics.set("pools", pools);
+    metrics.set("expired_in_queue", static_cast<double>(expired_in_queue.load()));
+    metrics.set("response_cache", response_cache);
+
+    JsonValue::Object persistence;
+    for (const auto& entry : persistenceRegistry().collect()) {
+        persistence[entry.first] = persistence_stats_json(entry.second);
+    }
+    metrics.set("persistence", persistence);
+
+    ResidencyStats residency = sales_service.getSalesResidency();
+    if (residency.bounded || residency.partitions > 0) {
+        JsonValue::Object sales_cache;
+        uint64_t lookups = residency.hits + residency.misses;
+        sales_cache["budget_bytes"] = JsonValue(static_cast<double>(residency.budget_bytes));
+        sales_cache["resident_bytes"] = JsonValue(static_cast<double>(residency.resident_bytes));
+        sales_cache["resident_records"] = JsonValue(static_cast<double>(residency.resident_records));
+        sales_cache["report_columns_bytes"] = JsonValue(static_cast<double>(residency.derived_bytes));
+        sales_cache["resident_partitions"] = JsonValue(static_cast<double>(residency.resident_partitions));
+        sales_cache["partitions"] = JsonValue(static_cast<double>(residency.partitions));
+        sales_cache["hits"] = JsonValue(static_cast<double>(residency.hits));
+        sales_cache["misses"] = JsonValue(static_cast<double>(residency.misses));
+        sales_cache["hit_rate"] = JsonValue(lookups > 0 ? static_cast<double>(residency.hits) / lookups : 0.0);
+        sales_cache["evictions"] = JsonValue(static_cast<double>(residency.evictions));
+        metrics.set("sales_cache", sales_cache);
+    }
+    {
+        JsonValue::Object section;
+        section["sales"] = live_columns_json(financial_service.getSaleColumnStats());
+        section["financial_records"] = live_columns_json(financial_service.getRecordColumnStats());
+        metrics.set("report_columns", section);
+    }
+    {
+        RetentionStats retention = getRetentionJob().getStats();
+        JsonValue::Object section;
+        section["runs"] = JsonValue(static_cast<double>(retention.runs));
+        section["last_run"] = JsonValue(static_cast<double>(retention.last_run));
+        section["sales_archived"] = JsonValue(static_cast<double>(retention.sales_archived));
+        section["sales_removed"] = JsonValue(static_cast<double>(retention.sales_removed));
+        section["financial_archived"] = JsonValue(static_cast<double>(retention.financial_archived));
+        section["financial_removed"] = JsonValue(static_cast<double>(retention.financial_removed));
+        section["failures"] = JsonValue(static_cast<double>(retention.failures));
+        metrics.set("retention", section);
+    }
+    {
+        EventStreamStats streams = event_hub->stats();
+        JsonValue::Object section;
+        section["open"] = JsonValue(static_cast<double>(streams.open));
+        section["max_streams"] = JsonValue(static_cast<double>(streams.max_streams));
+        section["opened"] = JsonValue(static_cast<double>(streams.opened));
+        section["rejected"] = JsonValue(static_cast<double>(streams.rejected));
+        section["dropped"] = JsonValue(static_cast<double>(streams.dropped));
+        section["events_sent"] = JsonValue(static_cast<double>(streams.events_sent));
+        section["last_sequence"] = JsonValue(static_cast<double>(streams.last_sequence));
+        metrics.set("event_streams", section);
+    }
+    {
+        // Summed over the stores; each store remembers its own keys
+        IdempotencyStats idempotency = controllers.sales->idempotency_stats();
+        for (const auto& store : store_controllers) {
+            if (store.first == StoreRegistry::kDefaultStore) continue;
+            IdempotencyStats other = store.second->sales->idempotency_stats();
+            idempotency.keys += other.keys;
+            idempotency.replayed += other.replayed;
+            idempotency.in_progress += other.in_progress;
+            idempotency.mismatched += other.mismatched;
+            idempotency.evicted += other.evicted;
+            idempotency.refused += other.refused;
+        }
+        JsonValue::Object section;
+        section["keys"] = JsonValue(static_cast<double>(idempotency.keys));
+        section["replayed"] = JsonValue(static_cast<double>(idempotency.replayed));
+        section["in_progress"] = JsonValue(static_cast<double>(idempotency.in_progress));
+        section["mismatched"] = JsonValue(static_cast<double>(idempotency.mismatched));
+        section["evicted"] = JsonValue(static_cast<double>(idempotency.evicted));
+        section["refused"] = JsonValue(static_cast<double>(idempotency.refused));
+        metrics.set("idempotency", section);
+    }
+    {
+        ReplicationStats replication = getReplication().stats();
+        JsonValue::Object section;
+        section["role"] = JsonValue(replication.role);
+        if (replication.role == "primary") {
+            JsonValue::Array replicas;
+            for (const ReplicaLinkStats& link : replication.replicas) {
+                JsonValue::Object replica;
+                replica["peer"] = JsonValue(link.peer);
+                replica["sent_sequence"] = JsonValue(static_cast<double>(link.sent_sequence));
+                replica["acked_sequence"] = JsonValue(static_cast<double>(link.acked_sequence));
+                replica["lag_events"] = JsonValue(static_cast<double>(link.lag_events));
+                replica["connected_at"] = JsonValue(static_cast<double>(link.connected_at));
+                replica["snapshot"] = JsonValue(link.snapshot);
+                replicas.push_back(JsonValue(replica));
+            }
+            section["listen"] = JsonValue(replication.endpoint);
+            section["last_sequence"] = JsonValue(static_cast<double>(replication.last_sequence));
+            section["snapshots_served"] = JsonValue(static_cast<double>(replication.snapshots_served));
+            section["replicas"] = JsonValue(replicas);
+        } else if (replication.role == "replica") {
+            section["primary"] = JsonValue(replication.endpoint);
+            section["connected"] = JsonValue(replication.connected);
+            section["applied_sequence"] = JsonValue(static_cast<double>(replication.applied_sequence));
+            section["primary_sequence"] = JsonValue(static_cast<double>(replication.primary_sequence));
+            section["lag_events"] = JsonValue(static_cast<double>(replication.lag_events));
+            section["lag_seconds"] = JsonValue(replication.lag_seconds);
+            section["events_applied"] = JsonValue(static_cast<double>(replication.events_applied));
+            section["snapshots_loaded"] = JsonValue(static_cast<double>(replication.snapshots_loaded));
+            section["reconnects"] = JsonValue(static_cast<double>(replication.reconnects));
+            section["skipped"] = JsonValue(static_cast<double>(replication.skipped));
+            section["last_error"] = JsonValue(replication.last_error);
+        }
+        metrics.set("replication", section);
+    }
+    request.reply(web::http::status_codes::OK, metrics.toString(), "application/json");
+}
+
+void ApiListener::handle_stores(web::http::http_request request) {
+    JsonValue::Array ids;
+    for (const auto& entry : store_controllers) ids.push_back(JsonValue(entry.first));
+    if (ids.empty()) ids.push_back(JsonValue(StoreRegistry::kDefaultStore));
+    JsonValue::Object object;
+    object["stores"] = JsonValue(ids);
+    request.reply(web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(object)), "application/json");
+}
+
+void ApiListener::handle_stores_pnl(web::http::http_request request, const RouteMatch& route) {
+    // /api/financials/pnl/stores?start=&end= - totals per store and overall
+    time_t from = static_cast<time_t>(route.query.getInt("start", 0));
+    time_t to = static_cast<time_t>(route.query.getInt("end", time(nullptr)));
+    std::vector<StoreProfitAndLoss> stores;
+    if (store_registry) {
+        stores = store_registry->profitAndLoss(from, to);
+    } else {
+        stores.push_back(StoreProfitAndLoss{StoreRegistry::kDefaultStore,
+                                            financial_service.getProfitAndLoss(from, to, false).total});
+    }
+
+    PnlPeriod total;
+    std::map<std::pair<std::string, bool>, PnlLine> lines;
+    JsonValue::Array per_store;
+    for (const auto& store : stores) {
+        total.sales.merge(store.total.sales);
+        total.income += store.total.income;
+        total.expenses += store.total.expenses;
+        for (const auto& line : store.total.lines) {
+            PnlLine& merged = lines[{line.category, line.income}];
+            merged.category = line.category;
+            merged.income = line.income;
+            merged.amount += line.amount;
+            merged.records += line.records;
+        }
+        JsonValue::Object entry = pnl_period_json(store.total);
+        entry["store"] = JsonValue(store.store);
+        per_store.push_back(JsonValue(entry));
+    }
+    for (auto& line : lines) total.lines.push_back(line.second);
+
+    JsonValue::Object object;
+    object["start"] = JsonValue(static_cast<double>(from));
+    object["end"] = JsonValue(static_cast<double>(to));
+    object["stores"] = JsonValue(per_store);
+    object["total"] = JsonValue(pnl_period_json(total));
+    request.reply(web::http::status_codes::OK, JsonBuilder::toJson(JsonValue(object)), "application/json");
+}
+
+void ApiListener::handle_events(web::http::http_request request, const RouteMatch& route) {
+    // /api/events?resources=sales,items&after=<sequence>. EventSource sends
+    // Last-Event-ID on reconnect, which takes precedence over `after`.
+    std::string last_event_id = header_value(request, U("Last-Event-ID"));
+    bool resume = !last_event_id.empty() || route.query.has("after");
+    uint64_t after = std::strtoull(last_event_id.empty() ? route.query.get("after", "0").c_str()
+                                                         : last_event_id.c_str(), nullptr, 10);
+
+    auto buffer = std::make_shared<Concurrency::streams::producer_consumer_buffer<uint8_t>>();
+    EventStreamHub::Stream stream;
+    std::string resources = route.query.get("resources");
+    for (size_t pos = 0; pos < resources.size();) {
+        size_t comma = resources.find(',', pos);
+        if (comma == std::string::npos) comma = resources.size();
+        if (comma > pos) stream.resources.insert(resources.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    stream.write = [buffer](const std::string& frame) {
+        if (!buffer->can_write()) return false;
+        buffer->putn_nocopy(reinterpret_cast<const uint8_t*>(frame.data()), frame.size()).wait();
+        buffer->sync().wait();
+        return true;
+    };
+    stream.backlog = [buffer]() { return buffer->in_avail(); };
+    stream.close = [buffer]() { buffer->close(std::ios_base::out).wait(); };
+
+    if (!event_hub->subscribe(std::move(stream), resume, after)) {
+        reply_overloaded(request);
+        return;
+    }
+    web::http::http_response response(web::http::status_codes::OK);
+    response.headers().set_content_type(U("text/event-stream"));
+    response.headers().add(web::http::header_names::cache_control, U("no-cache"));
+    response.set_body(buffer->create_istream());
+    request.reply(response);
+}
+
+void ApiListener::open() {
+    listener.open().wait();
+    event_hub->start();
+}
+
+void ApiListener::close() {
+    // Streams never finish on their own, so end them before the listener
+    event_hub->stop();
+    listener.close().wait();
+    fast_pool->shutdown();
+    report_pool->shutdown();
 }
 
 } // namespace dsms
\ No newline at end of file
@@ -1,166 +1,129 @@
-#pragma once
-
-#include <fstream>
+// main.cpp - DSMS server entry point
 #include <iostream>
 #include <string>
 #include <vector>
-#include <memory>
-#include <map>
-#include <algorithm>
-#include <filesystem>
-#include <mutex>
-#include <functional>
-#include <ctime>
-#include <nlohmann/json.hpp>
-#include "json_util.h"
-#include "models.h"
-
-namespace fs = std::filesystem;
-
-namespace dsms {
-
-template<typename T>
-class Repository {
-public:
-    virtual ~Repository() = default;
-    virtual std::shared_ptr<T> findById(int id) = 0;
-    virtual std::vector<std::shared_ptr<T>> findAll() = 0;
-    virtual bool save(const T& item) = 0;
-    virtual bool update(const T& item) = 0;
-    virtual bool remove(int id) = 0;
-};
-
-template<typename T>
-class JsonRepository : public Repository<T> {
-private:
-    std::string filename;
-    std::map<int, std::shared_ptr<T>> cache;
-    int next_id;
-    std::mutex mutex_;
-
-    void loadCache() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        cache.clear();
-        next_id = 1;
-        
-        if (!fs::exists(filename)) {
-            fs::path dir = fs::path(filename).parent_path();
-            if (!dir.empty() && !fs::exists(dir)) {
-                fs::create_directories(dir);
-            }
-            std::ofstream file(filename);
-            file << "[]";
-            return;
-        }
-        
-        try {
-            std::ifstream file(filename);
-            nlohmann::json jsonData;
-            file >> jsonData;  // Parse the file into a json object
-            
-            // Process the data here
-            for (const auto& itemData : jsonData) {
-                Item item = itemData.get<Item>();  // Assuming you have a from_json function
-                cache[item.getId()] = std::make_shared<Item>(item);
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error loading data: " << e.what() << std::endl;
-        }
+#include <chrono>
+#include "api.h"
+#include "server_config.h"
+#include "replication.h"
+
+#ifndef _WIN32
+#include <pplx/threadpool.h>
+#endif
+
+int main(int argc, char* argv[]) {
+    dsms::ServerConfig config = dsms::ServerConfig::fromArgs(argc, argv);
+
+#ifndef _WIN32
+    // Must happen before the first cpprest call; on Windows the listener
+    // runs on the OS thread pool instead
+    if (config.io_threads > 0) {
+        crossplat::threadpool::initialize_with_threads(config.io_threads);
     }
-    
-    void saveCache() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        try {
-            nlohmann::json jsonData;
-            for (const auto& pair : cache) {
-                // Serialize the Item object into JSON
-                jsonData.push_back(pair.second);
-            }
-
-            std::ofstream file(filename);
-            file << jsonData.dump(4); // Pretty print the JSON with an indentation of 4 spaces
-        } catch (const std::exception& e) {
-            std::cerr << "Error saving data: " << e.what() << std::endl;
-        }
+#endif
+
+    // Repositories are created lazily by the first service lookup, which
+    // happens in the ApiListener constructor
+    dsms::StorageConfig& storage = dsms::storageConfig();
+    if (config.storage == "sqlite") {
+        storage.backend = dsms::StorageBackend::Sqlite;
+    } else if (config.storage != "json") {
+        std::cerr << "Unknown storage backend '" << config.storage << "', using json" << std::endl;
     }
-
-public:
-    JsonRepository(const std::string& file) : filename(file), next_id(1) {
-        fs::path dir = fs::path(filename).parent_path();
-        if (!dir.empty() && !fs::exists(dir)) {
-            fs::create_directories(dir);
-        }
-        loadCache();
+    storage.data_dir = config.data_dir;
+    storage.snapshots = config.snapshots;
+    storage.async_flush_delay = std::chrono::milliseconds(config.async_flush_ms);
+    if (!dsms::parseDurabilityMode(config.durability, storage.durability)) {
+        std::cerr << "Unknown durability mode '" << config.durability << "', using sync" << std::endl;
     }
-
-    std::shared_ptr<T> findById(int id) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = cache.find(id);
-        return (it != cache.end()) ? it->second : nullptr;
+    if (config.sale_partitions == "day" || config.sale_partitions == "month") {
+        storage.partition_sales = true;
+        storage.sale_granularity = config.sale_partitions == "day" ? dsms::PartitionGranularity::Day
+                                                                    : dsms::PartitionGranularity::Month;
+    } else if (config.sale_partitions != "off") {
+        std::cerr << "Unknown sale partitioning '" << config.sale_partitions << "', using off" << std::endl;
     }
-
-    std::vector<std::shared_ptr<T>> findAll() override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::vector<std::shared_ptr<T>> result;
-        for (const auto& pair : cache) {
-            result.push_back(pair.second);
-        }
-        return result;
+    storage.change_feed_capacity = config.change_feed_size;
+    storage.sale_freeze_after_days = config.sale_freeze_days;
+    storage.sale_memory_budget = config.sale_memory_mb * 1024 * 1024;
+    if (config.sale_memory_mb > 0 && !storage.partition_sales) {
+        std::cerr << "--sale-memory-mb needs --sale-partitions; sales stay fully resident" << std::endl;
     }
-
-    bool save(const T& item) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        T mutable_item = item;
-        if (mutable_item.getId() <= 0) {
-            mutable_item.setId(next_id++);
+    for (const auto& entry : config.durability_overrides) {
+        dsms::DurabilityMode mode;
+        if (dsms::parseDurabilityMode(entry.second, mode)) {
+            storage.durability_overrides[entry.first] = mode;
+        } else {
+            std::cerr << "Unknown durability mode '" << entry.second << "' for " << entry.first << std::endl;
         }
-        cache[mutable_item.getId()] = std::make_shared<T>(mutable_item);
-        saveCache();
-        return true;
     }
-
-    bool update(const T& item) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        int id = item.getId();
-        if (cache.find(id) == cache.end()) return false;
-        cache[id] = std::make_shared<T>(item);
-        saveCache();
-        return true;
+    // Segments are written by the request thread; there is no flusher to
+    // batch or defer them
+    if (storage.partition_sales && storage.backend == dsms::StorageBackend::Json &&
+        storage.durabilityFor("sales") != dsms::DurabilityMode::Sync) {
+        std::cerr << "--sale-partitions writes sales synchronously; ignoring "
+                  << dsms::durabilityName(storage.durabilityFor("sales")) << " durability for sales" << std::endl;
+        storage.durability_overrides["sales"] = dsms::DurabilityMode::Sync;
     }
 
-    bool remove(int id) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (cache.erase(id) > 0) {
-            saveCache();
-            return true;
+    try {
+        std::vector<std::string> stores;
+        for (size_t start = 0; start < config.stores.size();) {
+            size_t comma = config.stores.find(',', start);
+            if (comma == std::string::npos) comma = config.stores.size();
+            if (comma > start) stores.push_back(config.stores.substr(start, comma - start));
+            start = comma + 1;
         }
-        return false;
-    }
+        dsms::getStoreRegistry().open(stores);
 
-    template<typename Predicate>
-    std::vector<std::shared_ptr<T>> filter(Predicate predicate) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::vector<std::shared_ptr<T>> result;
-        for (const auto& pair : cache) {
-            if (predicate(pair.second)) {
-                result.push_back(pair.second);
-            }
+        // Every repository is open by now, so replication sees them all
+        bool replica = !config.replicate_from.empty();
+        if (replica && !config.replication_listen.empty()) {
+            std::cerr << "--replication-listen is ignored on a replica" << std::endl;
+        }
+        if (replica) {
+            if (!dsms::getReplication().startReplica(config.replicate_from)) return 1;
+        } else if (!config.replication_listen.empty()) {
+            dsms::ChangeFeed* feed = storage.change_feed_capacity > 0 ? &dsms::changeFeed() : nullptr;
+            if (!dsms::getReplication().startPrimary(config.replication_listen, feed)) return 1;
         }
-        return result;
-    }
-};
-
-class ItemRepository : public JsonRepository<Item> {
-public:
-    ItemRepository() : JsonRepository<Item>("data/items.json") {}
-    
-    std::vector<std::shared_ptr<Item>> findByDepartment(const std::string& dept) {
-        return filter([&dept](const std::shared_ptr<Item>& item) {
-            return item && item->getDepartment() == dept;
-        });
-    }
-};
 
-// Similarly define SaleRepository, FinancialRecordRepository, PromotionRepository...
+        dsms::ApiListener listener(config);
+        listener.open();
+
+        dsms::RetentionConfig retention;
+        retention.sale_retention_days = config.sale_retention_days;
+        retention.financial_retention_days = config.financial_retention_days;
+        retention.archive_dir = config.data_dir + "/archive";
+        retention.interval = std::chrono::seconds(config.retention_interval_s);
+        retention.batch_size = config.retention_batch;
+        retention.batch_pause = std::chrono::milliseconds(config.retention_pause_ms);
+        // A replica's history follows the primary's retention
+        if (!replica) {
+            dsms::getRetentionJob().start(retention);
+            dsms::getStoreRegistry().startRetention(retention);
+        }
 
-} // namespace dsms
+        std::cout << "DSMS listening on " << config.base_uri << std::endl
+                  << "  fast workers: " << config.fast_workers
+                  << ", report workers: " << config.report_workers
+                  << " x " << config.report_threads << " threads"
+                  << ", max queue: " << config.max_queue_depth << std::endl
+                  << "  storage: " << config.storage << " (" << config.data_dir << ")"
+                  << ", stores: " << dsms::getStoreRegistry().all().size() << std::endl
+                  << "  replication: " << dsms::getReplication().stats().role << std::endl
+                  << "Press Enter to stop." << std::endl;
+
+        std::string line;
+        std::getline(std::cin, line);
+
+        dsms::getRetentionJob().stop();
+        dsms::getStoreRegistry().stopRetention();
+        listener.close();
+        dsms::getReplication().stop();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
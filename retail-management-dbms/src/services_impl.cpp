@@ -1,32 +1,66 @@
 // services_impl.cpp - Service implementations
 #include "services.h"
+#include "store_registry.h"
+#include "replication.h"
 
 namespace dsms {
 
-// Global repository instances
-static ItemRepository g_item_repo;
-static SaleRepository g_sale_repo;
-static FinancialRecordRepository g_finance_repo;
-static PromotionRepository g_promo_repo;
+// Global repository instances, constructed on first use so that main() can
+// pick the storage backend through storageConfig() beforehand
+static ItemRepository& itemRepository() {
+    static ItemRepository repo;
+    return repo;
+}
+
+static SaleRepository& saleRepository() {
+    static SaleRepository repo;
+    return repo;
+}
+
+static FinancialRecordRepository& financeRepository() {
+    static FinancialRecordRepository repo;
+    return repo;
+}
+
+static PromotionRepository& promotionRepository() {
+    static PromotionRepository repo;
+    return repo;
+}
 
 // Global service instances
 InventoryService& getInventoryService() {
-    static InventoryService instance(g_item_repo, g_promo_repo);
+    static InventoryService instance(itemRepository(), promotionRepository());
     return instance;
 }
 
 SalesService& getSalesService() {
-    static SalesService instance(g_sale_repo, g_item_repo, g_finance_repo, getInventoryService());
+    static SalesService instance(saleRepository(), itemRepository(), financeRepository(), getInventoryService());
     return instance;
 }
 
 FinancialService& getFinancialService() {
-    static FinancialService instance(g_finance_repo, g_sale_repo);
+    static FinancialService instance(financeRepository(), saleRepository(), itemRepository(), getSalesService());
     return instance;
 }
 
 PromotionService& getPromotionService() {
-    static PromotionService instance(g_promo_repo, g_item_repo);
+    static PromotionService instance(promotionRepository(), itemRepository());
+    return instance;
+}
+
+RetentionJob& getRetentionJob() {
+    static RetentionJob instance(saleRepository(), financeRepository());
+    return instance;
+}
+
+ReplicationNode& getReplication() {
+    static ReplicationNode instance;
+    return instance;
+}
+
+StoreRegistry& getStoreRegistry() {
+    static StoreRegistry instance(StoreServices{StoreRegistry::kDefaultStore, getInventoryService(), getSalesService(),
+                                                getFinancialService(), getPromotionService()});
     return instance;
 }
 
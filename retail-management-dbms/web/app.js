@@ -35,6 +35,82 @@ document.addEventListener('DOMContentLoaded', function() {
         promotionDialog.style.display = 'none';
     });
     
-    // This is just a demo - in a real implementation, we would fetch data from the API
-    // and implement all the functionality for CRUD operations
-});
\ No newline at end of file
+    // Live updates: one /api/events stream instead of polling. The browser
+    // reconnects on its own and resumes from the last event id it saw.
+    loadInventory();
+    subscribeToChanges();
+});
+
+function formatPrice(price) {
+    return '$' + Number(price).toFixed(2);
+}
+
+function inventoryRow(item) {
+    const row = document.createElement('tr');
+    row.dataset.itemId = item.id;
+    [item.id, item.name, item.company, item.department, item.quantity, formatPrice(item.price)].forEach(value => {
+        const cell = document.createElement('td');
+        cell.textContent = value;
+        row.appendChild(cell);
+    });
+    const actions = document.createElement('td');
+    actions.innerHTML = '<button class="edit-btn">Edit</button> <button class="delete-btn">Delete</button>';
+    row.appendChild(actions);
+    row.classList.toggle('low-stock', item.reorder_point > 0 && item.quantity <= item.reorder_point);
+    return row;
+}
+
+function loadInventory() {
+    fetch('/api/items')
+        .then(response => response.ok ? response.json() : Promise.reject(response.status))
+        .then(items => {
+            const body = document.getElementById('inventory-table-body');
+            body.replaceChildren(...items.map(inventoryRow));
+        })
+        .catch(() => {});   // keep whatever is shown
+}
+
+function applyItemChange(change) {
+    const body = document.getElementById('inventory-table-body');
+    const existing = body.querySelector(`tr[data-item-id="${change.id}"]`);
+    if (change.op === 'remove') {
+        if (existing) existing.remove();
+    } else if (change.op === 'purge') {
+        loadInventory();
+    } else if (existing) {
+        existing.replaceWith(inventoryRow(change.record));
+    } else {
+        body.appendChild(inventoryRow(change.record));
+    }
+}
+
+function applySale(change) {
+    if (change.op !== 'insert') return;
+    const sale = change.record;
+    const row = document.createElement('tr');
+    [sale.id, sale.timestamp, sale.item_id, sale.quantity,
+     formatPrice(sale.quantity > 0 ? sale.total / sale.quantity : 0), formatPrice(sale.total), ''].forEach(value => {
+        const cell = document.createElement('td');
+        cell.textContent = value;
+        row.appendChild(cell);
+    });
+    document.getElementById('sales-table-body').prepend(row);
+}
+
+function applyLowStock(change) {
+    const row = document.querySelector(`#inventory-table-body tr[data-item-id="${change.id}"]`);
+    if (row) row.classList.toggle('low-stock', change.record.low);
+}
+
+function subscribeToChanges() {
+    if (!window.EventSource) return;
+    const events = new EventSource('/api/events?resources=items,sales,low-stock');
+    events.addEventListener('items', e => applyItemChange(JSON.parse(e.data)));
+    events.addEventListener('sales', e => applySale(JSON.parse(e.data)));
+    events.addEventListener('low-stock', e => applyLowStock(JSON.parse(e.data)));
+    // Sent when the server no longer has every event we missed
+    events.addEventListener('reset', () => {
+        loadInventory();
+        document.getElementById('sales-table-body').replaceChildren();
+    });
+}
\ No newline at end of file